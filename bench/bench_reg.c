@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file bench_reg.c
+ * @brief Benchmarks for register map access and validation.
+ *
+ * Each case is run in batches of doubling size until a batch takes long
+ * enough to time reliably. The results are printed as comma-separated values,
+ * one line per case, with a header line first:
+ *
+ *    case,fields,position,ns_per_op,iterations
+ *
+ * where `fields` is the number of fields in the map, and `position` is where
+ * in the map the accessed field is found (first, middle, last), or `all` for
+ * operations on the whole map.
+ *
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+// error site IDs, decoded by scripts/debug_ids.py
+#define DEBUG_FILE_ID 5
+
+// for clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+
+#include "utils/debug.h"
+#include "utils/reg.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MIN_TIME  0.05
+#define BENCH_MAX_ITERS (1UL << 26U)
+#define BENCH_NAME_LEN  8U
+
+// map sizes and field positions to sweep
+static const size_t bench_sizes[] = {10, 100, 1000};
+static const char *const bench_pos[] = {"first", "middle", "last"};
+
+// physical registers of the simulated device
+static uint32_t *phys;
+
+static uint32_t bench_read_fn(int arg, size_t reg)
+{
+   (void)arg;
+   return phys[reg];
+}
+
+static int bench_write_fn(int arg, size_t reg, uint32_t val)
+{
+   (void)arg;
+   phys[reg] = val;
+   return 0;
+}
+
+static int bench_load_fn(int arg, int id)
+{
+   (void)arg;
+   (void)id;
+   return 0;
+}
+
+/**
+ * @brief Register map of a given size, with a device to access it.
+ *
+ * The map has `num` fields named F0000, F0001, etc., each in a register of
+ * its own, followed by a multi-register field MULTI, a descending field DESC,
+ * and a volatile field VOL.
+ */
+struct bench_map {
+   size_t num;
+   struct reg_field *fields;
+   char *names;
+   const char **virt_fields;
+   uint64_t *virt_data;
+   uint32_t *data;
+   struct reg_dev dev;
+};
+
+static void bench_field(struct reg_field *const f, const char *const name,
+                        const size_t reg, const uint8_t offs,
+                        const uint8_t width, const uint16_t flags)
+{
+   // the members are const, so the field is copied in whole
+   const struct reg_field tmp = {name, reg, offs, width, flags};
+   memcpy(f, &tmp, sizeof(tmp));
+}
+
+static int bench_map_init(struct bench_map *const m, const size_t num)
+{
+   const size_t regs = num + 7;
+
+   memset(m, 0, sizeof(*m));
+   m->num         = num;
+   m->fields      = calloc(num + 4, sizeof(*m->fields));
+   m->names       = calloc(num, BENCH_NAME_LEN);
+   m->virt_fields = calloc(num + 1, sizeof(*m->virt_fields));
+   m->virt_data   = calloc(num, sizeof(*m->virt_data));
+   m->data        = calloc(regs, sizeof(*m->data));
+   phys           = realloc(phys, regs * sizeof(*phys));
+   if (!m->fields || !m->names || !m->virt_fields || !m->virt_data ||
+       !m->data || !phys) {
+      ERROR("out of memory");
+      return -1;
+   }
+
+   for (size_t i = 0; i < num; i++) {
+      char *const name = &m->names[i * BENCH_NAME_LEN];
+      snprintf(name, BENCH_NAME_LEN, "F%04u", (unsigned)(i % 10000U));
+      bench_field(&m->fields[i], name, i, 0, 16, 0);
+      m->virt_fields[i] = name;
+   }
+
+   bench_field(&m->fields[num], "MULTI", num, 0, 64, 0);
+   bench_field(&m->fields[num + 1], "DESC", num + 5, 0, 32, REG_DESCEND);
+   bench_field(&m->fields[num + 2], "VOL", num + 6, 0, 16, REG_VOLATILE);
+   bench_field(&m->fields[num + 3], NULL, 0, 0, 0, 0);
+   memset(phys, 0, regs * sizeof(*phys));
+
+   m->dev = (struct reg_dev){
+       .reg_width = 16,
+       .reg_num   = regs,
+       .field_map = m->fields,
+       .read_fn   = bench_read_fn,
+       .write_fn  = bench_write_fn,
+       .data      = m->data,
+   };
+
+   return 0;
+}
+
+static void bench_map_free(struct bench_map *const m)
+{
+   free(m->fields);
+   free(m->names);
+   free(m->virt_fields);
+   free(m->virt_data);
+   free(m->data);
+}
+
+/***********************************************************
+ * TIMING
+ ***********************************************************/
+
+// one benchmark case: the operation and the field it works on
+struct bench_case {
+   struct bench_map *m;
+   const char *field;
+   struct reg_virt *virt;
+};
+
+static volatile uint64_t bench_sink;
+
+static double bench_now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+/**
+ * @brief Time an operation and print the result line.
+ *
+ * @param name Name of the case.
+ * @param pos Position of the field in the map.
+ * @param fn Operation to time; returns nonzero on failure.
+ * @param c Arguments of the operation.
+ * @return 0 on success, -1 if any call of the operation failed.
+ */
+static int bench_run(const char *const name, const char *const pos,
+                     int (*fn)(const struct bench_case *),
+                     const struct bench_case *const c)
+{
+   if (fn(c)) {
+      ERROR("benchmark operation failed");
+      return -1;
+   }
+
+   double elapsed = 0;
+   size_t iters   = 1;
+   for (; iters <= BENCH_MAX_ITERS; iters *= 2) {
+      // collect the results and check them once the batch is timed
+      int fail        = 0;
+      const double t0 = bench_now();
+      for (size_t i = 0; i < iters; i++)
+         fail |= fn(c);
+      elapsed = bench_now() - t0;
+
+      if (fail) {
+         ERROR("benchmark operation failed while timed");
+         return -1;
+      }
+
+      if (elapsed >= BENCH_MIN_TIME)
+         break;
+   }
+
+   printf("%s,%zu,%s,%.2f,%zu\n", name, c->m->num, pos,
+          elapsed * 1e9 / (double)iters, iters);
+   return 0;
+}
+
+/***********************************************************
+ * OPERATIONS
+ ***********************************************************/
+
+static int bench_get(const struct bench_case *const c)
+{
+   bench_sink = reg_get(&c->m->dev, c->field);
+   return 0;
+}
+
+static int bench_set(const struct bench_case *const c)
+{
+   return reg_set(&c->m->dev, c->field, bench_sink & 0xffffU);
+}
+
+static int bench_set_multi(const struct bench_case *const c)
+{
+   return reg_set(&c->m->dev, c->field, bench_sink | 0x123456789abcULL);
+}
+
+static int bench_set_desc(const struct bench_case *const c)
+{
+   return reg_set(&c->m->dev, c->field, bench_sink | 0x12345678U);
+}
+
+static int bench_check(const struct bench_case *const c)
+{
+   return reg_check(&c->m->dev);
+}
+
+static int bench_verify(const struct bench_case *const c)
+{
+   return reg_verify(c->virt);
+}
+
+/***********************************************************
+ * CASES
+ ***********************************************************/
+
+static int bench_size(const size_t num)
+{
+   struct bench_map m;
+   if (bench_map_init(&m, num)) {
+      bench_map_free(&m);
+      return -1;
+   }
+
+   int fail = 0;
+
+   // single-register fields at the start, middle, and end of the map
+   const size_t at[] = {0, num / 2, num - 1};
+   for (size_t p = 0; p < sizeof(at) / sizeof(at[0]); p++) {
+      const struct bench_case c = {&m, m.fields[at[p]].name, NULL};
+      fail = fail || bench_run("get", bench_pos[p], bench_get, &c);
+      fail = fail || bench_run("set", bench_pos[p], bench_set, &c);
+   }
+
+   // special fields, all at the end of the map
+   const struct bench_case multi = {&m, "MULTI", NULL};
+   const struct bench_case desc  = {&m, "DESC", NULL};
+   const struct bench_case vol   = {&m, "VOL", NULL};
+   fail = fail || bench_run("get_multi", "last", bench_get, &multi);
+   fail = fail || bench_run("set_multi", "last", bench_set_multi, &multi);
+   fail = fail || bench_run("get_desc", "last", bench_get, &desc);
+   fail = fail || bench_run("set_desc", "last", bench_set_desc, &desc);
+   fail = fail || bench_run("get_volatile", "last", bench_get, &vol);
+
+   // validation of the whole map, and of a virtual device built on it
+   const struct bench_case check = {&m, NULL, NULL};
+   fail = fail || bench_run("check", "all", bench_check, &check);
+
+   const struct reg_field *maps[] = {m.fields, NULL};
+   struct reg_virt virt           = {
+       .fields  = m.virt_fields,
+       .data    = m.virt_data,
+       .maps    = maps,
+       .load_fn = bench_load_fn,
+       .base    = m.dev,
+   };
+   const struct bench_case verify = {&m, NULL, &virt};
+   fail = fail || bench_run("verify", "all", bench_verify, &verify);
+
+   bench_map_free(&m);
+   return fail ? -1 : 0;
+}
+
+int main(void)
+{
+   printf("case,fields,position,ns_per_op,iterations\n");
+
+   int fail = 0;
+   for (size_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++)
+      fail = fail || bench_size(bench_sizes[i]);
+
+   free(phys);
+   return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// end file bench_reg.c
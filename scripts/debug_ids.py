@@ -0,0 +1,169 @@
+# SPDX-License-Identifier: MIT
+"""
+debug_ids.py - Decode error site IDs of the binary error reporting mode
+
+When built with DEBUG_BINARY=1, ERROR() passes a numeric site ID instead of
+the function name, file name, and message. The upper 16 bits of the ID are
+the DEBUG_FILE_ID defined in the source file, and the lower 16 bits are the
+line number. This program finds the error sites in the sources and maps IDs
+back to file, line, function, and message.
+
+Usage:
+
+    python3 scripts/debug_ids.py [--table | --check] [SOURCE ...] < log
+
+Each token of the log made of 0x and eight hex digits, as printed with the
+"%#010" PRIx32 format, is replaced by the decoded site; other text is copied
+unchanged. With --table, print all known error sites instead. With --check,
+verify that every file with error sites has a DEBUG_FILE_ID, that no two files
+share one, and that all IDs fit in their 16 bits. Without sources, all C files
+in utils/, tests/, and bench/ are scanned.
+
+Author: Jakob Kastelic
+Copyright (c) 2025 Stanford Research Systems, Inc.
+"""
+
+import glob
+import os
+import re
+import sys
+from typing import Dict, List, Tuple
+
+FILE_ID_RE = re.compile(r'^\s*#\s*define\s+DEBUG_FILE_ID\s+(\d+)')
+FUNC_RE = re.compile(r'^[A-Za-z_][\w\s\*]*?\b(\w+)\s*\(')
+ERROR_RE = re.compile(r'\bERROR\s*\((.*)\)')
+STRING_RE = re.compile(r'"((?:[^"\\]|\\.)*)"')
+TOKEN_RE = re.compile(r'0x[0-9a-fA-F]{8}')
+
+Site = Tuple[str, int, str, str]
+
+
+def scan_file(path: str) -> Tuple[int, List[Site]]:
+    """Find the file ID and all error sites of one source file."""
+    file_id = 0
+    func = ''
+    sites = []
+
+    with open(path, 'r', encoding='utf-8') as f:
+        lines = f.readlines()
+
+    for num, line in enumerate(lines, start=1):
+        m = FILE_ID_RE.match(line)
+        if m:
+            file_id = int(m.group(1))
+            continue
+
+        # function definitions start in the first column
+        m = FUNC_RE.match(line)
+        if m and not line.rstrip().endswith(';'):
+            func = m.group(1)
+
+        m = ERROR_RE.search(line)
+        if m and '#define' not in line:
+            s = STRING_RE.search(m.group(1))
+            msg = s.group(1) if s else m.group(1).strip()
+            sites.append((path, num, func, msg))
+
+    return file_id, sites
+
+
+def check_ids(paths: List[str]) -> List[str]:
+    """Find files with error sites but no file ID, and reused file IDs."""
+    errors = []
+    owners: Dict[int, str] = {}
+
+    for path in paths:
+        file_id, sites = scan_file(path)
+        if file_id == 0:
+            if sites:
+                errors.append(f'{path}: {len(sites)} error sites but no '
+                              f'DEBUG_FILE_ID')
+            continue
+
+        if file_id > 0xffff:
+            errors.append(f'{path}: DEBUG_FILE_ID {file_id} too large')
+        if file_id in owners:
+            errors.append(f'{path}: DEBUG_FILE_ID {file_id} also used in '
+                          f'{owners[file_id]}')
+        owners[file_id] = path
+
+        for site in sites:
+            if site[1] > 0xffff:
+                errors.append(f'{path}:{site[1]}: line number too large')
+
+    return errors
+
+
+def build_table(paths: List[str]) -> Dict[int, Site]:
+    """Map site IDs to sites, for all files with a nonzero file ID."""
+    table = {}
+    owners = {}
+
+    for path in paths:
+        file_id, sites = scan_file(path)
+        if file_id == 0:
+            continue
+
+        if file_id in owners:
+            sys.exit(f'error: DEBUG_FILE_ID {file_id} used in both '
+                     f'{owners[file_id]} and {path}')
+        owners[file_id] = path
+
+        for site in sites:
+            table[(file_id << 16) | site[1]] = site
+
+    return table
+
+
+def format_site(site_id: int, table: Dict[int, Site]) -> str:
+    """Describe one site ID."""
+    site = table.get(site_id)
+    if not site:
+        return f'{site_id:#010x} (unknown site: file {site_id >> 16}, ' \
+               f'line {site_id & 0xffff})'
+
+    path, line, func, msg = site
+    return f'{path}:{line}: {func}: {msg}'
+
+
+def decode_token(token: str, table: Dict[int, Site]) -> str:
+    """Decode a log token if it is a site ID, else return it unchanged."""
+    if not TOKEN_RE.fullmatch(token):
+        return token
+
+    return format_site(int(token, 16), table)
+
+
+def main() -> None:
+    args = sys.argv[1:]
+    show_table = '--table' in args
+    check = '--check' in args
+    paths = [a for a in args if a not in ('--table', '--check')]
+
+    if not paths:
+        root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        for d in ('utils', 'tests', 'bench'):
+            found = sorted(glob.glob(os.path.join(root, d, '*.c')))
+            paths += [os.path.relpath(p) for p in found]
+
+    if check:
+        errors = check_ids(paths)
+        for e in errors:
+            print(f'error: {e}', file=sys.stderr)
+        sys.exit(1 if errors else 0)
+
+    table = build_table(paths)
+
+    if show_table:
+        for site_id in sorted(table):
+            print(f'{site_id:#010x} {format_site(site_id, table)}')
+        return
+
+    for line in sys.stdin:
+        tokens = re.split(r'(\s+)', line.rstrip('\n'))
+        print(''.join(decode_token(t, table) if t.strip() else t
+                      for t in tokens))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file replay.c
+ * @brief Saving, loading, and replaying recorded register sessions.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+// error site IDs, decoded by scripts/debug_ids.py
+#define DEBUG_FILE_ID 2
+
+// for clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+
+#include "tests/replay.h"
+#include "utils/debug.h"
+#include "utils/reg.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define REPLAY_VERSION  1U
+#define REPLAY_REC_SIZE 16U
+#define REPLAY_HDR_SIZE 12U
+
+// distinct statistics blocks counted for the bus operations of a replay
+#define REPLAY_MAX_STATS 64U
+
+/***********************************************************
+ * FILE FORMAT
+ ***********************************************************/
+
+static void replay_put16(uint8_t *const p, const uint16_t v)
+{
+   p[0] = (uint8_t)v;
+   p[1] = (uint8_t)(v >> 8U);
+}
+
+static void replay_put32(uint8_t *const p, const uint32_t v)
+{
+   replay_put16(p, (uint16_t)v);
+   replay_put16(p + 2, (uint16_t)(v >> 16U));
+}
+
+static uint16_t replay_get16(const uint8_t *const p)
+{
+   return (uint16_t)(p[0] | (p[1] << 8U));
+}
+
+static uint32_t replay_get32(const uint8_t *const p)
+{
+   return replay_get16(p) | ((uint32_t)replay_get16(p + 2) << 16U);
+}
+
+int replay_save(const char *const path, const struct reg_trace_rec *const recs,
+                const size_t num)
+{
+   if (!path || (!recs && num) || (num > UINT32_MAX)) {
+      ERROR("invalid records to save");
+      return -1;
+   }
+
+   FILE *const f = fopen(path, "wb");
+   if (!f) {
+      ERROR("cannot open replay file");
+      return -1;
+   }
+
+   uint8_t hdr[REPLAY_HDR_SIZE];
+   memcpy(hdr, "REGT", 4);
+   replay_put16(&hdr[4], REPLAY_VERSION);
+   replay_put16(&hdr[6], REPLAY_REC_SIZE);
+   replay_put32(&hdr[8], (uint32_t)num);
+   bool fail = fwrite(hdr, sizeof(hdr), 1, f) != 1;
+
+   for (size_t i = 0; !fail && (i < num); i++) {
+      uint8_t buf[REPLAY_REC_SIZE];
+      replay_put32(&buf[0], recs[i].time);
+      replay_put32(&buf[4], recs[i].reg);
+      replay_put32(&buf[8], recs[i].val);
+      replay_put16(&buf[12], recs[i].dev);
+      buf[14] = recs[i].op;
+      buf[15] = recs[i].err;
+      fail    = fwrite(buf, sizeof(buf), 1, f) != 1;
+   }
+
+   if (fclose(f) || fail) {
+      ERROR("cannot write replay file");
+      return -1;
+   }
+
+   return 0;
+}
+
+size_t replay_load(const char *const path, struct reg_trace_rec *const recs,
+                   const size_t len)
+{
+   if (!path || !recs) {
+      ERROR("missing file name or records");
+      return 0;
+   }
+
+   FILE *const f = fopen(path, "rb");
+   if (!f) {
+      ERROR("cannot open replay file");
+      return 0;
+   }
+
+   uint8_t hdr[REPLAY_HDR_SIZE];
+   if ((fread(hdr, sizeof(hdr), 1, f) != 1) || memcmp(hdr, "REGT", 4) ||
+       (replay_get16(&hdr[4]) != REPLAY_VERSION) ||
+       (replay_get16(&hdr[6]) != REPLAY_REC_SIZE)) {
+      ERROR("not a replay file");
+      fclose(f);
+      return 0;
+   }
+
+   const uint32_t num = replay_get32(&hdr[8]);
+   if (num > len) {
+      ERROR("too many records in replay file");
+      fclose(f);
+      return 0;
+   }
+
+   for (size_t i = 0; i < num; i++) {
+      uint8_t buf[REPLAY_REC_SIZE];
+      if (fread(buf, sizeof(buf), 1, f) != 1) {
+         ERROR("replay file truncated");
+         fclose(f);
+         return 0;
+      }
+
+      recs[i].time = replay_get32(&buf[0]);
+      recs[i].reg  = replay_get32(&buf[4]);
+      recs[i].val  = replay_get32(&buf[8]);
+      recs[i].dev  = replay_get16(&buf[12]);
+      recs[i].op   = buf[14];
+      recs[i].err  = buf[15];
+   }
+
+   fclose(f);
+   return num;
+}
+
+/***********************************************************
+ * REPLAY
+ ***********************************************************/
+
+/**
+ * @brief Find the name of a virtual field by its ID.
+ */
+static const char *replay_virt_name(const struct reg_virt *const v,
+                                    const uint32_t id)
+{
+   for (uint32_t i = 0; v->fields[i]; i++)
+      if (i == id)
+         return v->fields[i];
+
+   return NULL;
+}
+
+/**
+ * @brief Count bus operations of all devices, each statistics block once.
+ *
+ * @return 0 on success, -1 if there are too many statistics blocks.
+ */
+static int replay_bus(struct reg_dev *const *const devs, const size_t dev_num,
+                      struct reg_virt *const *const virts,
+                      const size_t virt_num, size_t *const bus)
+{
+   const struct reg_stats *seen[REPLAY_MAX_STATS];
+   size_t seen_num = 0;
+   *bus            = 0;
+
+   for (size_t i = 0; i < dev_num + virt_num; i++) {
+      const struct reg_dev *const d =
+          (i < dev_num) ? devs[i] : &virts[i - dev_num]->base;
+      const struct reg_stats *const s = d->ext ? d->ext->stats : NULL;
+      if (!s)
+         continue;
+
+      bool dup = false;
+      for (size_t j = 0; j < seen_num; j++)
+         dup = dup || (seen[j] == s);
+      if (dup)
+         continue;
+
+      if (seen_num == REPLAY_MAX_STATS) {
+         ERROR("too many statistics blocks");
+         return -1;
+      }
+
+      seen[seen_num++] = s;
+      *bus += s->read_calls + s->write_calls + s->page_calls + s->loads;
+   }
+
+   return 0;
+}
+
+static double replay_now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+int replay_run(const struct reg_trace_rec *const recs, const size_t num,
+               struct reg_dev *const *const devs, const size_t dev_num,
+               struct reg_virt *const *const virts, const size_t virt_num,
+               struct replay_result *const res)
+{
+   if ((!recs && num) || (!devs && dev_num) || (!virts && virt_num) || !res) {
+      ERROR("invalid replay arguments");
+      return -1;
+   }
+
+   memset(res, 0, sizeof(*res));
+   size_t bus_before = 0;
+   if (replay_bus(devs, dev_num, virts, virt_num, &bus_before))
+      return -1;
+
+   uint32_t high = 0;
+   for (size_t i = 0; i < num; i++) {
+      const struct reg_trace_rec *const r = &recs[i];
+
+      // physical accesses are the result of the calls, not replayed
+      if ((r->op == REG_TRACE_READ) || (r->op == REG_TRACE_WRITE) ||
+          (r->op == REG_TRACE_PAGE) || (r->op == REG_TRACE_LOAD)) {
+         res->bus_recorded++;
+         continue;
+      }
+
+      if (r->op == REG_TRACE_HIGH) {
+         high = r->val;
+         continue;
+      }
+
+      const uint64_t val = ((uint64_t)high << 32U) | r->val;
+      high               = 0;
+
+      // calls that failed in the session are not replayed
+      if (r->err)
+         continue;
+
+      struct reg_dev *d  = NULL;
+      struct reg_virt *v = NULL;
+      for (size_t j = 0; j < dev_num; j++)
+         if ((uint16_t)devs[j]->arg == r->dev)
+            d = devs[j];
+      for (size_t j = 0; j < virt_num; j++)
+         if ((uint16_t)virts[j]->base.arg == r->dev)
+            v = virts[j];
+
+      const bool phys = (r->op == REG_TRACE_SET) || (r->op == REG_TRACE_GET);
+      const bool virt =
+          (r->op == REG_TRACE_ADJUST) || (r->op == REG_TRACE_OBTAIN);
+      const char *const name = (phys && d)   ? reg_field_name(d, (int)r->reg)
+                               : (virt && v) ? replay_virt_name(v, r->reg)
+                                             : NULL;
+      if (!name) {
+         ERROR("cannot replay record");
+         return -1;
+      }
+
+      int fail        = 0;
+      unsigned op     = 0;
+      const double t0 = replay_now();
+      switch (r->op) {
+         case REG_TRACE_SET:
+            op   = REPLAY_SET;
+            fail = reg_set(d, name, val);
+            break;
+         case REG_TRACE_GET:
+            op = REPLAY_GET;
+            (void)reg_get(d, name);
+            break;
+         case REG_TRACE_ADJUST:
+            op   = REPLAY_ADJUST;
+            fail = reg_adjust(v, name, val);
+            break;
+         default:
+            op = REPLAY_OBTAIN;
+            (void)reg_obtain(v, name);
+            break;
+      }
+      res->seconds[op] += replay_now() - t0;
+      res->calls[op]++;
+
+      if (fail)
+         res->errors++;
+   }
+
+   size_t bus_after = 0;
+   if (replay_bus(devs, dev_num, virts, virt_num, &bus_after))
+      return -1;
+
+   res->bus_replayed = bus_after - bus_before;
+   return 0;
+}
+
+// end file replay.c
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file replay.h
+ * @brief Saving, loading, and replaying recorded register sessions.
+ *
+ * A session is recorded on the target with the access trace of reg.h and
+ * dumped with reg_trace_dump(). On the host, the records are saved to a
+ * compact binary file, and later replayed against simulated devices to
+ * compare the speed and bus traffic of library changes on identical traffic.
+ *
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "utils/reg.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// per-operation results, indexed by REPLAY_SET etc.
+#define REPLAY_SET    0U
+#define REPLAY_GET    1U
+#define REPLAY_ADJUST 2U
+#define REPLAY_OBTAIN 3U
+#define REPLAY_OPS    4U
+
+struct replay_result {
+   size_t calls[REPLAY_OPS];
+   double seconds[REPLAY_OPS];
+   size_t errors;
+   size_t bus_recorded;
+   size_t bus_replayed;
+};
+
+/**
+ * @brief Save trace records to a binary file.
+ *
+ * The file starts with the magic "REGT", a 16-bit version, a 16-bit record
+ * size, and a 32-bit record count, followed by 16-byte records; all integers
+ * are little-endian.
+ *
+ * @param path Name of the file to write.
+ * @param recs Records to save, oldest first.
+ * @param num Number of records.
+ * @return 0 on success, -1 on failure.
+ */
+int replay_save(const char *path, const struct reg_trace_rec *recs,
+                size_t num);
+
+/**
+ * @brief Load trace records from a file written by replay_save().
+ *
+ * @param path Name of the file to read.
+ * @param recs Output: loaded records.
+ * @param len Maximum number of records to load.
+ * @return Number of records loaded, or 0 on failure.
+ */
+size_t replay_load(const char *path, struct reg_trace_rec *recs, size_t len);
+
+/**
+ * @brief Re-execute the recorded API calls of a session.
+ *
+ * Each `REG_TRACE_SET` and `REG_TRACE_GET` record is replayed on the device
+ * in `devs` whose `arg` matches the recorded `dev`, and each
+ * `REG_TRACE_ADJUST` and `REG_TRACE_OBTAIN` record on the matching virtual
+ * device in `virts`, calling the library by field name just as the original
+ * session did. Physical access records are not replayed; they are only
+ * counted, to be compared against the bus operations of the replay. The
+ * latter are taken from the `stats` of the devices, if attached; devices may
+ * share statistics, but at most 64 distinct blocks are counted.
+ *
+ * @param recs Recorded session, oldest first.
+ * @param num Number of records.
+ * @param devs Physical devices to replay on; may be NULL if `dev_num` is 0.
+ * @param dev_num Number of physical devices.
+ * @param virts Virtual devices to replay on; may be NULL if `virt_num` is 0.
+ * @param virt_num Number of virtual devices.
+ * @param res Output: time and number of calls per operation, and bus counts.
+ * @return 0 on success, -1 if a record cannot be replayed or there are too
+ * many statistics blocks.
+ */
+int replay_run(const struct reg_trace_rec *recs, size_t num,
+               struct reg_dev *const *devs, size_t dev_num,
+               struct reg_virt *const *virts, size_t virt_num,
+               struct replay_result *res);
+
+#endif // REPLAY_H
+
+// end file replay.h
@@ -9,8 +9,12 @@
  * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
  */
 
+#include "tests/test_debug.h"
 #include "tests/test_reg.h"
+#include "tests/test_snprintf.h"
 #include "utils/debug.h"
+#include <inttypes.h>
+#include <stdint.h>
 #include <stdio.h>
 
 static void print_error(const char *fn, const char *fi, int l, const char *m)
@@ -18,9 +22,15 @@ static void print_error(const char *fn, const char *fi, int l, const char *m)
    printf("\033[1;31merror:\033[0m %s in %s (line %d): %s\r\n", fn, fi, l, m);
 }
 
+static void print_error_id(uint32_t id)
+{
+   printf("\033[1;31merror:\033[0m %#010" PRIx32 "\r\n", id);
+}
+
 int main(void)
 {
    debug_set_error_cb(print_error);
+   debug_set_error_id_cb(print_error_id);
 
    int ret = 0;
 
@@ -35,6 +45,28 @@ int main(void)
    ret = ret || test_reg_multi();
    ret = ret || test_reg_virt_check();
    ret = ret || test_reg_virt();
+   ret = ret || test_reg_mmio();
+   ret = ret || test_reg_page();
+   ret = ret || test_reg_sparse();
+   ret = ret || test_reg_narrow();
+   ret = ret || test_reg_kernel();
+   ret = ret || test_reg_id();
+   ret = ret || test_reg_packed();
+   ret = ret || test_reg_map();
+   ret = ret || test_reg_group();
+   ret = ret || test_reg_chain();
+   ret = ret || test_reg_stats();
+   ret = ret || test_reg_trace();
+   ret = ret || test_reg_replay();
+   ret = ret || test_reg_cost();
+   ret = ret || test_reg_sim();
+   ret = ret || test_reg_hist();
+
+   // snprintf.c
+   ret = ret || test_snprintf();
+
+   // debug.c, last, since it replaces the error callbacks
+   ret = ret || test_debug();
 
    return ret;
 }
@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file sim_dev.c
+ * @brief Simulated device backend with bus costs and fault injection.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+// error site IDs, decoded by scripts/debug_ids.py
+#define DEBUG_FILE_ID 3
+
+// for clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+
+#include "tests/sim_dev.h"
+#include "utils/debug.h"
+#include "utils/reg.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+static struct sim_dev *sim_devs[SIM_DEV_MAX];
+
+static uint64_t sim_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000000U) + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Charge the cost of one transaction.
+ *
+ * @param s Simulated device.
+ * @param words Number of words transferred.
+ * @param read True if the transaction is a read.
+ * @return True if the transaction is to fail.
+ */
+static bool sim_charge(struct sim_dev *const s, const size_t words,
+                       const bool read)
+{
+   const uint64_t ns = s->txn_ns + (uint64_t)s->word_ns * words +
+                       (read ? s->turn_ns : 0U);
+
+   s->time_ns += ns;
+   s->txns++;
+   s->words += words;
+
+   if (s->busy_wait) {
+      const uint64_t end = sim_now_ns() + ns;
+      while (sim_now_ns() < end)
+         ;
+   }
+
+   const bool fault = s->fault_period && ((s->txns % s->fault_period) == 0);
+   if (fault)
+      s->faults++;
+
+   return fault;
+}
+
+/**
+ * @brief Look up the simulation registered for a device.
+ */
+static struct sim_dev *sim_get(const int arg, const size_t reg)
+{
+   if ((arg < 0) || ((size_t)arg >= SIM_DEV_MAX) || !sim_devs[arg]) {
+      ERROR("no simulated device");
+      return NULL;
+   }
+
+   if (reg >= sim_devs[arg]->reg_num) {
+      ERROR("register outside simulated device");
+      return NULL;
+   }
+
+   return sim_devs[arg];
+}
+
+int sim_attach(struct sim_dev *const s, struct reg_dev *const d,
+               const int arg)
+{
+   if (!s || !s->regs || (arg < 0) || ((size_t)arg >= SIM_DEV_MAX)) {
+      ERROR("invalid simulated device");
+      return -1;
+   }
+
+   sim_devs[arg] = s;
+   sim_reset(s);
+
+   if (d) {
+      d->arg      = arg;
+      d->read_fn  = sim_read;
+      d->write_fn = sim_write;
+   }
+
+   return 0;
+}
+
+void sim_reset(struct sim_dev *const s)
+{
+   s->time_ns = 0;
+   s->txns    = 0;
+   s->words   = 0;
+   s->faults  = 0;
+}
+
+uint32_t sim_read(int arg, size_t reg)
+{
+   struct sim_dev *const s = sim_get(arg, reg);
+   if (!s)
+      return 0;
+
+   const uint32_t val = s->regs[reg];
+   return sim_charge(s, 1, true) ? (val ^ s->fault_mask) : val;
+}
+
+int sim_write(int arg, size_t reg, uint32_t val)
+{
+   struct sim_dev *const s = sim_get(arg, reg);
+   if (!s)
+      return -1;
+
+   if (sim_charge(s, 1, false))
+      return -1;
+
+   s->regs[reg] = val;
+   return 0;
+}
+
+int sim_group_write(int arg, size_t reg, const uint32_t *vals)
+{
+   struct sim_dev *const s = sim_get(arg, reg);
+   if (!s || !vals)
+      return -1;
+
+   const size_t num = s->group_num ? s->group_num : 1;
+   if (sim_charge(s, num, false))
+      return -1;
+
+   // word i of the frame goes to the device registered at arg + i
+   for (size_t i = 0; i < num; i++) {
+      struct sim_dev *const t = sim_get(arg + (int)i, reg);
+      if (!t)
+         return -1;
+
+      t->regs[reg] = vals[i];
+   }
+
+   return 0;
+}
+
+// end file sim_dev.c
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file sim_dev.h
+ * @brief Simulated device backend with bus costs and fault injection.
+ *
+ * A simulated device keeps a register file and stands in for the physical
+ * read/write callbacks of a `struct reg_dev`. Each transaction is charged a
+ * configurable cost, either only in virtual time or also by busy-waiting,
+ * so that batching, coalescing, and burst transfers can be compared on the
+ * host without hardware.
+ *
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#ifndef SIM_DEV_H
+#define SIM_DEV_H
+
+#include "utils/reg.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_DEV_MAX 8U
+
+struct sim_dev {
+   // register file
+   uint32_t *regs;
+   size_t reg_num;
+
+   // costs in nanoseconds: per transaction, per word, and extra for reads
+   uint32_t txn_ns;
+   uint32_t word_ns;
+   uint32_t turn_ns;
+   bool busy_wait;
+
+   // words in each group or chain frame, normally the number of devices
+   size_t group_num;
+
+   // fault injection: every fault_period-th transaction fails; failed
+   // writes are not stored and report an error, failed reads return the
+   // register XOR fault_mask
+   uint32_t fault_period;
+   uint32_t fault_mask;
+
+   // totals
+   uint64_t time_ns;
+   size_t txns;
+   size_t words;
+   size_t faults;
+};
+
+/**
+ * @brief Register a simulated device and connect it to a device structure.
+ *
+ * Sets `arg`, `read_fn`, and `write_fn` of the device to use the simulation.
+ * For groups and chains, use sim_group_write() as the group `write_fn`, with
+ * the group `arg` set to the same `arg`.
+ *
+ * @param s Simulated device, with the register file and costs filled in.
+ * @param d Device structure to connect, or NULL.
+ * @param arg Slot to register the simulation in, less than SIM_DEV_MAX.
+ * @return 0 on success, -1 on failure.
+ */
+int sim_attach(struct sim_dev *s, struct reg_dev *d, int arg);
+
+/**
+ * @brief Clear the totals of a simulated device.
+ */
+void sim_reset(struct sim_dev *s);
+
+uint32_t sim_read(int arg, size_t reg);
+int sim_write(int arg, size_t reg, uint32_t val);
+
+/**
+ * @brief Group write callback: one transaction of `group_num` words.
+ *
+ * Word `i` of the frame is stored in the device registered at `arg + i`,
+ * which must exist for every word. The transaction is charged to the device
+ * at `arg`.
+ */
+int sim_group_write(int arg, size_t reg, const uint32_t *vals);
+
+#endif // SIM_DEV_H
+
+// end file sim_dev.h
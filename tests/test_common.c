@@ -9,10 +9,12 @@
 
 #include "tests/test_common.h"
 #include "utils/debug.h"
+#include "utils/reg.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 int test_runner(int (*valid_fn[])(void), int (*invalid_fn[])(void))
 {
@@ -41,4 +43,115 @@ void printout_buffer(const uint32_t *data, const size_t len)
    }
 }
 
+struct test_bus test_bus[TEST_BUS_DEV];
+
+void test_bus_reset(void)
+{
+   memset(test_bus, 0, sizeof(test_bus));
+}
+
+struct reg_dev test_bus_dev(const int arg, const struct reg_field *const map,
+                            const uint8_t width, const size_t num,
+                            uint32_t *const data)
+{
+   memset(&test_bus[arg], 0, sizeof(test_bus[arg]));
+
+   return (struct reg_dev){
+       .reg_width = width,
+       .reg_num   = num,
+       .field_map = map,
+       .arg       = arg,
+       .read_fn   = test_bus_read,
+       .write_fn  = test_bus_write,
+       .data      = data,
+   };
+}
+
+// position of a register in the register file, or TEST_BUS_REGS if none
+static size_t test_bus_index(const struct test_bus *const b, const size_t reg)
+{
+   if (b->page_len && (reg >= b->page_len))
+      return TEST_BUS_REGS;
+
+   const size_t i = (b->page * b->page_len) + reg;
+   return (i < TEST_BUS_REGS) ? i : TEST_BUS_REGS;
+}
+
+uint32_t test_bus_read(int arg, size_t reg)
+{
+   struct test_bus *const b = &test_bus[arg];
+   const size_t i           = test_bus_index(b, reg);
+
+   b->reads++;
+   return (i < TEST_BUS_REGS) ? b->regs[i] : 0;
+}
+
+int test_bus_write(int arg, size_t reg, uint32_t val)
+{
+   struct test_bus *const b = &test_bus[arg];
+   const size_t i           = test_bus_index(b, reg);
+
+   if (i >= TEST_BUS_REGS)
+      return -1;
+
+   if (b->writes < TEST_BUS_REGS)
+      b->order[b->writes] = reg;
+   b->writes++;
+   b->regs[i] = val;
+   return 0;
+}
+
+int test_bus_page(int arg, size_t page)
+{
+   struct test_bus *const b = &test_bus[arg];
+   b->pages++;
+
+   if (b->page_fail || ((page + 1) * b->page_len > TEST_BUS_REGS))
+      return -1;
+
+   b->page = page;
+   return 0;
+}
+
+int test_bus_load(int arg, int id)
+{
+   (void)id;
+   test_bus[arg].loads++;
+   return 0;
+}
+
+int test_bus_group(int arg, size_t reg, const uint32_t *vals)
+{
+   (void)reg;
+   (void)vals;
+   test_bus[arg].groups++;
+   return 0;
+}
+
+size_t test_bus_writes(void)
+{
+   size_t n = 0;
+   for (size_t i = 0; i < TEST_BUS_DEV; i++)
+      n += test_bus[i].writes;
+   return n;
+}
+
+int test_bus_check(const char *const func, const int line, const int arg,
+                   const size_t reads, const size_t writes, const size_t loads)
+{
+   struct test_bus *const b = &test_bus[arg];
+   const bool ok = (b->reads == reads) && (b->writes == writes) &&
+                   (b->loads == loads);
+   if (!ok)
+      printf("\033[1;31mFAIL:\033[0m %s (line %d): device %d made %zu reads, "
+             "%zu writes, %zu loads; expected %zu, %zu, %zu\n",
+             func, line, arg, b->reads, b->writes, b->loads, reads, writes,
+             loads);
+
+   b->reads  = 0;
+   b->writes = 0;
+   b->loads  = 0;
+   return ok ? 0 : -1;
+}
+
 // end file test_common.c
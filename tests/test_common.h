@@ -7,6 +7,8 @@
  * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
  */
 
+#include "utils/reg.h"
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h> // NOLINT(misc-include-cleaner)
@@ -24,6 +26,17 @@
       printf("\033[32mSUCCESS:\033[0m %s\n", __func__);                        \
    } while (0)
 
+/**
+ * Invalid-input tests that rely on the argument checks of the register library
+ * pass without running when REG_CHECK_LEVEL is below the level that enables
+ * those checks.
+ */
+#define TEST_NEED_CHECKS(level)                                                \
+   do {                                                                        \
+      if (REG_CHECK_LEVEL < (level))                                           \
+         return 0;                                                             \
+   } while (0)
+
 /**
  * @brief Run test cases.
  *
@@ -40,4 +53,76 @@ int test_runner(int (*valid_fn[])(void), int (*invalid_fn[])(void));
  */
 void printout_buffer(const uint32_t *data, size_t len);
 
+/**
+ * Counting stub backends. Each device is identified by its `arg`, an index
+ * into `test_bus`, and keeps a register file along with counts of the calls
+ * made to each of its callbacks. With a nonzero `page_len`, registers are
+ * addressed within the page last selected by test_bus_page().
+ */
+
+#define TEST_BUS_DEV  4U
+#define TEST_BUS_REGS 128U
+
+struct test_bus {
+   uint32_t regs[TEST_BUS_REGS];
+   size_t order[TEST_BUS_REGS]; // registers in the order they were written
+   size_t page_len;
+   size_t page;
+   bool page_fail;
+   size_t reads;
+   size_t writes;
+   size_t pages;
+   size_t loads;
+   size_t groups;
+};
+
+extern struct test_bus test_bus[TEST_BUS_DEV];
+
+/**
+ * @brief Clear the register files and call counts of all stub devices.
+ */
+void test_bus_reset(void);
+
+/**
+ * @brief Device on the stub backend `arg`, whose state is cleared.
+ *
+ * @param arg Stub device to use.
+ * @param map Field map, or NULL to set another kind of map afterwards.
+ * @param width Register width in bits.
+ * @param num Number of registers.
+ * @param data Data buffer, or NULL to set a narrow one afterwards.
+ * @return Device with the read and write stubs attached.
+ */
+struct reg_dev test_bus_dev(int arg, const struct reg_field *map,
+                            uint8_t width, size_t num, uint32_t *data);
+
+uint32_t test_bus_read(int arg, size_t reg);
+int test_bus_write(int arg, size_t reg, uint32_t val);
+int test_bus_page(int arg, size_t page);
+int test_bus_load(int arg, int id);
+
+int test_bus_group(int arg, size_t reg, const uint32_t *vals);
+
+/**
+ * @brief Total number of write_fn calls made to all stub devices.
+ */
+size_t test_bus_writes(void);
+
+/**
+ * @brief Compare the call counts of a stub device, and clear them.
+ *
+ * @param func Name of the calling test, for the error message.
+ * @param line Line of the check, for the error message.
+ * @param arg Device to check.
+ * @param reads Expected number of read_fn calls.
+ * @param writes Expected number of write_fn calls.
+ * @param loads Expected number of load_fn calls.
+ * @return 0 if the counts match, -1 otherwise.
+ */
+int test_bus_check(const char *func, int line, int arg, size_t reads,
+                   size_t writes, size_t loads);
+
+#define TEST_BUS_COUNT(arg, reads, writes, loads)                              \
+   test_bus_check(__func__, __LINE__, arg, reads, writes, loads)
+
 // end file test_common.h
@@ -0,0 +1,648 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_debug.c
+ * @brief Tests for the error reporting of debug.c.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+// error site IDs, decoded by scripts/debug_ids.py
+#define DEBUG_FILE_ID 6
+
+#include "tests/test_debug.h"
+#include "tests/test_common.h"
+#include "utils/debug.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if TEST_THREADS
+#include <pthread.h>
+
+#define TEST_THREAD_NUM   4U
+#define TEST_THREAD_ITERS 10000U
+#endif
+
+// calls of the error callbacks (either mode), and of the suppressed callback
+static uint32_t test_errors;
+#if DEBUG_RATE_LIMIT
+static uint32_t test_suppressed_calls;
+static uint32_t test_suppressed_sum;
+#endif
+
+static void test_error_cb(const char *fn, const char *file, int line,
+                          const char *msg)
+{
+   (void)fn;
+   (void)file;
+   (void)line;
+   (void)msg;
+   test_errors++;
+}
+
+static void test_error_id_cb(uint32_t id)
+{
+   (void)id;
+   test_errors++;
+}
+
+#if DEBUG_RATE_LIMIT
+static void test_suppressed_cb(uint32_t count)
+{
+   test_suppressed_calls++;
+   test_suppressed_sum += count;
+}
+#endif
+
+/**
+ * @brief Install the counting callbacks and clear the counts.
+ */
+static void test_callbacks(void)
+{
+   debug_flush();
+   debug_set_error_cb(test_error_cb);
+   debug_set_error_id_cb(test_error_id_cb);
+   test_errors = 0;
+
+#if DEBUG_RATE_LIMIT
+   debug_set_suppressed_cb(test_suppressed_cb);
+   debug_set_rate_limit(0);
+   debug_new_period();
+
+   test_suppressed_calls = 0;
+   test_suppressed_sum   = 0;
+#endif
+}
+
+// each function is one error site
+static void test_site_a(void)
+{
+   ERROR("site a");
+}
+
+static void test_site_b(void)
+{
+   ERROR("site b");
+}
+
+#if DEBUG_RATE_LIMIT
+static void test_site_c(void)
+{
+   ERROR("site c");
+}
+
+static void test_site_d(void)
+{
+   ERROR("site d");
+}
+
+static void test_site_e(void)
+{
+   ERROR("site e");
+}
+#endif
+
+/**
+ * @brief Report errors at a site, passing any queued ones on.
+ */
+static void test_report(void (*site)(void), const int num)
+{
+   for (int i = 0; i < num; i++) {
+      site();
+      debug_flush();
+   }
+}
+
+#if DEBUG_RATE_LIMIT
+/**
+ * @brief Each site reports at most the limit in a period, counted per site.
+ */
+static int test_debug_limit(void)
+{
+   test_callbacks();
+   debug_set_rate_limit(2);
+   const uint32_t dropped = debug_suppressed();
+
+   test_report(test_site_a, 5);
+   test_report(test_site_b, 1);
+   if ((test_errors != 3) || (debug_suppressed() - dropped != 3)) {
+      TEST_FAIL("%u errors reported, %u suppressed", (unsigned)test_errors,
+                (unsigned)(debug_suppressed() - dropped));
+      return -1;
+   }
+
+   if (test_suppressed_calls != 0) {
+      TEST_FAIL("suppressed count reported before the next error");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief A new period lets a site report again, after its suppressed count.
+ */
+static int test_debug_period(void)
+{
+   test_callbacks();
+   debug_set_rate_limit(1);
+
+   test_report(test_site_c, 4);
+   if ((test_errors != 1) || (test_suppressed_calls != 0)) {
+      TEST_FAIL("limit of one not kept");
+      return -1;
+   }
+
+   debug_new_period();
+   test_report(test_site_c, 1);
+   if ((test_errors != 2) || (test_suppressed_calls != 1) ||
+       (test_suppressed_sum != 3)) {
+      TEST_FAIL("suppressed callback got %u in %u calls",
+                (unsigned)test_suppressed_sum, (unsigned)test_suppressed_calls);
+      return -1;
+   }
+
+   // the count is passed once, and site d had nothing suppressed
+   debug_new_period();
+   test_report(test_site_c, 1);
+   test_report(test_site_d, 1);
+   if ((test_errors != 4) || (test_suppressed_calls != 1)) {
+      TEST_FAIL("suppressed count passed again");
+      return -1;
+   }
+
+   return 0;
+}
+#endif
+
+/**
+ * @brief Without a limit, or while silenced, errors are not rate limited.
+ */
+static int test_debug_unlimited(void)
+{
+   test_callbacks();
+   test_report(test_site_a, 10);
+   if (test_errors != 10) {
+      TEST_FAIL("%u of 10 errors reported", (unsigned)test_errors);
+      return -1;
+   }
+
+#if DEBUG_RATE_LIMIT
+   const uint32_t dropped = debug_suppressed();
+   debug_set_rate_limit(1);
+   debug_silent(true);
+   test_report(test_site_b, 10);
+   debug_silent(false);
+   if ((test_errors != 10) || (debug_suppressed() != dropped)) {
+      TEST_FAIL("silenced errors reported or counted as suppressed");
+      return -1;
+   }
+#endif
+
+   return 0;
+}
+
+/**
+ * @brief The most recent error is kept, even while silenced, until cleared.
+ */
+static int test_debug_last(void)
+{
+   test_callbacks();
+   debug_clear_error();
+
+   const struct debug_last *last = debug_last_error();
+   if ((last->count != 0) || last->msg || (last->id != 0)) {
+      TEST_FAIL("error not cleared");
+      return -1;
+   }
+
+   debug_silent(true);
+   test_site_a();
+   test_site_b();
+   debug_silent(false);
+
+#if DEBUG_BINARY
+   const bool site_ok = ((last->id >> 16U) == DEBUG_FILE_ID) && !last->msg;
+#else
+   const bool site_ok = last->msg && (strcmp(last->msg, "site b") == 0) &&
+                        (last->line > 0) && (last->id == 0);
+#endif
+   if (!site_ok || (last->count != 2)) {
+      TEST_FAIL("last of %u errors not recorded", (unsigned)last->count);
+      return -1;
+   }
+
+#if DEBUG_RATE_LIMIT
+   // errors dropped by the rate limit are counted only as suppressed
+   debug_set_rate_limit(1);
+   test_report(test_site_e, 3);
+   if (last->count != 3) {
+      TEST_FAIL("%u errors recorded", (unsigned)last->count);
+      return -1;
+   }
+#endif
+
+   debug_clear_error();
+   if ((last->count != 0) || last->msg) {
+      TEST_FAIL("error not cleared");
+      return -1;
+   }
+
+   return 0;
+}
+
+#if TEST_THREADS && !DEBUG_QUEUE
+// errors reported to the callbacks of each thread
+static DEBUG_TLS uint32_t test_thread_errors;
+
+static void test_thread_cb(const char *fn, const char *file, int line,
+                           const char *msg)
+{
+   (void)fn;
+   (void)file;
+   (void)line;
+   (void)msg;
+   test_thread_errors++;
+}
+
+static void test_thread_id_cb(uint32_t id)
+{
+   (void)id;
+   test_thread_errors++;
+}
+
+struct test_thread {
+   pthread_t thread;
+   uint32_t num;
+   int fail;
+};
+
+/**
+ * @brief Toggle silence out of phase with the other threads, and check that
+ * only the own silence and callbacks apply.
+ */
+static void *test_thread_run(void *arg)
+{
+   struct test_thread *t = arg;
+   debug_set_error_cb(test_thread_cb);
+   debug_set_error_id_cb(test_thread_id_cb);
+   debug_clear_error();
+
+   uint32_t expect = 0;
+   for (uint32_t i = 0; i < TEST_THREAD_ITERS; i++) {
+      const bool silent = ((i + t->num) % 3U) == 0;
+      debug_silent(silent);
+      test_site_a();
+
+      if (!silent)
+         expect++;
+      if ((test_thread_errors != expect) ||
+          (debug_last_error()->count != i + 1)) {
+         t->fail = -1;
+         break;
+      }
+   }
+   debug_silent(false);
+
+#if DEBUG_RATE_LIMIT
+   // the site counts and the limit are this thread's own
+   debug_set_rate_limit(1);
+   debug_new_period();
+   const uint32_t dropped = debug_suppressed();
+   for (uint32_t i = 0; i < TEST_THREAD_ITERS; i++)
+      test_site_b();
+
+   if ((test_thread_errors != expect + 1) ||
+       (debug_suppressed() - dropped != TEST_THREAD_ITERS - 1))
+      t->fail = -1;
+   debug_set_rate_limit(0);
+#endif
+
+   return NULL;
+}
+
+/**
+ * @brief Threads toggle silence and rate limit their errors in parallel
+ * without affecting each other.
+ */
+static int test_debug_threads(void)
+{
+   test_callbacks();
+
+   struct test_thread t[TEST_THREAD_NUM];
+   for (uint32_t i = 0; i < TEST_THREAD_NUM; i++) {
+      t[i] = (struct test_thread){.num = i};
+      if (pthread_create(&t[i].thread, NULL, test_thread_run, &t[i])) {
+         TEST_FAIL("cannot start thread %u", (unsigned)i);
+         return -1;
+      }
+   }
+
+   int fail = 0;
+   for (uint32_t i = 0; i < TEST_THREAD_NUM; i++)
+      if (pthread_join(t[i].thread, NULL) || t[i].fail)
+         fail = -1;
+
+   if (fail) {
+      TEST_FAIL("thread saw the silence or callbacks of another");
+      return -1;
+   }
+
+   if (test_errors != 0) {
+      TEST_FAIL("thread errors reported to the main thread's callbacks");
+      return -1;
+   }
+
+   return 0;
+}
+#endif
+
+#if DEBUG_QUEUE
+/**
+ * @brief Queued errors reach the callbacks only when flushed.
+ */
+static int test_debug_queue(void)
+{
+   test_callbacks();
+
+   for (uint32_t i = 0; i < DEBUG_QUEUE; i++)
+      test_site_a();
+   if (test_errors != 0) {
+      TEST_FAIL("callback called before the flush");
+      return -1;
+   }
+
+   const uint32_t num = debug_flush();
+   if ((num != DEBUG_QUEUE) || (test_errors != DEBUG_QUEUE)) {
+      TEST_FAIL("flushed %u errors, %u reported", (unsigned)num,
+                (unsigned)test_errors);
+      return -1;
+   }
+
+   if (debug_flush() != 0) {
+      TEST_FAIL("empty queue flushed again");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Errors that find the queue full are counted and dropped.
+ */
+static int test_debug_overflow(void)
+{
+   test_callbacks();
+   const uint32_t lost = debug_overflows();
+
+   for (uint32_t i = 0; i < DEBUG_QUEUE + 3; i++)
+      test_site_a();
+   if (debug_overflows() - lost != 3) {
+      TEST_FAIL("%u overflows counted", (unsigned)(debug_overflows() - lost));
+      return -1;
+   }
+
+   if ((debug_flush() != DEBUG_QUEUE) || (test_errors != DEBUG_QUEUE)) {
+      TEST_FAIL("queue did not keep the first errors");
+      return -1;
+   }
+
+   // room again after the flush
+   test_site_a();
+   if ((debug_flush() != 1) || (debug_overflows() - lost != 3)) {
+      TEST_FAIL("queue not reusable after an overflow");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief A queued error goes to the callbacks set when it was stored.
+ */
+static int test_debug_queue_cb(void)
+{
+   test_callbacks();
+
+   test_site_a();
+   debug_set_error_cb(NULL);
+   debug_set_error_id_cb(NULL);
+   debug_flush();
+   if (test_errors != 1) {
+      TEST_FAIL("error passed to the callback set at the flush");
+      return -1;
+   }
+
+   test_site_a();
+   test_callbacks();
+   if (test_errors != 0) {
+      TEST_FAIL("error passed to the callback set after it was stored");
+      return -1;
+   }
+
+   return 0;
+}
+
+// calls of the queue lock, its depth, and errors passed on while locked
+static uint32_t test_locks;
+static int test_lock_depth;
+static bool test_cb_locked;
+
+static void test_lock(void)
+{
+   test_locks++;
+   test_lock_depth++;
+}
+
+static void test_unlock(void)
+{
+   test_lock_depth--;
+}
+
+static void test_locked_cb(const char *fn, const char *file, int line,
+                           const char *msg)
+{
+   test_error_cb(fn, file, line, msg);
+   test_cb_locked |= (test_lock_depth != 0);
+}
+
+static void test_locked_id_cb(uint32_t id)
+{
+   test_error_id_cb(id);
+   test_cb_locked |= (test_lock_depth != 0);
+}
+
+/**
+ * @brief The lock guards each store and each error taken out of the queue,
+ * but not the callbacks.
+ */
+static int test_debug_queue_lock(void)
+{
+   test_callbacks();
+   debug_set_error_cb(test_locked_cb);
+   debug_set_error_id_cb(test_locked_id_cb);
+   debug_set_queue_lock(test_lock, test_unlock);
+   test_locks     = 0;
+   test_cb_locked = false;
+
+   test_site_a();
+   test_site_b();
+   const uint32_t num = debug_flush();
+   debug_set_queue_lock(NULL, NULL);
+
+   // two stores, two errors taken, and one look at the empty queue
+   if ((num != 2) || (test_errors != 2) || (test_locks != 5) ||
+       (test_lock_depth != 0)) {
+      TEST_FAIL("%u locks for %u errors", (unsigned)test_locks,
+                (unsigned)test_errors);
+      return -1;
+   }
+
+   if (test_cb_locked) {
+      TEST_FAIL("callback called with the queue locked");
+      return -1;
+   }
+
+   return 0;
+}
+#endif
+
+#if TEST_THREADS && DEBUG_QUEUE
+static pthread_mutex_t test_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t test_count_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// errors passed on, by whichever thread flushed them
+static uint32_t test_queue_errors;
+
+static void test_queue_lock(void)
+{
+   pthread_mutex_lock(&test_queue_mutex);
+}
+
+static void test_queue_unlock(void)
+{
+   pthread_mutex_unlock(&test_queue_mutex);
+}
+
+static void test_queue_count(void)
+{
+   pthread_mutex_lock(&test_count_mutex);
+   test_queue_errors++;
+   pthread_mutex_unlock(&test_count_mutex);
+}
+
+static void test_queue_cb(const char *fn, const char *file, int line,
+                          const char *msg)
+{
+   (void)fn;
+   (void)file;
+   (void)line;
+   (void)msg;
+   test_queue_count();
+}
+
+static void test_queue_id_cb(uint32_t id)
+{
+   (void)id;
+   test_queue_count();
+}
+
+/**
+ * @brief Report errors and flush the queue, in parallel with other threads.
+ */
+static void *test_queue_run(void *arg)
+{
+   debug_set_error_cb(test_queue_cb);
+   debug_set_error_id_cb(test_queue_id_cb);
+
+   for (uint32_t i = 0; i < TEST_THREAD_ITERS; i++) {
+      test_site_a();
+      debug_flush();
+   }
+
+   return arg;
+}
+
+/**
+ * @brief With the lock set, each error stored by several threads at once is
+ * either passed on exactly once or counted as lost.
+ */
+static int test_debug_queue_threads(void)
+{
+   test_callbacks();
+   debug_set_queue_lock(test_queue_lock, test_queue_unlock);
+   const uint32_t lost = debug_overflows();
+   test_queue_errors   = 0;
+
+   pthread_t t[TEST_THREAD_NUM];
+   uint32_t started = 0;
+   while ((started < TEST_THREAD_NUM) &&
+          !pthread_create(&t[started], NULL, test_queue_run, NULL))
+      started++;
+
+   for (uint32_t i = 0; i < started; i++)
+      pthread_join(t[i], NULL);
+
+   debug_flush();
+   debug_set_queue_lock(NULL, NULL);
+
+   if (started != TEST_THREAD_NUM) {
+      TEST_FAIL("cannot start thread %u", (unsigned)started);
+      return -1;
+   }
+
+   const uint32_t dropped = debug_overflows() - lost;
+   if (test_queue_errors + dropped != TEST_THREAD_NUM * TEST_THREAD_ITERS) {
+      TEST_FAIL("%u errors passed on, %u lost", (unsigned)test_queue_errors,
+                (unsigned)dropped);
+      return -1;
+   }
+
+   if (test_errors != 0) {
+      TEST_FAIL("thread errors reported to the main thread's callbacks");
+      return -1;
+   }
+
+   return 0;
+}
+#endif
+
+int test_debug(void)
+{
+   static int (*valid_fn[])(void) = {
+#if DEBUG_RATE_LIMIT
+       test_debug_limit,
+       test_debug_period,
+#endif
+       test_debug_unlimited,
+       test_debug_last,
+#if TEST_THREADS && !DEBUG_QUEUE
+       test_debug_threads,
+#endif
+#if DEBUG_QUEUE
+       test_debug_queue,
+       test_debug_overflow,
+       test_debug_queue_cb,
+       test_debug_queue_lock,
+#endif
+#if TEST_THREADS && DEBUG_QUEUE
+       test_debug_queue_threads,
+#endif
+       NULL};
+
+   static int (*invalid_fn[])(void) = {NULL};
+
+   const int ret = test_runner(valid_fn, invalid_fn);
+#if DEBUG_RATE_LIMIT
+   debug_set_rate_limit(0);
+#endif
+   if (ret != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_debug.c
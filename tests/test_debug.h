@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_debug.h
+ * @brief Tests for the error reporting of debug.c.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#ifndef TEST_DEBUG_H
+#define TEST_DEBUG_H
+
+/**
+ * @brief Run the tests of debug.c.
+ *
+ * The tests replace the error callbacks, so run them after all other tests.
+ */
+int test_debug(void);
+
+#endif // TEST_DEBUG_H
+
+// end file test_debug.h
@@ -0,0 +1,98 @@
+# SPDX-License-Identifier: MIT
+"""
+test_debug_ids.py - Tests for the error site ID decoder
+
+Run from the top of the repository:
+
+    python3 tests/test_debug_ids.py
+
+Author: Jakob Kastelic
+Copyright (c) 2025 Stanford Research Systems, Inc.
+"""
+
+import os
+import sys
+import tempfile
+import unittest
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(ROOT, 'scripts'))
+
+import debug_ids  # noqa: E402 pylint: disable=wrong-import-position
+
+SOURCE = '''\
+#define DEBUG_FILE_ID 7
+#include "utils/debug.h"
+
+int test_fn(int x)
+{
+   if (x < 0) {
+      ERROR("negative x");
+      return -1;
+   }
+   return 0;
+}
+'''
+
+
+class TestDebugIds(unittest.TestCase):
+    """Decoding of site IDs, and the checks of the file IDs."""
+
+    def setUp(self) -> None:
+        self.dir = tempfile.TemporaryDirectory()
+        self.paths = []
+
+    def tearDown(self) -> None:
+        self.dir.cleanup()
+
+    def source(self, name: str, text: str) -> str:
+        """Write a source file to scan."""
+        path = os.path.join(self.dir.name, name)
+        with open(path, 'w', encoding='utf-8') as f:
+            f.write(text)
+        self.paths.append(path)
+        return path
+
+    def test_decode(self) -> None:
+        path = self.source('a.c', SOURCE)
+        table = debug_ids.build_table(self.paths)
+
+        self.assertEqual(list(table), [0x00070007])
+        self.assertEqual(debug_ids.decode_token('0x00070007', table),
+                         f'{path}:7: test_fn: negative x')
+        self.assertIn('unknown site: file 7, line 8',
+                      debug_ids.decode_token('0x00070008', table))
+
+    def test_other_tokens(self) -> None:
+        self.source('a.c', SOURCE)
+        table = debug_ids.build_table(self.paths)
+
+        # only 0x and eight hex digits are site IDs
+        for token in ('458759', '0x70007', '0x000700070', '0x0007000g',
+                      '0X00070007', 'error:', ''):
+            self.assertEqual(debug_ids.decode_token(token, table), token)
+
+    def test_check(self) -> None:
+        self.source('a.c', SOURCE)
+        self.assertEqual(debug_ids.check_ids(self.paths), [])
+
+        # same file ID twice, and error sites without a file ID
+        self.source('b.c', SOURCE)
+        self.source('c.c', SOURCE.replace('#define DEBUG_FILE_ID 7', ''))
+        errors = debug_ids.check_ids(self.paths)
+        self.assertEqual(len(errors), 2)
+        self.assertIn('also used in', errors[0])
+        self.assertIn('no DEBUG_FILE_ID', errors[1])
+
+    def test_repository(self) -> None:
+        paths = []
+        for d in ('utils', 'tests', 'bench'):
+            for name in sorted(os.listdir(os.path.join(ROOT, d))):
+                if name.endswith('.c'):
+                    paths.append(os.path.join(ROOT, d, name))
+
+        self.assertEqual(debug_ids.check_ids(paths), [])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -19,6 +19,22 @@ int test_reg_desc(void);
 int test_reg_multi(void);
 int test_reg_virt_check(void);
 int test_reg_virt(void);
+int test_reg_mmio(void);
+int test_reg_page(void);
+int test_reg_sparse(void);
+int test_reg_narrow(void);
+int test_reg_kernel(void);
+int test_reg_id(void);
+int test_reg_packed(void);
+int test_reg_map(void);
+int test_reg_group(void);
+int test_reg_chain(void);
+int test_reg_stats(void);
+int test_reg_trace(void);
+int test_reg_replay(void);
+int test_reg_cost(void);
+int test_reg_sim(void);
+int test_reg_hist(void);
 
 #endif // TEST_REG_H
 
@@ -16,21 +16,6 @@
 
 uint32_t write_data[3] = {0};
 
-static uint32_t mock_read_fn(int arg, size_t reg)
-{
-   (void)arg;
-   (void)reg;
-   return 0;
-}
-
-static int mock_write_fn(int arg, size_t reg, uint32_t val)
-{
-   (void)arg;
-   (void)reg;
-   (void)val;
-   return 0;
-}
-
 static const struct reg_field test_dev_map[] = {
     // name              reg off wd  flags
     {"PLL_NUM", 43, 0, 32, 0},
@@ -47,10 +32,10 @@ static int test_reg_bulk_simple(void)
    struct reg_dev dev  = {
         .reg_width = 32,
         .reg_num   = 3,
-        .read_fn   = mock_read_fn,
+        .read_fn   = test_bus_read,
         .field_map = test_dev_map,
         .data      = temp,
-        .write_fn  = mock_write_fn,
+        .write_fn  = test_bus_write,
    };
 
    if (reg_bulk(&dev, initial) != 0) {
@@ -88,10 +73,10 @@ static int test_reg_bulk_zero_regs(void)
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = 0,
-       .read_fn   = mock_read_fn,
+       .read_fn   = test_bus_read,
        .field_map = test_dev_map,
        .data      = write_data,
-       .write_fn  = mock_write_fn,
+       .write_fn  = test_bus_write,
    };
 
    if (reg_bulk(&dev, NULL) != 0) {
@@ -119,10 +104,10 @@ static int test_reg_bulk_large(void)
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = N,
-       .read_fn   = mock_read_fn,
+       .read_fn   = test_bus_read,
        .field_map = test_dev_map,
        .data      = buffer,
-       .write_fn  = mock_write_fn,
+       .write_fn  = test_bus_write,
    };
 
    if (reg_bulk(&dev, initial) != 0) {
@@ -162,10 +147,10 @@ static int test_reg_bulk_null_storage(void)
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = 2,
-       .read_fn   = mock_read_fn,
+       .read_fn   = test_bus_read,
        .field_map = test_dev_map,
        .data      = NULL,
-       .write_fn  = mock_write_fn,
+       .write_fn  = test_bus_write,
    };
 
    if (reg_bulk(&dev, input) == 0) {
@@ -185,10 +170,10 @@ static int test_reg_bulk_zero_width(void)
    struct reg_dev dev = {
        .reg_width = 0,
        .reg_num   = 2,
-       .read_fn   = mock_read_fn,
+       .read_fn   = test_bus_read,
        .field_map = test_dev_map,
        .data      = buf,
-       .write_fn  = mock_write_fn,
+       .write_fn  = test_bus_write,
    };
 
    // Depending on implementation policy, this may or may not be valid.
@@ -210,10 +195,10 @@ static int test_reg_bulk_single_clear(void)
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = 1,
-       .read_fn   = mock_read_fn,
+       .read_fn   = test_bus_read,
        .field_map = test_dev_map,
        .data      = &word,
-       .write_fn  = mock_write_fn,
+       .write_fn  = test_bus_write,
    };
 
    if (reg_bulk(&dev, NULL) != 0) {
@@ -239,10 +224,10 @@ static int test_reg_bulk_weird_width(void)
    struct reg_dev dev = {
        .reg_width = 24, // Not 32, but irrelevant for copying
        .reg_num   = 2,
-       .read_fn   = mock_read_fn,
+       .read_fn   = test_bus_read,
        .field_map = test_dev_map,
        .data      = dst,
-       .write_fn  = mock_write_fn,
+       .write_fn  = test_bus_write,
    };
 
    if (reg_bulk(&dev, src) != 0) {
@@ -266,10 +251,10 @@ static int test_reg_bulk_null_data_storage(void)
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = 2,
-       .read_fn   = mock_read_fn,
+       .read_fn   = test_bus_read,
        .field_map = test_dev_map,
        .data      = NULL,
-       .write_fn  = mock_write_fn,
+       .write_fn  = test_bus_write,
    };
 
    if (reg_bulk(&dev, NULL) == 0) {
@@ -295,10 +280,10 @@ static int test_reg_bulk_incomplete_input_data(void)
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = 10,
-       .read_fn   = mock_read_fn,
+       .read_fn   = test_bus_read,
        .field_map = test_dev_map,
        .data      = dst,
-       .write_fn  = mock_write_fn,
+       .write_fn  = test_bus_write,
    };
 
    // Only partial data initialized (simulate caller bug)
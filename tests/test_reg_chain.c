@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_chain.c
+ * @brief Tests for daisy-chained devices.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_CHAIN_DEV    3U
+#define TEST_CHAIN_REGS   3U
+#define TEST_CHAIN_NOP    0xdeadU
+#define TEST_CHAIN_FRAMES 8U
+
+static const struct reg_field test_fields[] = {
+    // name  reg off wd  flags
+    {"CODE",  0,  0,  16, 0},
+    {"WIDE",  1,  0,  32, 0}, // registers 1 and 2
+    {NULL,    0,  0,  0,  0}
+};
+
+// frames shifted through the chain
+static size_t frame_regs[TEST_CHAIN_FRAMES];
+static uint32_t frames[TEST_CHAIN_FRAMES][TEST_CHAIN_DEV];
+static size_t frame_num;
+
+static int test_chain_fn(int arg, size_t reg, const uint32_t *vals)
+{
+   (void)arg;
+   if (frame_num >= TEST_CHAIN_FRAMES)
+      return -1;
+
+   frame_regs[frame_num] = reg;
+   memcpy(frames[frame_num], vals, sizeof(frames[0]));
+   frame_num++;
+   return 0;
+}
+
+static uint32_t data[TEST_CHAIN_DEV][TEST_CHAIN_REGS];
+static struct reg_dev devs[TEST_CHAIN_DEV];
+static uint32_t vals[TEST_CHAIN_DEV];
+
+static struct reg_chain test_chain(void)
+{
+   memset(data, 0, sizeof(data));
+   frame_num = 0;
+
+   for (size_t i = 0; i < TEST_CHAIN_DEV; i++)
+      devs[i] = test_bus_dev((int)i, test_fields, 16, TEST_CHAIN_REGS, data[i]);
+
+   return (struct reg_chain){
+       .devs     = devs,
+       .dev_num  = TEST_CHAIN_DEV,
+       .write_fn = test_chain_fn,
+       .vals     = vals,
+       .nop      = TEST_CHAIN_NOP,
+   };
+}
+
+/**
+ * @brief Compare a frame against the expected register and words.
+ */
+static int test_frame(const size_t n, const size_t reg, const uint32_t a,
+                      const uint32_t b, const uint32_t c)
+{
+   if ((frame_regs[n] != reg) || (frames[n][0] != a) || (frames[n][1] != b) ||
+       (frames[n][2] != c)) {
+      TEST_FAIL("frame %zu: reg %zu, 0x%" PRIx32 " 0x%" PRIx32 " 0x%" PRIx32,
+                n, frame_regs[n], frames[n][0], frames[n][1], frames[n][2]);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Setting one device sends nop to the others.
+ */
+static int test_chain_one(void)
+{
+   struct reg_chain chain = test_chain();
+
+   if (reg_chain_set_one(&chain, 1, "CODE", 0x1234U)) {
+      TEST_FAIL("reg_chain_set_one failed");
+      return -1;
+   }
+
+   if ((frame_num != 1) || (test_bus_writes() != 0) ||
+       test_frame(0, 0, TEST_CHAIN_NOP, 0x1234U, TEST_CHAIN_NOP))
+      return -1;
+
+   if ((data[1][0] != 0x1234U) || (data[0][0] != 0) || (data[2][0] != 0)) {
+      TEST_FAIL("wrong buffer contents");
+      return -1;
+   }
+
+   // setting the same value again sends nothing
+   if (reg_chain_set_one(&chain, 1, "CODE", 0x1234U) || (frame_num != 1)) {
+      TEST_FAIL("unchanged register sent to chain");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Setting all devices sends nop only for unchanged registers.
+ */
+static int test_chain_all(void)
+{
+   struct reg_chain chain = test_chain();
+
+   static const uint64_t codes[TEST_CHAIN_DEV] = {0x1111U, 0, 0x3333U};
+   if (reg_chain_set(&chain, "CODE", codes) || (frame_num != 1) ||
+       test_frame(0, 0, 0x1111U, TEST_CHAIN_NOP, 0x3333U))
+      return -1;
+
+   // only the upper register changes in device 0, both in device 2
+   static const uint64_t wide[TEST_CHAIN_DEV] = {0x10000U, 0, 0x20002U};
+   if (reg_chain_set(&chain, "WIDE", wide) || (frame_num != 3) ||
+       test_frame(1, 1, TEST_CHAIN_NOP, TEST_CHAIN_NOP, 0x2U) ||
+       test_frame(2, 2, 0x1U, TEST_CHAIN_NOP, 0x2U))
+      return -1;
+
+   if ((reg_get(&devs[0], "WIDE") != 0x10000U) ||
+       (reg_get(&devs[2], "WIDE") != 0x20002U)) {
+      TEST_FAIL("wrong buffer contents");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief REG_NOCOMM on all devices updates the buffers only.
+ */
+static int test_chain_nocomm(void)
+{
+   struct reg_chain chain = test_chain();
+   for (size_t i = 0; i < TEST_CHAIN_DEV; i++)
+      devs[i].flags = REG_NOCOMM;
+
+   if (reg_chain_set_one(&chain, 2, "CODE", 0x55U) || (frame_num != 0) ||
+       (data[2][0] != 0x55U)) {
+      TEST_FAIL("REG_NOCOMM chain sent a frame");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Invalid chains and arguments.
+ */
+static int test_chain_invalid(void)
+{
+   struct reg_chain chain = test_chain();
+
+   if (reg_chain_set_one(&chain, TEST_CHAIN_DEV, "CODE", 1) == 0) {
+      TEST_FAIL("device outside chain accepted");
+      return -1;
+   }
+
+   if ((reg_chain_set(&chain, "CODE", NULL) == 0) ||
+       (reg_chain_set_one(&chain, 0, "NOPE", 1) == 0)) {
+      TEST_FAIL("missing values or unknown field accepted");
+      return -1;
+   }
+
+   static const uint64_t codes[TEST_CHAIN_DEV] = {1, 0x10000U, 3};
+   if ((reg_chain_set(&chain, "CODE", codes) == 0) || (data[0][0] != 0)) {
+      TEST_FAIL("value too large accepted");
+      return -1;
+   }
+
+   chain.write_fn = NULL;
+   if (reg_chain_set_one(&chain, 0, "CODE", 1) == 0) {
+      TEST_FAIL("chain without write_fn accepted");
+      return -1;
+   }
+
+   // unchanged registers cannot be found in buffers that the devices bypass
+   static uint32_t window[TEST_CHAIN_DEV][TEST_CHAIN_REGS];
+   chain = test_chain();
+   for (size_t i = 0; i < TEST_CHAIN_DEV; i++) {
+      devs[i].mmio        = window[i];
+      devs[i].mmio_stride = 1;
+      devs[i].flags       = REG_DIRECT;
+   }
+   if (reg_chain_set_one(&chain, 0, "CODE", 1) == 0) {
+      TEST_FAIL("chain of REG_DIRECT devices accepted");
+      return -1;
+   }
+
+   if ((frame_num != 0) || (test_bus_writes() != 0)) {
+      TEST_FAIL("failed chain access sent a frame");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_chain(void)
+{
+   static int (*valid_fn[])(void) = {test_chain_one, test_chain_all,
+                                     test_chain_nocomm, NULL};
+
+   static int (*invalid_fn[])(void) = {test_chain_invalid, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_chain.c
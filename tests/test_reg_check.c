@@ -78,8 +78,9 @@ static int test_reg_check_map(const struct map_test *mt, size_t len)
          patched.write_fn  = test_write_fn;
       }
 
-      // test reg_fwidth()
-      if (test_reg_fwidth(&patched)) {
+      // test reg_fwidth(), which trusts the map at check level 0
+      if ((mt[i].expect_ok || (REG_CHECK_LEVEL >= 1)) &&
+          test_reg_fwidth(&patched)) {
          TEST_FAIL("error in testing fwidth");
          return -1;
       }
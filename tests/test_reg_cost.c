@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_cost.c
+ * @brief Tests pinning the number of bus operations of common scenarios.
+ *
+ * Any change that adds bus traffic to these scenarios makes the tests fail.
+ * If the extra traffic is intended, update the expected counts.
+ *
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_COST_REGS 8U
+
+static const struct reg_field test_fields[] = {
+    // name  reg off wd  flags
+    {"EN",    0,  0,  1,  0           },
+    {"MODE",  0,  1,  15, 0           },
+    {"MID",   1,  8,  32, 0           }, // registers 1, 2, and 3
+    {"LONG",  4,  0,  64, 0           }, // registers 4 to 7
+    {"STAT",  3,  8,  8,  REG_VOLATILE},
+    {NULL,    0,  0,  0,  0           }
+};
+
+static uint32_t data[TEST_BUS_DEV][TEST_COST_REGS];
+
+static struct reg_dev test_dev(const int arg)
+{
+   memset(data[arg], 0, sizeof(data[arg]));
+   return test_bus_dev(arg, test_fields, 16, TEST_COST_REGS, data[arg]);
+}
+
+/**
+ * @brief A single-register field is one write, and reading it is free.
+ */
+static int test_cost_single(void)
+{
+   test_bus_reset();
+   struct reg_dev dev = test_dev(0);
+
+   if (reg_set(&dev, "MODE", 0x1234) || TEST_BUS_COUNT(0, 0, 1, 0))
+      return -1;
+
+   // fields sharing a register are merged in the buffer, not re-read
+   if (reg_set(&dev, "EN", 1) || TEST_BUS_COUNT(0, 0, 1, 0) ||
+       (test_bus[0].regs[0] != 0x2469U))
+      return -1;
+
+   if ((reg_get(&dev, "MODE") != 0x1234) || TEST_BUS_COUNT(0, 0, 0, 0))
+      return -1;
+
+   // REG_NOCOMM updates the buffer only
+   dev.flags = REG_NOCOMM;
+   if (reg_set(&dev, "MODE", 1) || TEST_BUS_COUNT(0, 0, 0, 0))
+      return -1;
+
+   return 0;
+}
+
+/**
+ * @brief Multi-register fields write each register they touch once.
+ */
+static int test_cost_multi(void)
+{
+   test_bus_reset();
+   struct reg_dev dev = test_dev(0);
+
+   if (reg_set(&dev, "MID", 0x12345678U) || TEST_BUS_COUNT(0, 0, 3, 0))
+      return -1;
+
+   if (reg_set(&dev, "LONG", 0x0123456789abcdefULL) ||
+       TEST_BUS_COUNT(0, 0, 4, 0))
+      return -1;
+
+   // volatile fields are re-read on each get, and nothing else is
+   test_bus[0].regs[3] = 0xab00U;
+   if ((reg_get(&dev, "STAT") != 0xab) || (reg_get(&dev, "MID") == 0) ||
+       TEST_BUS_COUNT(0, 1, 0, 0))
+      return -1;
+
+   // a paged device selects each page once, while the register is on it
+   struct reg_ext ext = {.page_len = 4, .page_fn = test_bus_page};
+   dev                = test_dev(0);
+   dev.ext            = &ext;
+   if (reg_set(&dev, "MID", 0x12345678U) ||
+       reg_set(&dev, "LONG", 0x0123456789abcdefULL) ||
+       TEST_BUS_COUNT(0, 0, 7, 0) || (test_bus[0].pages != 2)) {
+      TEST_FAIL("%zu page selections", test_bus[0].pages);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Switching the map of a virtual device is one load, then the reset.
+ */
+static int test_cost_virt(void)
+{
+   static const struct reg_field map1[] = {
+       {"A",  0, 0, 8, 0},
+       {"B",  0, 8, 8, 0},
+       {"C",  1, 0, 8, 0},
+       {NULL, 0, 0, 0, 0}
+   };
+
+   static const struct reg_field map2[] = {
+       {"A",  0, 0, 16, 0},
+       {"B",  1, 0, 16, 0},
+       {"C",  2, 0, 16, 0},
+       {NULL, 0, 0, 0,  0}
+   };
+
+   static const char *fields[]            = {"A", "B", "C", NULL};
+   static const struct reg_field *maps[] = {map1, map2, NULL};
+
+   test_bus_reset();
+   uint64_t virt_data[3] = {0};
+   struct reg_virt v = {
+       .fields  = fields,
+       .data    = virt_data,
+       .maps    = maps,
+       .load_fn = test_bus_load,
+       .base    = test_dev(1),
+   };
+   v.base.field_map = NULL;
+
+   // the default map is loaded on first use
+   if (reg_adjust(&v, "A", 0x11) || TEST_BUS_COUNT(1, 0, 1, 1))
+      return -1;
+
+   // a field that fits the current map is a plain set
+   if (reg_adjust(&v, "C", 0x22) || TEST_BUS_COUNT(1, 0, 1, 0))
+      return -1;
+
+   // a value that needs the other map re-sets all three fields
+   if (reg_adjust(&v, "B", 0x333) || TEST_BUS_COUNT(1, 0, 3, 1))
+      return -1;
+
+   if ((reg_obtain(&v, "B") != 0x333) || TEST_BUS_COUNT(1, 0, 0, 0))
+      return -1;
+
+   return 0;
+}
+
+/**
+ * @brief Loading a set of register values, then applying it to devices.
+ *
+ * Importing values with reg_bulk() costs no bus traffic; writing a field to a
+ * group is one group write per register, with no device writes.
+ */
+static int test_cost_apply(void)
+{
+   test_bus_reset();
+   struct reg_dev devs[TEST_BUS_DEV];
+   for (size_t i = 0; i < TEST_BUS_DEV; i++)
+      devs[i] = test_dev((int)i);
+
+   static const uint32_t preset[TEST_COST_REGS] = {1, 2, 3, 4, 5, 6, 7, 8};
+   if (reg_bulk(&devs[0], preset) || TEST_BUS_COUNT(0, 0, 0, 0))
+      return -1;
+
+   uint32_t vals[TEST_BUS_DEV];
+   struct reg_group grp = {
+       .devs     = devs,
+       .dev_num  = TEST_BUS_DEV,
+       .write_fn = test_bus_group,
+       .vals     = vals,
+   };
+
+   if (reg_group_set(&grp, "MID", 0x12345678U) || (test_bus[0].groups != 3)) {
+      TEST_FAIL("%zu group writes", test_bus[0].groups);
+      return -1;
+   }
+
+   for (int i = 0; i < (int)TEST_BUS_DEV; i++)
+      if (TEST_BUS_COUNT(i, 0, 0, 0))
+         return -1;
+
+   // without a group write, each device writes its own registers
+   grp.write_fn = NULL;
+   if (reg_group_set(&grp, "EN", 1))
+      return -1;
+
+   for (int i = 0; i < (int)TEST_BUS_DEV; i++)
+      if (TEST_BUS_COUNT(i, 0, 1, 0))
+         return -1;
+
+   return 0;
+}
+
+int test_reg_cost(void)
+{
+   static int (*valid_fn[])(void) = {test_cost_single, test_cost_multi,
+                                     test_cost_virt, test_cost_apply, NULL};
+
+   static int (*invalid_fn[])(void) = {NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_cost.c
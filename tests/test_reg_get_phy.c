@@ -191,6 +191,8 @@ static int test_reg_read_invalid_field(void)
  */
 static int test_reg_read_null_device(void)
 {
+   TEST_NEED_CHECKS(1);
+
    uint64_t val_read = reg_get(NULL, "bit4");
    if (val_read != 0) {
       TEST_FAIL("reg_get returned non-zero for NULL device");
@@ -247,6 +249,8 @@ static int test_reg_read_null_field(void)
  */
 static int test_reg_read_missing_read_fn(void)
 {
+   TEST_NEED_CHECKS(1);
+
    static const struct reg_field fields[] = {
        {"bit4", 0, 0, 4, REG_VOLATILE},
        {NULL,   0, 0, 0, REG_VOLATILE}
@@ -0,0 +1,331 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_group.c
+ * @brief Tests for setting fields across a group of identical devices.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_GROUP_DEV  4U
+#define TEST_GROUP_REGS 4U
+
+static const struct reg_field test_fields[] = {
+    // name  reg off wd  flags
+    {"EN",    0,  0,  1,  0         },
+    {"MODE",  0,  1,  15, 0         },
+    {"FTW",   1,  0,  32, 0         }, // registers 1 and 2
+    {"SIM",   3,  0,  16, REG_NOCOMM},
+    {NULL,    0,  0,  0,  0         }
+};
+
+static int locks[TEST_GROUP_DEV];
+static int lock_fail;
+
+// group transactions: register and value for each device
+static size_t grp_regs[8];
+static uint32_t grp_vals[8][TEST_GROUP_DEV];
+static size_t grp_writes;
+
+static int test_group_fn(int arg, size_t reg, const uint32_t *vals)
+{
+   (void)arg;
+   if (grp_writes >= 8)
+      return -1;
+
+   grp_regs[grp_writes] = reg;
+   memcpy(grp_vals[grp_writes], vals, sizeof(grp_vals[0]));
+   grp_writes++;
+   return 0;
+}
+
+static int test_lock_fn(void *mutex)
+{
+   const int i = *(int *)mutex;
+   if (i == lock_fail)
+      return -1;
+   locks[i]++;
+   return 0;
+}
+
+static int test_unlock_fn(void *mutex)
+{
+   locks[*(int *)mutex]--;
+   return 0;
+}
+
+static uint32_t data[TEST_GROUP_DEV][TEST_GROUP_REGS];
+static struct reg_dev devs[TEST_GROUP_DEV];
+static uint32_t vals[TEST_GROUP_DEV];
+static int mutexes[TEST_GROUP_DEV];
+
+static struct reg_group test_group(void)
+{
+   memset(data, 0, sizeof(data));
+   memset(locks, 0, sizeof(locks));
+   grp_writes = 0;
+   lock_fail  = -1;
+
+   for (size_t i = 0; i < TEST_GROUP_DEV; i++) {
+      devs[i] = test_bus_dev((int)i, test_fields, 16, TEST_GROUP_REGS, data[i]);
+
+      mutexes[i]        = (int)i;
+      devs[i].mutex     = &mutexes[i];
+      devs[i].lock_fn   = test_lock_fn;
+      devs[i].unlock_fn = test_unlock_fn;
+   }
+
+   return (struct reg_group){
+       .devs    = devs,
+       .dev_num = TEST_GROUP_DEV,
+   };
+}
+
+/**
+ * @brief Without a group write_fn, each device writes its own registers.
+ */
+static int test_group_devices(void)
+{
+   struct reg_group grp = test_group();
+
+   if (reg_group_set(&grp, "FTW", 0x12345678U)) {
+      TEST_FAIL("reg_group_set failed");
+      return -1;
+   }
+
+   for (size_t i = 0; i < TEST_GROUP_DEV; i++)
+      if ((test_bus[i].regs[1] != 0x5678U) ||
+          (test_bus[i].regs[2] != 0x1234U) || (data[i][2] != 0x1234U) ||
+          (locks[i] != 0)) {
+         TEST_FAIL("device %zu not updated", i);
+         return -1;
+      }
+
+   if (test_bus_writes() != 2 * TEST_GROUP_DEV) {
+      TEST_FAIL("%zu device writes", test_bus_writes());
+      return -1;
+   }
+
+   static const uint64_t modes[TEST_GROUP_DEV] = {1, 2, 3, 0x7fff};
+   if (reg_group_set_each(&grp, "MODE", modes)) {
+      TEST_FAIL("reg_group_set_each failed");
+      return -1;
+   }
+
+   for (size_t i = 0; i < TEST_GROUP_DEV; i++)
+      if (reg_get(&devs[i], "MODE") != modes[i]) {
+         TEST_FAIL("device %zu has wrong MODE", i);
+         return -1;
+      }
+
+   return 0;
+}
+
+/**
+ * @brief With a group write_fn, each register is written once for all.
+ */
+static int test_group_broadcast(void)
+{
+   struct reg_group grp = test_group();
+   grp.write_fn         = test_group_fn;
+   grp.vals             = vals;
+
+   static const uint64_t ftw[TEST_GROUP_DEV] = {0x10001U, 0x20002U, 0x30003U,
+                                                0x40004U};
+   if (reg_group_set_each(&grp, "FTW", ftw)) {
+      TEST_FAIL("reg_group_set_each failed");
+      return -1;
+   }
+
+   if ((test_bus_writes() != 0) || (grp_writes != 2) || (grp_regs[0] != 1) ||
+       (grp_regs[1] != 2)) {
+      TEST_FAIL("%zu device writes, %zu group writes", test_bus_writes(),
+                grp_writes);
+      return -1;
+   }
+
+   for (size_t i = 0; i < TEST_GROUP_DEV; i++)
+      if ((grp_vals[0][i] != i + 1) || (grp_vals[1][i] != i + 1) ||
+          (reg_get(&devs[i], "FTW") != ftw[i])) {
+         TEST_FAIL("wrong value for device %zu", i);
+         return -1;
+      }
+
+   // the rest of the register is taken from each buffer
+   data[2][0] = 1U;
+   if (reg_group_set(&grp, "MODE", 0x100) || (grp_writes != 3) ||
+       (grp_vals[2][0] != 0x200U) || (grp_vals[2][2] != 0x201U)) {
+      TEST_FAIL("MODE not merged with EN");
+      return -1;
+   }
+
+   // registers written most significant first
+   for (size_t i = 0; i < TEST_GROUP_DEV; i++)
+      devs[i].flags = REG_MSR_FIRST;
+   if (reg_group_set(&grp, "FTW", 0xabcd0000U) || (grp_writes != 5) ||
+       (grp_regs[3] != 2) || (grp_vals[3][1] != 0xabcdU)) {
+      TEST_FAIL("REG_MSR_FIRST not honored");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief REG_NOCOMM on the field or all devices skips the group write.
+ */
+static int test_group_nocomm(void)
+{
+   struct reg_group grp = test_group();
+   grp.write_fn         = test_group_fn;
+   grp.vals             = vals;
+
+   if (reg_group_set(&grp, "SIM", 0x55) || (grp_writes != 0) ||
+       (data[3][3] != 0x55U)) {
+      TEST_FAIL("REG_NOCOMM field written to the group");
+      return -1;
+   }
+
+   for (size_t i = 0; i < TEST_GROUP_DEV; i++)
+      devs[i].flags = REG_NOCOMM;
+   if (reg_group_set(&grp, "EN", 1) || (grp_writes != 0) || (data[1][0] != 1)) {
+      TEST_FAIL("REG_NOCOMM devices written to the group");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief No device is modified if any value is too large.
+ */
+static int test_group_too_large(void)
+{
+   struct reg_group grp = test_group();
+
+   static const uint64_t modes[TEST_GROUP_DEV] = {1, 2, 3, 0x8000};
+   if (reg_group_set_each(&grp, "MODE", modes) == 0) {
+      TEST_FAIL("reg_group_set_each accepted 16 bits in a 15-bit field");
+      return -1;
+   }
+
+   if ((data[0][0] != 0) || (test_bus_writes() != 0) || (locks[0] != 0)) {
+      TEST_FAIL("failed group set modified a device");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Devices in a group must be alike.
+ */
+static int test_group_mismatch(void)
+{
+   static const struct reg_field other[] = {
+       {"EN",   0, 0, 16, 0},
+       {NULL,   0, 0, 0,  0}
+   };
+
+   struct reg_group grp = test_group();
+   devs[2].field_map    = other;
+   if (reg_group_set(&grp, "EN", 1) == 0) {
+      TEST_FAIL("group with different maps accepted");
+      return -1;
+   }
+
+   grp          = test_group();
+   grp.write_fn = test_group_fn;
+   grp.vals     = vals;
+   devs[3].data = NULL;
+   if (reg_group_set(&grp, "EN", 1) == 0) {
+      TEST_FAIL("group write without data buffer accepted");
+      return -1;
+   }
+
+   grp           = test_group();
+   grp.write_fn  = test_group_fn;
+   grp.vals      = vals;
+   devs[1].flags = REG_NOCOMM;
+   if ((reg_group_set(&grp, "EN", 1) == 0) || (grp_writes != 0)) {
+      TEST_FAIL("group with mixed REG_NOCOMM accepted");
+      return -1;
+   }
+
+   grp.vals = NULL;
+   if (reg_group_set(&grp, "EN", 1) == 0) {
+      TEST_FAIL("group write_fn without vals accepted");
+      return -1;
+   }
+
+   // frames cannot be made from buffers that the devices bypass
+   static uint32_t window[TEST_GROUP_DEV][TEST_GROUP_REGS];
+   grp          = test_group();
+   grp.write_fn = test_group_fn;
+   grp.vals     = vals;
+   for (size_t i = 0; i < TEST_GROUP_DEV; i++) {
+      devs[i].mmio        = window[i];
+      devs[i].mmio_stride = 1;
+      devs[i].flags       = REG_DIRECT;
+   }
+   if ((reg_group_set(&grp, "EN", 1) == 0) || (grp_writes != 0)) {
+      TEST_FAIL("group write of REG_DIRECT devices accepted");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief A failed lock releases the devices already locked.
+ */
+static int test_group_lock_fail(void)
+{
+   struct reg_group grp = test_group();
+   lock_fail            = 2;
+
+   if (reg_group_set(&grp, "EN", 1) == 0) {
+      TEST_FAIL("reg_group_set succeeded despite lock failure");
+      return -1;
+   }
+
+   for (size_t i = 0; i < TEST_GROUP_DEV; i++)
+      if ((locks[i] != 0) || (devs[i].lock_count != 0) || (data[i][0] != 0)) {
+         TEST_FAIL("device %zu left locked or modified", i);
+         return -1;
+      }
+
+   if ((reg_group_set(&grp, "NOPE", 1) == 0) ||
+       (reg_group_set_each(&grp, "EN", NULL) == 0)) {
+      TEST_FAIL("invalid field or values accepted");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_group(void)
+{
+   static int (*valid_fn[])(void) = {test_group_devices, test_group_broadcast,
+                                     test_group_nocomm, NULL};
+
+   static int (*invalid_fn[])(void) = {test_group_too_large,
+                                       test_group_mismatch,
+                                       test_group_lock_fail, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_group.c
@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_hist.c
+ * @brief Tests for the latency histograms.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_HIST_REGS 4U
+
+static const struct reg_field test_fields[] = {
+    // name reg off wd  flags
+    {"A",    0,  0,  16, 0},
+    {"W",    1,  0,  32, 0}, // registers 1 and 2
+    {NULL,   0,  0,  0,  0}
+};
+
+// the clock advances only in the callbacks, by the given costs
+static uint32_t now;
+static uint32_t write_cost;
+static uint32_t load_cost;
+
+static uint32_t test_clock_fn(void)
+{
+   return now;
+}
+
+static uint32_t test_read_fn(int arg, size_t reg)
+{
+   (void)arg;
+   (void)reg;
+   return 0;
+}
+
+static int test_write_fn(int arg, size_t reg, uint32_t val)
+{
+   (void)arg;
+   (void)reg;
+   (void)val;
+   now += write_cost;
+   return 0;
+}
+
+static int test_load_fn(int arg, int id)
+{
+   (void)arg;
+   (void)id;
+   now += load_cost;
+   return 0;
+}
+
+static struct reg_hist hist;
+static struct reg_ext ext = {.hist = &hist};
+
+static struct reg_dev test_dev(uint32_t *data)
+{
+   now        = 0x12345678U;
+   write_cost = 10;
+   load_cost  = 1000;
+   hist       = (struct reg_hist){.clock_fn = test_clock_fn};
+
+   return (struct reg_dev){
+       .reg_width = 16,
+       .reg_num   = TEST_HIST_REGS,
+       .field_map = test_fields,
+       .read_fn   = test_read_fn,
+       .write_fn  = test_write_fn,
+       .data      = data,
+       .ext       = &ext,
+   };
+}
+
+// buckets passed to the export callback
+static uint32_t exp_lo[REG_HIST_BUCKETS];
+static uint32_t exp_hi[REG_HIST_BUCKETS];
+static uint32_t exp_count[REG_HIST_BUCKETS];
+static size_t exp_num;
+
+static int test_export_fn(void *ctx, uint32_t lo, uint32_t hi, uint32_t count)
+{
+   (void)ctx;
+   exp_lo[exp_num]    = lo;
+   exp_hi[exp_num]    = hi;
+   exp_count[exp_num] = count;
+   exp_num++;
+   return 0;
+}
+
+static int test_stop_fn(void *ctx, uint32_t lo, uint32_t hi, uint32_t count)
+{
+   (void)ctx;
+   (void)lo;
+   (void)hi;
+   (void)count;
+   return 1;
+}
+
+/**
+ * @brief Each duration falls in a bucket that covers it.
+ */
+static int test_hist_buckets(void)
+{
+   uint32_t data[TEST_HIST_REGS] = {0};
+   struct reg_dev dev            = test_dev(data);
+
+   static const uint32_t costs[] = {0,   1,    3,      4,          5,
+                                    7,   8,    9,      10,         11,
+                                    100, 1000, 123456, 0x80000000U, UINT32_MAX};
+
+   uint32_t prev_hi = 0;
+   for (size_t i = 0; i < sizeof(costs) / sizeof(costs[0]); i++) {
+      reg_hist_reset(&hist);
+      write_cost = costs[i];
+      exp_num    = 0;
+
+      if (reg_set(&dev, "A", i) ||
+          reg_hist_export(&hist, REG_HIST_SET, test_export_fn, NULL) ||
+          (exp_num != 1) || (exp_count[0] != 1) || (exp_lo[0] > costs[i]) ||
+          (exp_hi[0] < costs[i]) || (hist.max[REG_HIST_SET] != costs[i])) {
+         TEST_FAIL("duration %" PRIu32 " in bucket [%" PRIu32 ", %" PRIu32 "]",
+                   costs[i], exp_lo[0], exp_hi[0]);
+         return -1;
+      }
+
+      // bucket width is at most a quarter of the duration
+      if ((costs[i] >= REG_HIST_SUB) &&
+          ((exp_hi[0] - exp_lo[0]) > exp_lo[0] / 4)) {
+         TEST_FAIL("bucket [%" PRIu32 ", %" PRIu32 "] too wide", exp_lo[0],
+                   exp_hi[0]);
+         return -1;
+      }
+
+      // a longer duration is in the same bucket, or in one further up
+      if ((i > 0) && (exp_lo[0] <= prev_hi) && (exp_hi[0] != prev_hi)) {
+         TEST_FAIL("buckets overlap");
+         return -1;
+      }
+      prev_hi = exp_hi[0];
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Rare slow calls show up in the high quantiles.
+ */
+static int test_hist_quantile(void)
+{
+   uint32_t data[TEST_HIST_REGS] = {0};
+   struct reg_dev dev            = test_dev(data);
+
+   for (uint32_t i = 0; i < 999; i++)
+      if (reg_set(&dev, "A", i)) {
+         TEST_FAIL("reg_set failed");
+         return -1;
+      }
+
+   // one call writes two registers
+   if (reg_set(&dev, "W", 0x10001U) || (hist.max[REG_HIST_SET] != 20)) {
+      TEST_FAIL("slow call not recorded");
+      return -1;
+   }
+
+   if ((reg_hist_quantile(&hist, REG_HIST_SET, 500000U) != 11) ||
+       (reg_hist_quantile(&hist, REG_HIST_SET, 990000U) != 11) ||
+       (reg_hist_quantile(&hist, REG_HIST_SET, 999000U) != 11) ||
+       (reg_hist_quantile(&hist, REG_HIST_SET, 1000000U) != 20) ||
+       (reg_hist_quantile(&hist, REG_HIST_GET, 990000U) != 0)) {
+      TEST_FAIL("wrong quantiles");
+      return -1;
+   }
+
+   // reading from the buffer takes no time
+   if ((reg_get(&dev, "A") != 998) || (hist.count[REG_HIST_GET][0] != 1)) {
+      TEST_FAIL("reg_get not timed");
+      return -1;
+   }
+
+   reg_hist_reset(&hist);
+   if ((hist.max[REG_HIST_SET] != 0) || (hist.count[REG_HIST_SET][9] != 0) ||
+       (hist.clock_fn != test_clock_fn)) {
+      TEST_FAIL("reg_hist_reset did not clear the histogram");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Map loads are timed, and included in the reg_adjust() time.
+ */
+static int test_hist_adjust(void)
+{
+   static const struct reg_field map1[] = {
+       {"A",  0, 0, 8, 0},
+       {NULL, 0, 0, 0, 0}
+   };
+
+   static const struct reg_field map2[] = {
+       {"A",  0, 0, 16, 0},
+       {NULL, 0, 0, 0,  0}
+   };
+
+   static const char *fields[]            = {"A", NULL};
+   static const struct reg_field *maps[] = {map1, map2, NULL};
+
+   uint64_t virt_data[1]         = {0};
+   uint32_t data[TEST_HIST_REGS] = {0};
+   struct reg_virt v = {
+       .fields  = fields,
+       .data    = virt_data,
+       .maps    = maps,
+       .load_fn = test_load_fn,
+       .base    = test_dev(data),
+   };
+   v.base.field_map = NULL;
+
+   // default map load and a write, then a map switch with a write
+   if (reg_adjust(&v, "A", 0x12) || reg_adjust(&v, "A", 0x123) ||
+       reg_adjust(&v, "A", 0x124)) {
+      TEST_FAIL("reg_adjust failed");
+      return -1;
+   }
+
+   if ((hist.max[REG_HIST_LOAD] != 1000) ||
+       (hist.max[REG_HIST_ADJUST] != 1010) ||
+       (reg_hist_quantile(&hist, REG_HIST_ADJUST, 500000U) != 1010) ||
+       (reg_hist_quantile(&hist, REG_HIST_ADJUST, 100000U) != 11)) {
+      TEST_FAIL("load max %" PRIu32 ", adjust max %" PRIu32,
+                hist.max[REG_HIST_LOAD], hist.max[REG_HIST_ADJUST]);
+      return -1;
+   }
+
+   return 0;
+}
+
+// device mutex state, and clock reads made while it is held
+static int locked;
+static uint32_t locked_reads;
+
+static int test_lock_fn(void *mutex)
+{
+   (void)mutex;
+   locked = 1;
+   return 0;
+}
+
+static int test_unlock_fn(void *mutex)
+{
+   (void)mutex;
+   locked = 0;
+   return 0;
+}
+
+static uint32_t test_locked_clock_fn(void)
+{
+   if (locked)
+      locked_reads++;
+   return now;
+}
+
+/**
+ * @brief A call is counted before the device mutex is released.
+ */
+static int test_hist_locked(void)
+{
+   uint32_t data[TEST_HIST_REGS] = {0};
+   int mutex                     = 0;
+   struct reg_dev dev            = test_dev(data);
+   dev.mutex                     = &mutex;
+   dev.lock_fn                   = test_lock_fn;
+   dev.unlock_fn                 = test_unlock_fn;
+   hist.clock_fn                 = test_locked_clock_fn;
+   locked_reads                  = 0;
+
+   if (reg_set(&dev, "A", 1) || (reg_get(&dev, "A") != 1)) {
+      TEST_FAIL("access failed");
+      return -1;
+   }
+
+   if ((locked_reads != 2) || (hist.max[REG_HIST_SET] != 10) ||
+       (hist.count[REG_HIST_GET][0] != 1)) {
+      TEST_FAIL("%" PRIu32 " of 2 calls counted under the mutex",
+                locked_reads);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Invalid arguments to the export functions.
+ */
+static int test_hist_invalid(void)
+{
+   uint32_t data[TEST_HIST_REGS] = {0};
+   struct reg_dev dev            = test_dev(data);
+
+   if (reg_set(&dev, "A", 1)) {
+      TEST_FAIL("reg_set failed");
+      return -1;
+   }
+
+   if ((reg_hist_export(&hist, REG_HIST_OPS, test_export_fn, NULL) == 0) ||
+       (reg_hist_export(NULL, REG_HIST_SET, test_export_fn, NULL) == 0) ||
+       (reg_hist_export(&hist, REG_HIST_SET, NULL, NULL) == 0) ||
+       (reg_hist_export(&hist, REG_HIST_SET, test_stop_fn, NULL) == 0)) {
+      TEST_FAIL("invalid export accepted");
+      return -1;
+   }
+
+   if ((reg_hist_quantile(&hist, REG_HIST_SET, 1000001U) != 0) ||
+       (reg_hist_quantile(NULL, REG_HIST_SET, 500000U) != 0)) {
+      TEST_FAIL("invalid quantile accepted");
+      return -1;
+   }
+
+   // without a clock nothing is recorded
+   hist.clock_fn = NULL;
+   reg_hist_reset(&hist);
+   if (reg_set(&dev, "A", 2) || (hist.count[REG_HIST_SET][0] != 0)) {
+      TEST_FAIL("call recorded without a clock");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_hist(void)
+{
+   static int (*valid_fn[])(void) = {test_hist_buckets, test_hist_quantile,
+                                     test_hist_adjust, test_hist_locked, NULL};
+
+   static int (*invalid_fn[])(void) = {test_hist_invalid, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_hist.c
@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_id.c
+ * @brief Tests for field access by ID, including the inline fast path.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_ID_REGS 4U
+
+static const struct reg_field test_fields[] = {
+    // name  reg off wd  flags
+    {"EN",    0,  0,  1,  0           },
+    {"MODE",  0,  1,  7,  0           },
+    {"_RES",  0,  8,  8,  0           },
+    {"WIDE",  1,  0,  32, 0           }, // registers 1 and 2
+    {"STAT",  3,  0,  16, REG_VOLATILE},
+    {NULL,    0,  0,  0,  0           }
+};
+
+static uint32_t phys[TEST_ID_REGS];
+static int write_calls;
+static int lock_calls;
+
+static uint32_t test_read_fn(int arg, size_t reg)
+{
+   (void)arg;
+   return phys[reg];
+}
+
+static int test_write_fn(int arg, size_t reg, uint32_t val)
+{
+   (void)arg;
+   phys[reg] = val;
+   write_calls++;
+   return 0;
+}
+
+static int test_fail_fn(int arg, size_t reg, uint32_t val)
+{
+   (void)arg;
+   (void)reg;
+   (void)val;
+   return -1;
+}
+
+static int test_lock_fn(void *mutex)
+{
+   (void)mutex;
+   lock_calls++;
+   return 0;
+}
+
+static struct reg_dev test_dev(uint32_t *data)
+{
+   memset(phys, 0, sizeof(phys));
+   write_calls = 0;
+   lock_calls  = 0;
+
+   return (struct reg_dev){
+       .reg_width = 16,
+       .reg_num   = TEST_ID_REGS,
+       .field_map = test_fields,
+       .read_fn   = test_read_fn,
+       .write_fn  = test_write_fn,
+       .data      = data,
+   };
+}
+
+/**
+ * @brief IDs are indices into the field map.
+ */
+static int test_id_lookup(void)
+{
+   uint32_t data[TEST_ID_REGS] = {0};
+   struct reg_dev dev          = test_dev(data);
+
+   if ((reg_id(&dev, "EN") != 0) || (reg_id(&dev, "WIDE") != 3) ||
+       (reg_id(&dev, "STAT") != 4)) {
+      TEST_FAIL("wrong field IDs");
+      return -1;
+   }
+
+   if (strcmp(reg_field_name(&dev, 0), "EN") ||
+       strcmp(reg_field_name(&dev, 4), "STAT")) {
+      TEST_FAIL("wrong field names");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Out-of-line access by ID.
+ */
+static int test_id_get_set(void)
+{
+   uint32_t data[TEST_ID_REGS] = {0};
+   struct reg_dev dev          = test_dev(data);
+
+   const int wide = reg_id(&dev, "WIDE");
+   const int mode = reg_id(&dev, "MODE");
+
+   if (reg_set_id(&dev, wide, 0x12345678U) || reg_set_id(&dev, mode, 0x55)) {
+      TEST_FAIL("reg_set_id failed");
+      return -1;
+   }
+
+   if ((data[1] != 0x5678U) || (data[2] != 0x1234U) || (data[0] != 0xaaU)) {
+      TEST_FAIL("wrong buffer contents");
+      return -1;
+   }
+
+   if ((reg_get_id(&dev, wide) != 0x12345678U) ||
+       (reg_get_id(&dev, mode) != 0x55)) {
+      TEST_FAIL("reg_get_id returned wrong value");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Inline access to single-register fields.
+ */
+static int test_id_fast(void)
+{
+   uint32_t data[TEST_ID_REGS] = {0};
+   struct reg_dev dev          = test_dev(data);
+
+   const int en   = reg_id(&dev, "EN");
+   const int mode = reg_id(&dev, "MODE");
+
+   if (reg_set_fast(&dev, mode, 0x7f) || reg_set_fast(&dev, en, 1)) {
+      TEST_FAIL("reg_set_fast failed");
+      return -1;
+   }
+
+   if ((data[0] != 0xffU) || (phys[0] != 0xffU) || (write_calls != 2)) {
+      TEST_FAIL("data[0] = 0x%" PRIx32 ", %d writes", data[0], write_calls);
+      return -1;
+   }
+
+   if (reg_set_fast(&dev, mode, 0x01) || (reg_get_fast(&dev, mode) != 0x01) ||
+       (reg_get_fast(&dev, en) != 1) || (data[0] != 0x03U)) {
+      TEST_FAIL("reg_get_fast returned wrong value");
+      return -1;
+   }
+
+   // REG_NOCOMM applies to the inline path as well
+   dev.flags = REG_NOCOMM;
+   if (reg_set_fast(&dev, en, 0) || (write_calls != 3) || (phys[0] != 0x03U)) {
+      TEST_FAIL("reg_set_fast wrote to the device with REG_NOCOMM");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Fields and devices not eligible for the inline path.
+ */
+static int test_id_fallback(void)
+{
+   uint32_t data[TEST_ID_REGS] = {0};
+   struct reg_dev dev          = test_dev(data);
+
+   // multi-register field
+   const int wide = reg_id(&dev, "WIDE");
+   if (reg_set_fast(&dev, wide, 0xdeadbeefU) ||
+       (reg_get_fast(&dev, wide) != 0xdeadbeefU) || (write_calls != 2)) {
+      TEST_FAIL("multi-register field failed");
+      return -1;
+   }
+
+   // volatile field is re-read
+   const int stat = reg_id(&dev, "STAT");
+   phys[3]        = 0x1234U;
+   if (reg_get_fast(&dev, stat) != 0x1234U) {
+      TEST_FAIL("volatile field not re-read");
+      return -1;
+   }
+
+   // statistics are kept by the out-of-line path
+   struct reg_stats stats = {0};
+   struct reg_ext ext     = {.stats = &stats};
+   dev.ext                = &ext;
+   const int en           = reg_id(&dev, "EN");
+   if (reg_set_fast(&dev, en, 1) || (reg_get_fast(&dev, en) != 1) ||
+       (stats.write_calls != 1) || (stats.locks != 2)) {
+      TEST_FAIL("device with statistics did not take the out-of-line path");
+      return -1;
+   }
+   dev.ext = NULL;
+
+   // locking is done by the out-of-line path
+   int mutex     = 0;
+   dev.mutex     = &mutex;
+   dev.lock_fn   = test_lock_fn;
+   dev.unlock_fn = test_lock_fn;
+   if (reg_set_fast(&dev, en, 1) || (lock_calls != 2)) {
+      TEST_FAIL("locked device did not take the out-of-line path");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Values too large for the field are rejected.
+ */
+static int test_id_too_large(void)
+{
+   uint32_t data[TEST_ID_REGS] = {0};
+   struct reg_dev dev          = test_dev(data);
+
+   const int mode = reg_id(&dev, "MODE");
+   if (reg_set_fast(&dev, mode, 0x80) == 0) {
+      TEST_FAIL("reg_set_fast accepted 8 bits in a 7-bit field");
+      return -1;
+   }
+
+   if ((data[0] != 0) || (write_calls != 0)) {
+      TEST_FAIL("rejected value was stored");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Invalid names and IDs.
+ */
+static int test_id_invalid(void)
+{
+   uint32_t data[TEST_ID_REGS] = {0};
+   struct reg_dev dev          = test_dev(data);
+
+   if ((reg_id(&dev, "NOPE") != -1) || (reg_id(&dev, NULL) != -1) ||
+       (reg_id(NULL, "EN") != -1)) {
+      TEST_FAIL("reg_id accepted invalid arguments");
+      return -1;
+   }
+
+   if (reg_field_name(&dev, 5) || reg_field_name(&dev, -1) ||
+       reg_field_name(NULL, 0)) {
+      TEST_FAIL("reg_field_name accepted invalid arguments");
+      return -1;
+   }
+
+   // field IDs are not bounds-checked at check level 0
+   TEST_NEED_CHECKS(1);
+
+   if ((reg_set_id(&dev, 5, 1) == 0) || (reg_set_id(&dev, -1, 1) == 0) ||
+       (reg_get_id(&dev, 5) != 0) || (reg_set_fast(&dev, -1, 1) == 0)) {
+      TEST_FAIL("access to invalid ID succeeded");
+      return -1;
+   }
+
+   // the bound is the field count, kept after the first access by ID
+   if ((dev.field_num != 5) || (reg_get_id(&dev, 4) != 0) ||
+       (reg_set_id(&dev, 6, 1) == 0)) {
+      TEST_FAIL("field count not cached");
+      return -1;
+   }
+
+   if (write_calls != 0) {
+      TEST_FAIL("invalid ID written to device");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Write errors are reported by the inline path.
+ */
+static int test_id_write_fail(void)
+{
+   uint32_t data[TEST_ID_REGS] = {0};
+   struct reg_dev dev          = test_dev(data);
+   dev.write_fn                = test_fail_fn;
+
+   if (reg_set_fast(&dev, reg_id(&dev, "EN"), 1) == 0) {
+      TEST_FAIL("reg_set_fast ignored write_fn failure");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_id(void)
+{
+   static int (*valid_fn[])(void) = {test_id_lookup, test_id_get_set,
+                                     test_id_fast, test_id_fallback, NULL};
+
+   static int (*invalid_fn[])(void) = {test_id_too_large, test_id_invalid,
+                                       test_id_write_fail, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_id.c
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_kernel.c
+ * @brief Exhaustive tests of field layout for all offsets and widths.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_KERNEL_REGS 12U
+#define TEST_KERNEL_BASE 5U
+
+static uint32_t *const phys = test_bus[0].regs;
+
+/**
+ * @brief Reference model: register and bit holding a given field bit.
+ */
+static void test_locate(const struct reg_field *f, const size_t w,
+                        const uint16_t flags, const size_t bit, size_t *reg,
+                        size_t *pos)
+{
+   const size_t abs = f->offs + bit;
+   *pos             = abs % w;
+   if (flags & REG_DESCEND)
+      *reg = f->reg - (abs / w);
+   else
+      *reg = f->reg + (abs / w);
+}
+
+/**
+ * @brief Set a pattern into one field and compare against the reference.
+ */
+static int test_one(const size_t w, const uint8_t offs, const uint8_t width,
+                    const uint16_t flags)
+{
+   const struct reg_field map[] = {
+       {"F",  TEST_KERNEL_BASE, offs, width, 0},
+       {NULL, 0,                0,    0,     0}
+   };
+
+   uint32_t data[TEST_KERNEL_REGS] = {0};
+   struct reg_dev dev              = test_bus_dev(0, map, (uint8_t)w,
+                                                  TEST_KERNEL_REGS, data);
+   dev.flags                       = flags;
+
+   // alternating pattern, truncated to the field width
+   uint64_t val = 0xA5C3F00F5AA5C33CULL;
+   if (width < 64)
+      val &= (1ULL << width) - 1;
+
+   if (reg_set(&dev, "F", val)) {
+      TEST_FAIL("reg_set failed: w=%zu offs=%u width=%u", w, offs, width);
+      return -1;
+   }
+
+   // compare every bit of the buffer against the reference
+   uint32_t ref[TEST_KERNEL_REGS] = {0};
+   for (size_t b = 0; b < width; b++) {
+      size_t reg = 0;
+      size_t pos = 0;
+      test_locate(&map[0], w, flags, b, &reg, &pos);
+      if ((val >> b) & 1U)
+         ref[reg] |= 1U << pos;
+   }
+
+   for (size_t r = 0; r < TEST_KERNEL_REGS; r++)
+      if ((data[r] != ref[r]) || (phys[r] != ref[r])) {
+         TEST_FAIL("w=%zu offs=%u width=%u flags=0x%x: reg %zu is 0x%" PRIx32
+                   ", expected 0x%" PRIx32,
+                   w, offs, width, flags, r, data[r], ref[r]);
+         return -1;
+      }
+
+   // least significant register first, unless REG_MSR_FIRST
+   const size_t num_regs = (offs + width + w - 1) / w;
+   if (test_bus[0].writes != num_regs) {
+      TEST_FAIL("w=%zu offs=%u width=%u: %zu writes", w, offs, width,
+                test_bus[0].writes);
+      return -1;
+   }
+
+   for (size_t i = 0; i < num_regs; i++) {
+      const size_t n   = (flags & REG_MSR_FIRST) ? num_regs - i - 1 : i;
+      const size_t exp = (flags & REG_DESCEND) ? TEST_KERNEL_BASE - n
+                                               : TEST_KERNEL_BASE + n;
+      if (test_bus[0].order[i] != exp) {
+         TEST_FAIL("w=%zu offs=%u width=%u: write %zu to reg %zu", w, offs,
+                   width, i, test_bus[0].order[i]);
+         return -1;
+      }
+   }
+
+   // read back, both from the buffer and from the device
+   if (reg_get(&dev, "F") != val) {
+      TEST_FAIL("w=%zu offs=%u width=%u: wrong readback", w, offs, width);
+      return -1;
+   }
+
+   dev.flags |= REG_VOLATILE;
+   memset(data, 0, sizeof(data));
+   if (reg_get(&dev, "F") != val) {
+      TEST_FAIL("w=%zu offs=%u width=%u: wrong volatile readback", w, offs,
+                width);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief All offsets and widths for a given register width.
+ */
+static int test_width(const size_t w)
+{
+   static const uint16_t flags[] = {0, REG_DESCEND, REG_MSR_FIRST,
+                                    REG_DESCEND | REG_MSR_FIRST};
+
+   for (size_t k = 0; k < sizeof(flags) / sizeof(flags[0]); k++)
+      for (uint8_t offs = 0; offs < w; offs++)
+         for (uint8_t width = 1; width <= 64; width++) {
+            // field must fit on either side of the base register
+            const size_t num_regs = (offs + width + w - 1) / w;
+            if (num_regs > TEST_KERNEL_BASE + 1)
+               continue;
+
+            if (test_one(w, offs, width, flags[k]))
+               return -1;
+         }
+
+   return 0;
+}
+
+static int test_kernel_8(void)
+{
+   return test_width(8);
+}
+
+static int test_kernel_16(void)
+{
+   return test_width(16);
+}
+
+static int test_kernel_32(void)
+{
+   return test_width(32);
+}
+
+static int test_kernel_generic(void)
+{
+   // odd widths use the generic chunk code
+   return test_width(12) || test_width(24) || test_width(31);
+}
+
+int test_reg_kernel(void)
+{
+   static int (*valid_fn[])(void) = {test_kernel_8, test_kernel_16,
+                                     test_kernel_32, test_kernel_generic,
+                                     NULL};
+
+   static int (*invalid_fn[])(void) = {NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_kernel.c
@@ -0,0 +1,297 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_map.c
+ * @brief Tests for the name index shared between devices.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_MAP_DEV    4U
+#define TEST_MAP_REGS   45U
+#define TEST_MAP_FIELDS 12U
+
+static const struct reg_field test_dev_map[] = {
+    // name         reg off wd  flags
+    {"POWERDOWN",    0,  0,  1,  0},
+    {"RESET",        0,  1,  1,  0},
+    {"R0_RES",       0,  2,  14, 0},
+    {"R34_RES",      34, 3,  13, 0},
+    {"PLL_N_MSB",    34, 0,  3,  0},
+    {"PLL_N_LSB",    36, 0,  16, 0},
+    {"_RES",         37, 0,  8,  0},
+    {"PFD_DLY_SEL",  37, 8,  6,  0},
+    {"_RES",         37, 14, 1,  0},
+    {"MASH_SEED_EN", 37, 15, 1,  0},
+    {"PLL_NUM",      43, 0,  32, 0},
+    {NULL,           0,  0,  0,  0}  // sentinel
+};
+
+static uint32_t phys[TEST_MAP_DEV][TEST_MAP_REGS];
+
+static uint32_t test_read_fn(int arg, size_t reg)
+{
+   return phys[arg][reg];
+}
+
+static int test_write_fn(int arg, size_t reg, uint32_t val)
+{
+   phys[arg][reg] = val;
+   return 0;
+}
+
+static struct reg_dev test_dev(const int arg, uint32_t *data,
+                               const struct reg_map *map)
+{
+   memset(phys[arg], 0, sizeof(phys[arg]));
+
+   return (struct reg_dev){
+       .reg_width = 16,
+       .reg_num   = TEST_MAP_REGS,
+       .field_map = map ? NULL : test_dev_map,
+       .map       = map,
+       .arg       = arg,
+       .read_fn   = test_read_fn,
+       .write_fn  = test_write_fn,
+       .data      = data,
+   };
+}
+
+/**
+ * @brief The index finds every field, the same as the linear search.
+ */
+static int test_map_index(void)
+{
+   size_t index[TEST_MAP_FIELDS];
+   struct reg_map map = {.field_map = test_dev_map};
+
+   if (reg_map_init(&map, index, TEST_MAP_FIELDS)) {
+      TEST_FAIL("reg_map_init failed");
+      return -1;
+   }
+
+   if ((map.index != index) || (map.field_num != TEST_MAP_FIELDS - 1)) {
+      TEST_FAIL("index not installed, %zu fields", map.field_num);
+      return -1;
+   }
+
+   uint32_t data[TEST_MAP_REGS] = {0};
+   struct reg_dev lin           = test_dev(0, data, NULL);
+   struct reg_dev idx           = test_dev(0, data, &map);
+
+   for (size_t i = 0; test_dev_map[i].name; i++) {
+      const char *name = test_dev_map[i].name;
+      if (reg_id(&idx, name) != reg_id(&lin, name)) {
+         TEST_FAIL("%s found at %d, expected %d", name, reg_id(&idx, name),
+                   reg_id(&lin, name));
+         return -1;
+      }
+   }
+
+   if (reg_id(&idx, "_RES") != 6) {
+      TEST_FAIL("duplicate name not resolved to the first field");
+      return -1;
+   }
+
+   for (size_t i = 1; i < map.field_num; i++) {
+      const int c = strcmp(test_dev_map[index[i - 1]].name,
+                           test_dev_map[index[i]].name);
+      if ((c > 0) || ((c == 0) && (index[i - 1] > index[i]))) {
+         TEST_FAIL("index out of order at %zu", i);
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Several devices share one index, each with its own buffer.
+ */
+static int test_map_shared(void)
+{
+   size_t index[TEST_MAP_FIELDS];
+   struct reg_map map = {.field_map = test_dev_map};
+
+   if (reg_map_init(&map, index, TEST_MAP_FIELDS)) {
+      TEST_FAIL("reg_map_init failed");
+      return -1;
+   }
+
+   uint32_t data[TEST_MAP_DEV][TEST_MAP_REGS] = {{0}};
+   struct reg_dev dev[TEST_MAP_DEV];
+   for (int i = 0; i < (int)TEST_MAP_DEV; i++) {
+      dev[i] = test_dev(i, data[i], &map);
+      if (reg_check(&dev[i])) {
+         TEST_FAIL("reg_check failed on device %d", i);
+         return -1;
+      }
+   }
+
+   for (int i = 0; i < (int)TEST_MAP_DEV; i++)
+      if (reg_set(&dev[i], "PLL_NUM", 0x10000U * (uint32_t)i + 1U) ||
+          reg_set(&dev[i], "PFD_DLY_SEL", (uint64_t)i)) {
+         TEST_FAIL("reg_set failed on device %d", i);
+         return -1;
+      }
+
+   for (int i = 0; i < (int)TEST_MAP_DEV; i++) {
+      if ((reg_get(&dev[i], "PLL_NUM") != 0x10000U * (uint32_t)i + 1U) ||
+          (reg_get(&dev[i], "PFD_DLY_SEL") != (uint64_t)i) ||
+          (phys[i][44] != (uint32_t)i) || (data[i][37] != (uint32_t)i << 8U)) {
+         TEST_FAIL("wrong values on device %d", i);
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Packed maps can be indexed as well.
+ */
+static int test_map_packed(void)
+{
+   struct reg_packed packed[TEST_MAP_FIELDS];
+   char names[128];
+   if (reg_pack(test_dev_map, packed, TEST_MAP_FIELDS, names, sizeof(names))) {
+      TEST_FAIL("reg_pack failed");
+      return -1;
+   }
+
+   size_t index[TEST_MAP_FIELDS];
+   struct reg_map map = {.packed = packed, .names = names};
+   if (reg_map_init(&map, index, TEST_MAP_FIELDS)) {
+      TEST_FAIL("reg_map_init failed");
+      return -1;
+   }
+
+   uint32_t data[TEST_MAP_REGS] = {0};
+   struct reg_dev dev           = test_dev(0, data, &map);
+
+   if (reg_check(&dev) || reg_set(&dev, "PLL_N_LSB", 0x1234U) ||
+       (reg_get(&dev, "PLL_N_LSB") != 0x1234U) ||
+       (reg_id(&dev, "PLL_NUM") != 10)) {
+      TEST_FAIL("access through packed index failed");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Devices with a shared map must not give a field map of their own.
+ */
+static int test_map_mismatch(void)
+{
+   TEST_NEED_CHECKS(1);
+
+   static const struct reg_field other_map[] = {
+       {"POWERDOWN", 0, 0, 16, 0},
+       {NULL,        0, 0, 0,  0}
+   };
+
+   size_t index[TEST_MAP_FIELDS];
+   struct reg_map map = {.field_map = test_dev_map};
+   if (reg_map_init(&map, index, TEST_MAP_FIELDS)) {
+      TEST_FAIL("reg_map_init failed");
+      return -1;
+   }
+
+   uint32_t data[TEST_MAP_REGS] = {0};
+   struct reg_dev dev           = test_dev(0, data, &map);
+   dev.field_map                = other_map;
+
+   if (reg_set(&dev, "POWERDOWN", 1) == 0) {
+      TEST_FAIL("reg_set accepted a device with two field maps");
+      return -1;
+   }
+
+   struct reg_map unbuilt = {.field_map = test_dev_map};
+   dev                    = test_dev(0, data, &unbuilt);
+   if (reg_set(&dev, "POWERDOWN", 1) == 0) {
+      TEST_FAIL("reg_set accepted an index that was not built");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Lookups of unknown fields and IDs fail.
+ */
+static int test_map_unknown(void)
+{
+   size_t index[TEST_MAP_FIELDS];
+   struct reg_map map = {.field_map = test_dev_map};
+   if (reg_map_init(&map, index, TEST_MAP_FIELDS)) {
+      TEST_FAIL("reg_map_init failed");
+      return -1;
+   }
+
+   uint32_t data[TEST_MAP_REGS] = {0};
+   struct reg_dev dev           = test_dev(0, data, &map);
+
+   if ((reg_id(&dev, "AAA") != -1) || (reg_id(&dev, "ZZZ") != -1) ||
+       (reg_id(&dev, "PLL_N") != -1) || (reg_set(&dev, "RESETX", 1) == 0)) {
+      TEST_FAIL("unknown field found");
+      return -1;
+   }
+
+   // field IDs are not bounds-checked at check level 0
+   TEST_NEED_CHECKS(1);
+
+   if ((reg_set_id(&dev, TEST_MAP_FIELDS - 1, 1) == 0) ||
+       (reg_get_id(&dev, 100) != 0)) {
+      TEST_FAIL("field ID outside map accepted");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief reg_map_init must not overrun a small index.
+ */
+static int test_map_small(void)
+{
+   size_t index[TEST_MAP_FIELDS] = {0};
+   struct reg_map map            = {.field_map = test_dev_map};
+
+   if (reg_map_init(&map, index, TEST_MAP_FIELDS - 2) == 0) {
+      TEST_FAIL("reg_map_init accepted a small index");
+      return -1;
+   }
+
+   if ((map.index != NULL) || (index[TEST_MAP_FIELDS - 2] != 0)) {
+      TEST_FAIL("reg_map_init modified the map or overran the index");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_map(void)
+{
+   static int (*valid_fn[])(void) = {test_map_index, test_map_shared,
+                                     test_map_packed, NULL};
+
+   static int (*invalid_fn[])(void) = {test_map_mismatch, test_map_unknown,
+                                       test_map_small, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_map.c
@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_mmio.c
+ * @brief Tests for memory-mapped register access.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_MMIO_REGS   4U
+#define TEST_MMIO_STRIDE 2U
+
+static const struct reg_field test_fields[] = {
+    // name   reg off wd  flags
+    {"EN",     0,  0,  1,  0           },
+    {"MODE",   0,  1,  7,  0           },
+    {"_RES",   0,  8,  24, 0           },
+    {"FTW",    1,  0,  48, 0           },
+    {"_RES",   2,  16, 16, 0           },
+    {"STATUS", 3,  0,  32, REG_VOLATILE},
+    {NULL,     0,  0,  0,  0           }
+};
+
+// register window: registers are spaced two words apart
+static uint32_t window[TEST_MMIO_REGS * TEST_MMIO_STRIDE];
+
+static struct reg_dev test_dev(uint32_t *data, const uint16_t flags)
+{
+   memset(window, 0, sizeof(window));
+
+   return (struct reg_dev){
+       .flags       = flags,
+       .reg_width   = 32,
+       .reg_num     = TEST_MMIO_REGS,
+       .field_map   = test_fields,
+       .mmio        = window,
+       .mmio_stride = TEST_MMIO_STRIDE,
+       .data        = data,
+   };
+}
+
+/**
+ * @brief Buffered memory-mapped device without read/write callbacks.
+ */
+static int test_mmio_buffered(void)
+{
+   uint32_t data[TEST_MMIO_REGS] = {0};
+   struct reg_dev dev            = test_dev(data, 0);
+
+   if (reg_check(&dev)) {
+      TEST_FAIL("reg_check failed");
+      return -1;
+   }
+
+   if (reg_set(&dev, "MODE", 0x55) || reg_set(&dev, "EN", 1)) {
+      TEST_FAIL("reg_set failed");
+      return -1;
+   }
+
+   if ((window[0] != 0xab) || (data[0] != 0xab)) {
+      TEST_FAIL("window[0] = 0x%" PRIx32 ", data[0] = 0x%" PRIx32, window[0],
+                data[0]);
+      return -1;
+   }
+
+   if (reg_set(&dev, "FTW", 0x123456789abcULL)) {
+      TEST_FAIL("reg_set(FTW) failed");
+      return -1;
+   }
+
+   if ((window[2] != 0x56789abcU) || (window[4] != 0x1234U) ||
+       (window[1] != 0) || (window[3] != 0)) {
+      TEST_FAIL("FTW not written with the correct stride");
+      return -1;
+   }
+
+   // non-volatile fields come from the buffer
+   window[0] = 0;
+   if (reg_get(&dev, "MODE") != 0x55) {
+      TEST_FAIL("buffered MODE should not change");
+      return -1;
+   }
+
+   // volatile fields come from the window
+   window[6] = 0xcafef00dU;
+   if ((reg_get(&dev, "STATUS") != 0xcafef00dU) || (data[3] != 0xcafef00dU)) {
+      TEST_FAIL("volatile STATUS not read from the window");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief REG_DIRECT device with no data buffer at all.
+ */
+static int test_mmio_direct(void)
+{
+   struct reg_dev dev = test_dev(NULL, REG_DIRECT);
+
+   if (reg_set(&dev, "MODE", 0x7f)) {
+      TEST_FAIL("reg_set(MODE) failed");
+      return -1;
+   }
+
+   // read-modify-write must keep the other bits of the register
+   window[0] |= 0xff00U;
+   if (reg_set(&dev, "EN", 1)) {
+      TEST_FAIL("reg_set(EN) failed");
+      return -1;
+   }
+
+   if (window[0] != 0xffffU) {
+      TEST_FAIL("window[0] = 0x%" PRIx32 ", should be 0xffff", window[0]);
+      return -1;
+   }
+
+   // without a buffer, all fields reflect the window
+   window[2] = 0x89abcdefU;
+   window[4] = 0x4567U;
+   if (reg_get(&dev, "FTW") != 0x456789abcdefULL) {
+      TEST_FAIL("FTW not read from the window");
+      return -1;
+   }
+
+   if ((reg_write(&dev, 3, 0x12345678U)) || (window[6] != 0x12345678U)) {
+      TEST_FAIL("reg_write did not reach the window");
+      return -1;
+   }
+
+   window[6] = 0x87654321U;
+   if (reg_read(&dev, 3) != 0x87654321U) {
+      TEST_FAIL("reg_read did not read the window");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief REG_DIRECT device with a scratch buffer for reg_check().
+ */
+static int test_mmio_direct_check(void)
+{
+   uint32_t scratch[TEST_MMIO_REGS] = {0};
+   struct reg_dev dev               = test_dev(scratch, REG_DIRECT);
+
+   window[0] = 0x1234U;
+   if (reg_check(&dev)) {
+      TEST_FAIL("reg_check failed");
+      return -1;
+   }
+
+   if (window[0] != 0x1234U) {
+      TEST_FAIL("reg_check touched the register window");
+      return -1;
+   }
+
+   if (reg_get(&dev, "_RES") != 0x12) {
+      TEST_FAIL("field not read from the window");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief reg_check() needs a data buffer, even for REG_DIRECT devices.
+ */
+static int test_mmio_direct_check_nobuf(void)
+{
+   struct reg_dev dev = test_dev(NULL, REG_DIRECT);
+
+   if (reg_check(&dev) == 0) {
+      TEST_FAIL("reg_check should fail without a buffer");
+      return -1;
+   }
+
+   if (reg_bulk(&dev, NULL) == 0) {
+      TEST_FAIL("reg_bulk should fail without a buffer");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief REG_NOCOMM fields cannot be kept on a device bypassing the buffer.
+ */
+static int test_mmio_direct_nocomm(void)
+{
+   static const struct reg_field fields[] = {
+       {"EN",   0, 0, 1,  0         },
+       {"SOFT", 0, 1, 7,  REG_NOCOMM},
+       {"_RES", 0, 8, 24, 0         },
+       {"_RES", 1, 0, 32, 0         },
+       {"_RES", 2, 0, 32, 0         },
+       {"_RES", 3, 0, 32, 0         },
+       {NULL,   0, 0, 0,  0         }
+   };
+
+   uint32_t scratch[TEST_MMIO_REGS] = {0};
+   struct reg_dev dev               = test_dev(scratch, REG_DIRECT);
+   dev.field_map                    = fields;
+
+   if (reg_check(&dev) == 0) {
+      TEST_FAIL("reg_check should reject REG_NOCOMM with REG_DIRECT");
+      return -1;
+   }
+
+   // with the buffer in use, the field is kept there
+   dev.flags |= REG_NOCOMM;
+   if (reg_check(&dev)) {
+      TEST_FAIL("reg_check failed on a buffered device");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Without REG_DIRECT, a buffer is required.
+ */
+static int test_mmio_nobuf(void)
+{
+   TEST_NEED_CHECKS(1);
+
+   struct reg_dev dev = test_dev(NULL, 0);
+
+   if (reg_set(&dev, "EN", 1) == 0) {
+      TEST_FAIL("reg_set should fail without a buffer");
+      return -1;
+   }
+
+   if (window[0] != 0) {
+      TEST_FAIL("failed reg_set modified the window");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Without mmio, read/write callbacks are required.
+ */
+static int test_mmio_missing(void)
+{
+   TEST_NEED_CHECKS(1);
+
+   uint32_t data[TEST_MMIO_REGS] = {0};
+   struct reg_dev dev            = test_dev(data, REG_DIRECT);
+   dev.mmio                      = NULL;
+
+   if (reg_set(&dev, "EN", 1) == 0) {
+      TEST_FAIL("reg_set should fail without mmio or write_fn");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_mmio(void)
+{
+   static int (*valid_fn[])(void) = {test_mmio_buffered, test_mmio_direct,
+                                     test_mmio_direct_check, NULL};
+
+   static int (*invalid_fn[])(void) = {
+       test_mmio_direct_check_nobuf, test_mmio_direct_nocomm, test_mmio_nobuf,
+       test_mmio_missing, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_mmio.c
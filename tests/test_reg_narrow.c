@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_narrow.c
+ * @brief Tests for 8- and 16-bit data buffers.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TEST_NARROW_REGS 8U
+
+static const struct reg_field test_fields[] = {
+    // name  reg off wd  flags
+    {"EN",    0,  0,  1,  0           },
+    {"MODE",  0,  1,  7,  0           },
+    {"FTW",   1,  0,  24, 0           }, // registers 1--3 at 8 bits
+    {"DN",    6,  4,  12, REG_DESCEND },
+    {"_DN",   6,  0,  4,  0           },
+    {"STAT",  7,  0,  8,  REG_VOLATILE},
+    {NULL,    0,  0,  0,  0           }
+};
+
+static uint32_t *const phys = test_bus[0].regs;
+
+static struct reg_dev test_dev(const uint8_t width)
+{
+   return test_bus_dev(0, test_fields, width, TEST_NARROW_REGS, NULL);
+}
+
+/**
+ * @brief 8-bit device with an 8-bit buffer.
+ */
+static int test_narrow_8(void)
+{
+   uint8_t data[TEST_NARROW_REGS] = {0};
+   struct reg_dev dev             = test_dev(8);
+   dev.data8                      = data;
+
+   if (reg_check(&dev)) {
+      TEST_FAIL("reg_check failed");
+      return -1;
+   }
+
+   if (reg_set(&dev, "MODE", 0x7f) || reg_set(&dev, "FTW", 0xabcdef) ||
+       reg_set(&dev, "DN", 0xfed)) {
+      TEST_FAIL("reg_set failed");
+      return -1;
+   }
+
+   if ((data[0] != 0xfe) || (data[1] != 0xef) || (data[2] != 0xcd) ||
+       (data[3] != 0xab) || (data[6] != 0xd0) || (data[5] != 0xfe)) {
+      TEST_FAIL("wrong buffer contents");
+      return -1;
+   }
+
+   if ((phys[3] != 0xab) || (phys[6] != 0xd0)) {
+      TEST_FAIL("wrong physical register contents");
+      return -1;
+   }
+
+   if ((reg_get(&dev, "FTW") != 0xabcdef) || (reg_get(&dev, "DN") != 0xfed) ||
+       (reg_get(&dev, "MODE") != 0x7f)) {
+      TEST_FAIL("reg_get returned wrong value");
+      return -1;
+   }
+
+   phys[7] = 0x5a;
+   if ((reg_get(&dev, "STAT") != 0x5a) || (data[7] != 0x5a)) {
+      TEST_FAIL("volatile read not stored in buffer");
+      return -1;
+   }
+
+   const uint32_t bulk[TEST_NARROW_REGS] = {0, 1, 2, 3, 4, 5, 6, 0xff};
+   if (reg_bulk(&dev, bulk) || (reg_get(&dev, "FTW") != 0x030201)) {
+      TEST_FAIL("reg_bulk failed");
+      return -1;
+   }
+
+   if (reg_bulk(&dev, NULL) || (reg_read(&dev, 7) != 0x5a) ||
+       (reg_get(&dev, "FTW") != 0)) {
+      TEST_FAIL("reg_bulk did not clear the buffer");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief 16-bit device with a 16-bit buffer.
+ */
+static int test_narrow_16(void)
+{
+   static const struct reg_field fields[] = {
+       // name reg off wd  flags
+       {"LO",   0,  0,  16, 0},
+       {"WIDE", 1,  4,  40, 0}, // registers 1--3
+       {"_R1",  1,  0,  4,  0},
+       {"_R3",  3,  12, 4,  0},
+       {NULL,   0,  0,  0,  0}
+   };
+
+   uint16_t data[TEST_NARROW_REGS] = {0};
+   struct reg_dev dev              = test_dev(16);
+   dev.field_map                   = fields;
+   dev.data16                      = data;
+
+   if (reg_check(&dev)) {
+      TEST_FAIL("reg_check failed");
+      return -1;
+   }
+
+   if (reg_set(&dev, "WIDE", 0x123456789aULL) || reg_set(&dev, "LO", 0xffff)) {
+      TEST_FAIL("reg_set failed");
+      return -1;
+   }
+
+   if ((data[0] != 0xffff) || (data[1] != 0x89a0) || (data[2] != 0x4567) ||
+       (data[3] != 0x123)) {
+      TEST_FAIL("wrong buffer contents");
+      return -1;
+   }
+
+   if (reg_get(&dev, "WIDE") != 0x123456789aULL) {
+      TEST_FAIL("reg_get(WIDE) returned wrong value");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Buffer elements must be wide enough for the registers.
+ */
+static int test_narrow_too_wide(void)
+{
+   TEST_NEED_CHECKS(1);
+
+   uint8_t data[TEST_NARROW_REGS] = {0};
+   struct reg_dev dev             = test_dev(16);
+   dev.data8                      = data;
+
+   if (reg_check(&dev) == 0) {
+      TEST_FAIL("reg_check accepted 16-bit registers in 8-bit buffer");
+      return -1;
+   }
+
+   if (reg_write(&dev, 0, 0x1ff) == 0) {
+      TEST_FAIL("reg_write accepted 16-bit registers in 8-bit buffer");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Only one data buffer may be given.
+ */
+static int test_narrow_two_buffers(void)
+{
+   TEST_NEED_CHECKS(1);
+
+   uint8_t data8[TEST_NARROW_REGS]   = {0};
+   uint16_t data16[TEST_NARROW_REGS] = {0};
+   struct reg_dev dev                = test_dev(8);
+   dev.data8                         = data8;
+   dev.data16                        = data16;
+
+   if (reg_set(&dev, "EN", 1) == 0) {
+      TEST_FAIL("reg_set accepted two data buffers");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief reg_bulk must reject words that do not fit, without side effects.
+ */
+static int test_narrow_bulk_overflow(void)
+{
+   uint8_t data[TEST_NARROW_REGS] = {1, 2, 3, 4, 5, 6, 7, 8};
+   struct reg_dev dev             = test_dev(8);
+   dev.data8                      = data;
+
+   const uint32_t bulk[TEST_NARROW_REGS] = {0, 0, 0, 0, 0, 0, 0, 0x100};
+   if (reg_bulk(&dev, bulk) == 0) {
+      TEST_FAIL("reg_bulk accepted a 9-bit word");
+      return -1;
+   }
+
+   if ((data[0] != 1) || (data[7] != 8)) {
+      TEST_FAIL("failed reg_bulk modified the buffer");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_narrow(void)
+{
+   static int (*valid_fn[])(void) = {test_narrow_8, test_narrow_16, NULL};
+
+   static int (*invalid_fn[])(void) = {test_narrow_too_wide,
+                                       test_narrow_two_buffers,
+                                       test_narrow_bulk_overflow, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_narrow.c
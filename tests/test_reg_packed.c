@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_packed.c
+ * @brief Tests for packed field maps.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_PACKED_REGS   7U
+#define TEST_PACKED_FIELDS 8U
+
+static const struct reg_field test_fields[] = {
+    // name  reg off wd  flags
+    {"EN",    0,  0,  1,  0           },
+    {"MODE",  0,  1,  7,  0           },
+    {"_RES",  0,  8,  8,  0           },
+    {"FTW",   1,  0,  32, 0           }, // registers 1 and 2
+    {"DN",    5,  8,  24, REG_DESCEND }, // registers 4 and 5
+    {"_DN",   5,  0,  8,  0           },
+    {"STAT",  6,  0,  16, REG_VOLATILE},
+    {NULL,    0,  0,  0,  0           }
+};
+
+// the same map, packed by hand
+static const char test_names[] = "EN\0MODE\0_RES\0FTW\0DN\0_DN\0STAT";
+
+static const struct reg_packed test_packed[] = {
+    // name reg off wd  flags
+    {0,      0,  0,  1,  0           },
+    {3,      0,  1,  7,  0           },
+    {8,      0,  8,  8,  0           },
+    {13,     1,  0,  32, 0           },
+    {17,     5,  8,  24, REG_DESCEND },
+    {20,     5,  0,  8,  0           },
+    {24,     6,  0,  16, REG_VOLATILE},
+    {0,      0,  0,  0,  0           }
+};
+
+static uint32_t *const phys = test_bus[0].regs;
+
+static struct reg_dev test_dev(uint32_t *data)
+{
+   struct reg_dev d = test_bus_dev(0, NULL, 16, TEST_PACKED_REGS, data);
+   d.packed         = test_packed;
+   d.names          = test_names;
+   return d;
+}
+
+/**
+ * @brief Set the same fields in either kind of device.
+ */
+static int test_fill(struct reg_dev *d)
+{
+   if (reg_set(d, "EN", 1) || reg_set(d, "MODE", 0x55) ||
+       reg_set(d, "FTW", 0x12345678U) || reg_set(d, "DN", 0xabcdef)) {
+      TEST_FAIL("reg_set failed");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Hand-written packed map behaves like the unpacked one.
+ */
+static int test_packed_manual(void)
+{
+   if (sizeof(struct reg_packed) != 8) {
+      TEST_FAIL("struct reg_packed is %zu bytes", sizeof(struct reg_packed));
+      return -1;
+   }
+
+   uint32_t data[TEST_PACKED_REGS] = {0};
+   struct reg_dev dev              = test_dev(data);
+
+   if (reg_check(&dev)) {
+      TEST_FAIL("reg_check failed");
+      return -1;
+   }
+
+   if (test_fill(&dev))
+      return -1;
+
+   uint32_t ref[TEST_PACKED_REGS] = {0};
+   struct reg_dev ref_dev         = test_dev(ref);
+   ref_dev.packed                 = NULL;
+   ref_dev.names                  = NULL;
+   ref_dev.field_map              = test_fields;
+
+   if (test_fill(&ref_dev))
+      return -1;
+
+   for (size_t i = 0; i < TEST_PACKED_REGS; i++)
+      if (data[i] != ref[i]) {
+         TEST_FAIL("reg %zu is 0x%" PRIx32 ", expected 0x%" PRIx32, i,
+                   data[i], ref[i]);
+         return -1;
+      }
+
+   if ((reg_get(&dev, "FTW") != 0x12345678U) ||
+       (reg_get(&dev, "DN") != 0xabcdef) || (reg_fwidth(&dev, "DN") != 24)) {
+      TEST_FAIL("reg_get returned wrong value");
+      return -1;
+   }
+
+   phys[6] = 0xbeefU;
+   if (reg_get(&dev, "STAT") != 0xbeefU) {
+      TEST_FAIL("volatile field not re-read");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief reg_pack output matches the hand-written map.
+ */
+static int test_packed_convert(void)
+{
+   struct reg_packed packed[TEST_PACKED_FIELDS];
+   char names[sizeof(test_names)];
+
+   if (reg_pack(test_fields, packed, TEST_PACKED_FIELDS, names,
+                sizeof(names))) {
+      TEST_FAIL("reg_pack failed");
+      return -1;
+   }
+
+   if (memcmp(names, test_names, sizeof(names)) != 0) {
+      TEST_FAIL("wrong string table");
+      return -1;
+   }
+
+   for (size_t i = 0; i < TEST_PACKED_FIELDS; i++) {
+      const struct reg_packed *p = &packed[i];
+      const struct reg_packed *q = &test_packed[i];
+      if ((p->name != q->name) || (p->reg != q->reg) || (p->offs != q->offs) ||
+          (p->width != q->width) || (p->flags != q->flags)) {
+         TEST_FAIL("wrong packed field %zu", i);
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Field IDs and sparse slot tables work on packed maps.
+ */
+static int test_packed_id_slots(void)
+{
+   uint32_t data[TEST_PACKED_REGS] = {0};
+   struct reg_dev dev              = test_dev(data);
+
+   const int ftw = reg_id(&dev, "FTW");
+   const int en  = reg_id(&dev, "EN");
+   if ((ftw != 3) || (en != 0)) {
+      TEST_FAIL("wrong field IDs");
+      return -1;
+   }
+
+   // the inline functions take the out-of-line path for packed maps
+   if (reg_set_id(&dev, ftw, 0xcafef00dU) || reg_set_fast(&dev, en, 1) ||
+       (reg_get_fast(&dev, ftw) != 0xcafef00dU) || (data[0] != 1U) ||
+       (phys[2] != 0xcafeU)) {
+      TEST_FAIL("access by ID failed");
+      return -1;
+   }
+
+   uint32_t sparse[TEST_PACKED_REGS - 1] = {0};
+   size_t slots[TEST_PACKED_REGS]        = {0};
+   struct reg_ext ext                    = {0};
+   dev.data                              = sparse;
+   dev.ext                               = &ext;
+   if (reg_slots(&dev, slots, TEST_PACKED_REGS) ||
+       (ext.slot_num != TEST_PACKED_REGS - 1) || (slots[3] != 4) ||
+       reg_check(&dev)) {
+      TEST_FAIL("slot table not built from packed map");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Only one form of the field map may be given.
+ */
+static int test_packed_two_maps(void)
+{
+   TEST_NEED_CHECKS(1);
+
+   uint32_t data[TEST_PACKED_REGS] = {0};
+   struct reg_dev dev              = test_dev(data);
+   dev.field_map                   = test_fields;
+
+   if (reg_set(&dev, "EN", 1) == 0) {
+      TEST_FAIL("reg_set accepted two field maps");
+      return -1;
+   }
+
+   dev.field_map = NULL;
+   dev.names     = NULL;
+   if (reg_check(&dev) == 0) {
+      TEST_FAIL("reg_check accepted packed map without names");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief reg_check must catch errors in packed maps.
+ */
+static int test_packed_overlap(void)
+{
+   static const struct reg_packed packed[] = {
+       // name reg off wd  flags
+       {0,      0,  0,  16, 0},
+       {2,      0,  8,  8,  0},
+       {0,      0,  0,  0,  0}
+   };
+
+   uint32_t data[TEST_PACKED_REGS] = {0};
+   struct reg_dev dev              = test_dev(data);
+   dev.packed                      = packed;
+   dev.names                       = "A\0B";
+
+   if (reg_check(&dev) == 0) {
+      TEST_FAIL("reg_check accepted overlapping fields");
+      return -1;
+   }
+
+   if (reg_set(&dev, "C", 1) == 0) {
+      TEST_FAIL("reg_set accepted unknown field");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief reg_pack must not overrun its buffers.
+ */
+static int test_packed_small(void)
+{
+   struct reg_packed packed[TEST_PACKED_FIELDS];
+   char names[sizeof(test_names)];
+
+   if (reg_pack(test_fields, packed, TEST_PACKED_FIELDS - 1, names,
+                sizeof(names)) == 0) {
+      TEST_FAIL("reg_pack accepted a small map");
+      return -1;
+   }
+
+   if (reg_pack(test_fields, packed, TEST_PACKED_FIELDS, names,
+                sizeof(names) - 1) == 0) {
+      TEST_FAIL("reg_pack accepted a small string table");
+      return -1;
+   }
+
+   static const struct reg_field far[] = {
+       {"FAR", 70000, 0, 16, 0},
+       {NULL,  0,     0, 0,  0}
+   };
+
+   if (reg_pack(far, packed, TEST_PACKED_FIELDS, names, sizeof(names)) == 0) {
+      TEST_FAIL("reg_pack accepted a register number above 65535");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_packed(void)
+{
+   static int (*valid_fn[])(void) = {test_packed_manual, test_packed_convert,
+                                     test_packed_id_slots, NULL};
+
+   static int (*invalid_fn[])(void) = {test_packed_two_maps,
+                                       test_packed_overlap, test_packed_small,
+                                       NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_packed.c
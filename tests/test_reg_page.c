@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_page.c
+ * @brief Tests for paged register access.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TEST_PAGE_LEN  4U
+#define TEST_PAGE_NUM  3U
+#define TEST_PAGE_REGS (TEST_PAGE_LEN * TEST_PAGE_NUM)
+
+static const struct reg_field test_fields[] = {
+    // name   reg off wd  flags
+    {"A",      0,  0,  8,  0           },
+    {"B",      1,  0,  8,  0           },
+    {"C",      5,  0,  8,  0           },
+    {"D",      6,  0,  8,  REG_VOLATILE},
+    {"ACROSS", 7,  0,  16, 0           }, // registers 7 and 8: pages 1 and 2
+    {"E",      11, 0,  8,  0           },
+    {NULL,     0,  0,  0,  0           }
+};
+
+// simulated device: the register file is addressed by page and address
+static uint32_t (*const phys)[TEST_PAGE_LEN] =
+    (uint32_t (*)[TEST_PAGE_LEN])test_bus[0].regs;
+static struct test_bus *const bus = &test_bus[0];
+
+static struct reg_ext ext;
+
+static struct reg_dev test_dev(uint32_t *data)
+{
+   struct reg_dev d = test_bus_dev(0, test_fields, 8, TEST_PAGE_REGS, data);
+   bus->page_len    = TEST_PAGE_LEN;
+   ext              = (struct reg_ext){
+                    .page_len = TEST_PAGE_LEN,
+                    .page_fn  = test_bus_page,
+   };
+   d.ext = &ext;
+   return d;
+}
+
+/**
+ * @brief Page is selected once, then only on page changes.
+ */
+static int test_page_select(void)
+{
+   uint32_t data[TEST_PAGE_REGS] = {0};
+   struct reg_dev dev            = test_dev(data);
+
+   if (reg_check(&dev)) {
+      TEST_FAIL("reg_check failed");
+      return -1;
+   }
+
+   if (bus->pages != 0) {
+      TEST_FAIL("reg_check selected a page");
+      return -1;
+   }
+
+   // first access selects page 0, the second one stays on it
+   if (reg_set(&dev, "A", 0x11) || reg_set(&dev, "B", 0x22)) {
+      TEST_FAIL("reg_set failed");
+      return -1;
+   }
+
+   if ((bus->pages != 1) || (phys[0][0] != 0x11) || (phys[0][1] != 0x22)) {
+      TEST_FAIL("page 0: %zu page selects", bus->pages);
+      return -1;
+   }
+
+   // register 5 is on page 1, at address 1
+   if (reg_set(&dev, "C", 0x33) || reg_set(&dev, "C", 0x34)) {
+      TEST_FAIL("reg_set(C) failed");
+      return -1;
+   }
+
+   if ((bus->pages != 2) || (phys[1][1] != 0x34) || (phys[0][1] != 0x22)) {
+      TEST_FAIL("page 1: %zu page selects", bus->pages);
+      return -1;
+   }
+
+   if ((ext.page != 1) || !ext.page_ok) {
+      TEST_FAIL("page cache not updated");
+      return -1;
+   }
+
+   // buffer is indexed by sequential register number
+   if ((data[0] != 0x11) || (data[1] != 0x22) || (data[5] != 0x34)) {
+      TEST_FAIL("wrong buffer contents");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Multi-register field crossing a page boundary.
+ */
+static int test_page_across(void)
+{
+   uint32_t data[TEST_PAGE_REGS] = {0};
+   struct reg_dev dev            = test_dev(data);
+
+   if (reg_set(&dev, "ACROSS", 0xbeef)) {
+      TEST_FAIL("reg_set(ACROSS) failed");
+      return -1;
+   }
+
+   if ((phys[1][3] != 0xef) || (phys[2][0] != 0xbe) || (bus->pages != 2)) {
+      TEST_FAIL("ACROSS not written to both pages");
+      return -1;
+   }
+
+   // volatile read of register 6 goes back to page 1
+   phys[1][2] = 0x5a;
+   if ((reg_get(&dev, "D") != 0x5a) || (bus->pages != 3)) {
+      TEST_FAIL("volatile read on page 1 failed");
+      return -1;
+   }
+
+   // E is on page 2: one select, then none for the raw accesses
+   if (reg_set(&dev, "E", 0x77) || (reg_read(&dev, 11) != 0x77) ||
+       reg_write(&dev, 10, 0x01) || (bus->pages != 4)) {
+      TEST_FAIL("page 2 access failed");
+      return -1;
+   }
+
+   // invalidating the cache forces a re-select of the same page
+   ext.page_ok = false;
+   if (reg_write(&dev, 10, 0x02) || (bus->pages != 5) ||
+       (phys[2][2] != 0x02)) {
+      TEST_FAIL("page not re-selected after invalidation");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Failed page selection must not write to the wrong page.
+ */
+static int test_page_fail(void)
+{
+   uint32_t data[TEST_PAGE_REGS] = {0};
+   struct reg_dev dev            = test_dev(data);
+
+   if (reg_set(&dev, "A", 0x11)) {
+      TEST_FAIL("reg_set(A) failed");
+      return -1;
+   }
+
+   bus->page_fail = true;
+   if (reg_set(&dev, "C", 0x33) == 0) {
+      TEST_FAIL("reg_set should fail when page_fn fails");
+      return -1;
+   }
+
+   if ((bus->writes != 1) || ext.page_ok) {
+      TEST_FAIL("write went through despite failed page select");
+      return -1;
+   }
+
+   // a failed read leaves the buffered value in place
+   data[6] = 0x66;
+   if ((reg_read(&dev, 6) != 0) || (data[6] != 0x66)) {
+      TEST_FAIL("failed read changed the buffer");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Paged devices must provide page_fn.
+ */
+static int test_page_missing_fn(void)
+{
+   TEST_NEED_CHECKS(1);
+
+   uint32_t data[TEST_PAGE_REGS] = {0};
+   struct reg_dev dev            = test_dev(data);
+   ext.page_fn                   = NULL;
+
+   if (reg_set(&dev, "A", 0x11) == 0) {
+      TEST_FAIL("reg_set should fail without page_fn");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_page(void)
+{
+   static int (*valid_fn[])(void) = {test_page_select, test_page_across,
+                                     NULL};
+
+   static int (*invalid_fn[])(void) = {test_page_fail, test_page_missing_fn,
+                                       NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_page.c
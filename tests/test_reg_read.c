@@ -397,6 +397,8 @@ static int test_reg_width_17_invalid(void)
  */
 static int test_null_device_or_fn(void)
 {
+   TEST_NEED_CHECKS(1);
+
    struct reg_dev dev = {
        .reg_width = 16, .reg_num = 4, .data = test_data, .read_fn = NULL};
 
@@ -441,6 +443,8 @@ static int test_zero_width(void)
  */
 static int test_reg_out_of_range(void)
 {
+   TEST_NEED_CHECKS(1);
+
    struct reg_dev dev = {
        .reg_width = 16,
        .reg_num   = 4,
@@ -464,6 +468,8 @@ static int test_reg_out_of_range(void)
  */
 static int test_reg_equal_regnum(void)
 {
+   TEST_NEED_CHECKS(1);
+
    struct reg_dev dev = {
        .reg_width = 16,
        .reg_num   = 4,
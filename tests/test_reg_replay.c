@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_replay.c
+ * @brief Tests for recording and replaying register sessions.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/replay.h"
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_REPLAY_REGS 4U
+#define TEST_REPLAY_LEN  64U
+#define TEST_REPLAY_FILE "test_replay.bin"
+
+// fields in test_fields, without the terminator
+#define TEST_REPLAY_FIELDS 4U
+
+static const struct reg_field test_fields[] = {
+    // name reg off wd  flags
+    {"A",    0,  0,  8,  0           },
+    {"B",    0,  8,  8,  0           },
+    {"W",    1,  0,  32, 0           }, // registers 1 and 2
+    {"S",    3,  0,  16, REG_VOLATILE},
+    {NULL,   0,  0,  0,  0           }
+};
+
+static const struct reg_field map1[] = {
+    {"X",  0, 0, 8, 0},
+    {"Y",  0, 8, 8, 0},
+    {NULL, 0, 0, 0, 0}
+};
+
+static const struct reg_field map2[] = {
+    {"X",  0, 0, 16, 0},
+    {"Y",  1, 0, 16, 0},
+    {NULL, 0, 0, 0,  0}
+};
+
+static const char *virt_fields[]           = {"X", "Y", "_Z", NULL};
+static const struct reg_field *virt_maps[] = {map1, map2, NULL};
+
+// physical registers of the physical (0) and virtual (1) device
+static uint32_t *const phys[2] = {test_bus[0].regs, test_bus[1].regs};
+
+/**
+ * @brief Take a copy of the registers of both devices.
+ */
+static void test_save(uint32_t expect[2][TEST_REPLAY_REGS])
+{
+   for (size_t i = 0; i < 2; i++)
+      memcpy(expect[i], phys[i], sizeof(expect[i]));
+}
+
+/**
+ * @brief Compare the registers of both devices against a copy.
+ */
+static int test_compare(uint32_t expect[2][TEST_REPLAY_REGS])
+{
+   for (size_t i = 0; i < 2; i++)
+      if (memcmp(expect[i], phys[i], sizeof(expect[i])))
+         return -1;
+   return 0;
+}
+
+// a session: devices, buffers, and optional trace and statistics
+struct test_session {
+   uint32_t data[TEST_REPLAY_REGS];
+   uint32_t virt_data[TEST_REPLAY_REGS];
+   uint64_t virt_vals[3];
+   struct reg_dev dev;
+   struct reg_virt virt;
+   struct reg_stats stats;
+   struct reg_ext ext;
+};
+
+static void test_session(struct test_session *s, struct reg_trace *trace)
+{
+   memset(s, 0, sizeof(*s));
+   test_bus_reset();
+   s->ext = (struct reg_ext){.stats = &s->stats, .trace = trace};
+
+   s->dev     = test_bus_dev(0, test_fields, 16, TEST_REPLAY_REGS, s->data);
+   s->dev.ext = &s->ext;
+
+   s->virt = (struct reg_virt){
+       .fields  = virt_fields,
+       .data    = s->virt_vals,
+       .maps    = virt_maps,
+       .load_fn = test_bus_load,
+       .base    = s->dev,
+   };
+   s->virt.base.field_map = NULL;
+   s->virt.base.arg       = 1;
+   s->virt.base.data      = s->virt_data;
+}
+
+/**
+ * @brief Let the physical device of a session take its fields from a map.
+ */
+static int test_share(struct test_session *s, struct reg_map *m, size_t *index)
+{
+   *m = (struct reg_map){.field_map = test_fields};
+   if (reg_map_init(m, index, TEST_REPLAY_FIELDS)) {
+      TEST_FAIL("reg_map_init failed");
+      return -1;
+   }
+
+   s->dev.field_map = NULL;
+   s->dev.map       = m;
+   return 0;
+}
+
+/**
+ * @brief Run a short session with all four recorded calls.
+ */
+static int test_workload(struct test_session *s)
+{
+   phys[0][3] = 0x5555U;
+   if (reg_set(&s->dev, "A", 0x12) || reg_set(&s->dev, "W", 0xabcd1234U) ||
+       (reg_get(&s->dev, "S") != 0x5555U) ||
+       reg_adjust(&s->virt, "X", 0x7f) ||
+       reg_adjust(&s->virt, "_Z", 1ULL << 40U) ||
+       reg_adjust(&s->virt, "Y", 0x1234) ||
+       (reg_obtain(&s->virt, "_Z") != 1ULL << 40U) ||
+       reg_set(&s->dev, "B", 0x34)) {
+      TEST_FAIL("session failed");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Record, save, load, and replay a session.
+ */
+static int test_replay_session(void)
+{
+   static struct reg_trace_rec buf[TEST_REPLAY_LEN];
+   struct reg_trace trace = {0};
+   if (reg_trace_init(&trace, buf, TEST_REPLAY_LEN, NULL)) {
+      TEST_FAIL("reg_trace_init failed");
+      return -1;
+   }
+
+   struct test_session rec;
+   test_session(&rec, &trace);
+   if (test_workload(&rec))
+      return -1;
+
+   static struct reg_trace_rec recs[TEST_REPLAY_LEN];
+   const size_t num = reg_trace_dump(&trace, recs, TEST_REPLAY_LEN);
+   if ((num == 0) || (num != trace.head)) {
+      TEST_FAIL("trace overflowed or empty: %zu records", trace.head);
+      return -1;
+   }
+
+   uint32_t expect[2][TEST_REPLAY_REGS];
+   test_save(expect);
+
+   static struct reg_trace_rec loaded[TEST_REPLAY_LEN];
+   if (replay_save(TEST_REPLAY_FILE, recs, num) ||
+       (replay_load(TEST_REPLAY_FILE, loaded, TEST_REPLAY_LEN) != num) ||
+       memcmp(loaded, recs, num * sizeof(recs[0]))) {
+      TEST_FAIL("records changed by save and load");
+      remove(TEST_REPLAY_FILE);
+      return -1;
+   }
+   remove(TEST_REPLAY_FILE);
+
+   // replay on fresh devices, without a trace
+   struct test_session rep;
+   test_session(&rep, NULL);
+   phys[0][3] = 0x5555U;
+
+   struct reg_dev *devs[]   = {&rep.dev};
+   struct reg_virt *virts[] = {&rep.virt};
+   struct replay_result res;
+   if (replay_run(loaded, num, devs, 1, virts, 1, &res)) {
+      TEST_FAIL("replay_run failed");
+      return -1;
+   }
+
+   if ((res.calls[REPLAY_SET] != 3) || (res.calls[REPLAY_GET] != 1) ||
+       (res.calls[REPLAY_ADJUST] != 3) || (res.calls[REPLAY_OBTAIN] != 1) ||
+       (res.errors != 0)) {
+      TEST_FAIL("wrong number of calls replayed");
+      return -1;
+   }
+
+   if ((res.bus_replayed != res.bus_recorded) || (res.bus_recorded == 0)) {
+      TEST_FAIL("%zu bus operations recorded, %zu replayed", res.bus_recorded,
+                res.bus_replayed);
+      return -1;
+   }
+
+   if (test_compare(expect) || (rep.virt_vals[2] != 1ULL << 40U)) {
+      TEST_FAIL("replay did not reach the recorded state");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Bad files and records that do not match the devices.
+ */
+static int test_replay_invalid(void)
+{
+   static struct reg_trace_rec recs[TEST_REPLAY_LEN];
+
+   if (replay_load("no_such_file.bin", recs, TEST_REPLAY_LEN) != 0) {
+      TEST_FAIL("missing file loaded");
+      return -1;
+   }
+
+   FILE *f = fopen(TEST_REPLAY_FILE, "wb");
+   if (!f || (fputs("not a replay file", f) < 0) || fclose(f)) {
+      TEST_FAIL("cannot write test file");
+      return -1;
+   }
+   const size_t bad = replay_load(TEST_REPLAY_FILE, recs, TEST_REPLAY_LEN);
+   remove(TEST_REPLAY_FILE);
+   if (bad != 0) {
+      TEST_FAIL("file without header loaded");
+      return -1;
+   }
+
+   const struct reg_trace_rec set[] = {
+       {0, 2, 5, 0, REG_TRACE_SET, 0},
+       {0, 9, 5, 0, REG_TRACE_SET, 0},
+   };
+
+   if (replay_save(TEST_REPLAY_FILE, set, 2) ||
+       (replay_load(TEST_REPLAY_FILE, recs, 1) != 0)) {
+      TEST_FAIL("file larger than the buffer loaded");
+      remove(TEST_REPLAY_FILE);
+      return -1;
+   }
+   remove(TEST_REPLAY_FILE);
+
+   struct test_session s;
+   test_session(&s, NULL);
+   struct reg_dev *devs[] = {&s.dev};
+   struct replay_result res;
+
+   // unknown field ID, then unknown device
+   if ((replay_run(set, 2, devs, 1, NULL, 0, &res) == 0) ||
+       (replay_run(set, 1, NULL, 0, NULL, 0, &res) == 0)) {
+      TEST_FAIL("unreplayable record accepted");
+      return -1;
+   }
+
+   // more distinct statistics blocks than can be counted
+   static struct reg_dev many[65];
+   static struct reg_stats many_stats[65];
+   static struct reg_ext many_ext[65];
+   static struct reg_dev *many_devs[65];
+   for (size_t i = 0; i < 65; i++) {
+      many_ext[i]  = (struct reg_ext){.stats = &many_stats[i]};
+      many[i]      = s.dev;
+      many[i].ext  = &many_ext[i];
+      many_devs[i] = &many[i];
+   }
+
+   if (replay_run(set, 0, many_devs, 65, NULL, 0, &res) == 0) {
+      TEST_FAIL("too many statistics blocks accepted");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Replay a session of a device with a shared map index.
+ */
+static int test_replay_map(void)
+{
+   static struct reg_trace_rec buf[TEST_REPLAY_LEN];
+   struct reg_trace trace = {0};
+   if (reg_trace_init(&trace, buf, TEST_REPLAY_LEN, NULL)) {
+      TEST_FAIL("reg_trace_init failed");
+      return -1;
+   }
+
+   struct reg_map map;
+   size_t index[TEST_REPLAY_FIELDS];
+   struct test_session rec;
+   test_session(&rec, &trace);
+   if (test_share(&rec, &map, index) || test_workload(&rec))
+      return -1;
+
+   static struct reg_trace_rec recs[TEST_REPLAY_LEN];
+   const size_t num = reg_trace_dump(&trace, recs, TEST_REPLAY_LEN);
+
+   uint32_t expect[2][TEST_REPLAY_REGS];
+   test_save(expect);
+
+   struct test_session rep;
+   test_session(&rep, NULL);
+   if (test_share(&rep, &map, index))
+      return -1;
+   phys[0][3] = 0x5555U;
+
+   struct reg_dev *devs[]   = {&rep.dev};
+   struct reg_virt *virts[] = {&rep.virt};
+   struct replay_result res;
+   if (replay_run(recs, num, devs, 1, virts, 1, &res) ||
+       (res.calls[REPLAY_SET] != 3) || (res.calls[REPLAY_GET] != 1) ||
+       test_compare(expect)) {
+      TEST_FAIL("replay on a shared map failed");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_replay(void)
+{
+   static int (*valid_fn[])(void) = {test_replay_session, test_replay_map,
+                                     NULL};
+
+   static int (*invalid_fn[])(void) = {test_replay_invalid, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_replay.c
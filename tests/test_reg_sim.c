@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_sim.c
+ * @brief Tests for the simulated device backend.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+// for clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+
+#include "tests/sim_dev.h"
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_SIM_DEV  4U
+#define TEST_SIM_REGS 4U
+
+static const struct reg_field test_fields[] = {
+    // name reg off wd  flags
+    {"A",    0,  0,  16, 0           },
+    {"W",    1,  0,  32, 0           }, // registers 1 and 2
+    {"S",    3,  0,  16, REG_VOLATILE},
+    {NULL,   0,  0,  0,  0           }
+};
+
+static uint32_t regs[TEST_SIM_DEV][TEST_SIM_REGS];
+static uint32_t data[TEST_SIM_DEV][TEST_SIM_REGS];
+static struct sim_dev sims[TEST_SIM_DEV];
+static struct reg_dev devs[TEST_SIM_DEV];
+
+static int test_sim(void)
+{
+   memset(regs, 0, sizeof(regs));
+   memset(data, 0, sizeof(data));
+
+   for (size_t i = 0; i < TEST_SIM_DEV; i++) {
+      sims[i] = (struct sim_dev){
+          .regs      = regs[i],
+          .reg_num   = TEST_SIM_REGS,
+          .txn_ns    = 1000,
+          .word_ns   = 100,
+          .turn_ns   = 50,
+          .group_num = TEST_SIM_DEV,
+      };
+
+      // the simulator replaces the stubs with its own read_fn and write_fn
+      devs[i] = test_bus_dev((int)i, test_fields, 16, TEST_SIM_REGS, data[i]);
+      if (sim_attach(&sims[i], &devs[i], (int)i)) {
+         TEST_FAIL("sim_attach failed");
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Reads and writes are charged in virtual time.
+ */
+static int test_sim_costs(void)
+{
+   if (test_sim())
+      return -1;
+
+   if (reg_set(&devs[0], "W", 0x12345678U) || (regs[0][1] != 0x5678U) ||
+       (regs[0][2] != 0x1234U)) {
+      TEST_FAIL("write not stored in the register file");
+      return -1;
+   }
+
+   if ((sims[0].txns != 2) || (sims[0].time_ns != 2 * 1100U)) {
+      TEST_FAIL("%zu transactions, %" PRIu64 " ns", sims[0].txns,
+                sims[0].time_ns);
+      return -1;
+   }
+
+   regs[0][3] = 0xbeefU;
+   sim_reset(&sims[0]);
+   if ((reg_get(&devs[0], "S") != 0xbeefU) || (sims[0].time_ns != 1150U)) {
+      TEST_FAIL("read not charged with turnaround");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief A group write is one transaction for all devices.
+ */
+static int test_sim_burst(void)
+{
+   if (test_sim())
+      return -1;
+
+   uint32_t vals[TEST_SIM_DEV];
+   struct reg_group grp = {
+       .devs     = devs,
+       .dev_num  = TEST_SIM_DEV,
+       .arg      = 0,
+       .write_fn = sim_group_write,
+       .vals     = vals,
+   };
+
+   if (reg_group_set(&grp, "W", 0x10001U)) {
+      TEST_FAIL("reg_group_set failed");
+      return -1;
+   }
+
+   // two frames of four words, versus eight separate transactions
+   const uint64_t burst = sims[0].time_ns;
+   if ((sims[0].txns != 2) || (sims[0].words != 8) ||
+       (burst != 2 * (1000U + 4 * 100U))) {
+      TEST_FAIL("burst charged %" PRIu64 " ns", burst);
+      return -1;
+   }
+
+   const uint64_t each[TEST_SIM_DEV] = {0x10001U, 0x20002U, 0x30003U,
+                                        0x40004U};
+   sim_reset(&sims[0]);
+   if (reg_group_set_each(&grp, "W", each)) {
+      TEST_FAIL("reg_group_set_each failed");
+      return -1;
+   }
+
+   for (size_t i = 0; i < TEST_SIM_DEV; i++) {
+      if ((regs[i][1] != (uint32_t)(each[i] & 0xffffU)) ||
+          (regs[i][2] != (uint32_t)(each[i] >> 16U))) {
+         TEST_FAIL("group write not stored in device %zu", i);
+         return -1;
+      }
+   }
+
+   grp.write_fn = NULL;
+   sim_reset(&sims[0]);
+   if (reg_group_set(&grp, "W", 0x20002U)) {
+      TEST_FAIL("reg_group_set failed");
+      return -1;
+   }
+
+   uint64_t single = 0;
+   for (size_t i = 0; i < TEST_SIM_DEV; i++)
+      single += sims[i].time_ns;
+
+   if (single <= burst) {
+      TEST_FAIL("separate writes no slower than a burst");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief With busy-waiting, the costs are spent in real time too.
+ */
+static int test_sim_busy(void)
+{
+   if (test_sim())
+      return -1;
+
+   sims[0].txn_ns    = 200000;
+   sims[0].busy_wait = true;
+
+   struct timespec t0;
+   struct timespec t1;
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   if (reg_set(&devs[0], "W", 1)) {
+      TEST_FAIL("reg_set failed");
+      return -1;
+   }
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+
+   const double elapsed = (double)(t1.tv_sec - t0.tv_sec) +
+                          ((double)(t1.tv_nsec - t0.tv_nsec) * 1e-9);
+   if (elapsed < 2 * 200e-6) {
+      TEST_FAIL("busy-wait took only %.0f us", elapsed * 1e6);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Injected faults fail writes and corrupt reads.
+ */
+static int test_sim_faults(void)
+{
+   if (test_sim())
+      return -1;
+
+   sims[0].fault_period = 2;
+   sims[0].fault_mask   = 0x1U;
+
+   // the second register write fails
+   if ((reg_set(&devs[0], "W", 0x30003U) == 0) || (regs[0][2] != 0) ||
+       (sims[0].faults != 1)) {
+      TEST_FAIL("write fault not injected");
+      return -1;
+   }
+
+   // the fourth transaction, a read, is corrupted
+   regs[0][3] = 0x10U;
+   if ((reg_get(&devs[0], "S") != 0x10U) ||
+       (reg_get(&devs[0], "S") != 0x11U) || (sims[0].faults != 2)) {
+      TEST_FAIL("read fault not injected");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Registers and slots outside the simulation are rejected.
+ */
+static int test_sim_invalid(void)
+{
+   if (test_sim())
+      return -1;
+
+   if ((sim_attach(&sims[0], NULL, (int)SIM_DEV_MAX) == 0) ||
+       (sim_write(0, TEST_SIM_REGS, 1) == 0) ||
+       (sim_read((int)SIM_DEV_MAX - 1, 0) != 0)) {
+      TEST_FAIL("invalid simulated access accepted");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_sim(void)
+{
+   static int (*valid_fn[])(void) = {test_sim_costs, test_sim_burst,
+                                     test_sim_busy, NULL};
+
+   static int (*invalid_fn[])(void) = {test_sim_faults, test_sim_invalid,
+                                       NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_sim.c
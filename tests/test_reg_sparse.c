@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_sparse.c
+ * @brief Tests for devices with a sparse register space.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_SPARSE_REGS  126U
+#define TEST_SPARSE_SLOTS 6U
+
+static const struct reg_field test_dev_map[] = {
+    // name         reg off wd  flags
+    {"POWERDOWN",    0,  0,  1,  0},
+    {"RESET",        0,  1,  1,  0},
+    {"R0_RES",       0,  2,  14, 0},
+    {"R34_RES",      34, 3,  13, 0},
+    {"PLL_N_MSB",    34, 0,  3,  0},
+    {"PLL_N_LSB",    36, 0,  16, 0},
+    {"R37_RES2",     37, 0,  8,  0},
+    {"PFD_DLY_SEL",  37, 8,  6,  0},
+    {"R37_RES1",     37, 14, 1,  0},
+    {"MASH_SEED_EN", 37, 15, 1,  0},
+    {"PLL_NUM",      43, 0,  32, 0},
+    {NULL,           0,  0,  0,  0}  // sentinel
+};
+
+static const size_t expected_slots[TEST_SPARSE_SLOTS] = {0,  34, 36,
+                                                         37, 42, 43};
+
+static uint32_t *const phys = test_bus[0].regs;
+static struct reg_ext ext;
+
+static struct reg_dev test_dev(uint32_t *data)
+{
+   memset(&ext, 0, sizeof(ext));
+
+   struct reg_dev d = test_bus_dev(0, test_dev_map, 16, TEST_SPARSE_REGS, data);
+   d.flags          = REG_DESCEND | REG_MSR_FIRST;
+   d.ext            = &ext;
+   return d;
+}
+
+/**
+ * @brief Slot table generated from the field map.
+ */
+static int test_sparse_slots(void)
+{
+   uint32_t data[TEST_SPARSE_SLOTS] = {0};
+   size_t slots[TEST_SPARSE_SLOTS]  = {0};
+   struct reg_dev dev               = test_dev(data);
+
+   if (reg_slots(&dev, slots, TEST_SPARSE_SLOTS)) {
+      TEST_FAIL("reg_slots failed");
+      return -1;
+   }
+
+   if ((ext.slots != slots) || (ext.slot_num != TEST_SPARSE_SLOTS)) {
+      TEST_FAIL("slot table not installed, %zu slots", ext.slot_num);
+      return -1;
+   }
+
+   for (size_t i = 0; i < TEST_SPARSE_SLOTS; i++)
+      if (slots[i] != expected_slots[i]) {
+         TEST_FAIL("slots[%zu] = %zu, expected %zu", i, slots[i],
+                   expected_slots[i]);
+         return -1;
+      }
+
+   if (reg_check(&dev)) {
+      TEST_FAIL("reg_check failed");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Field access on the compact buffer.
+ */
+static int test_sparse_get_set(void)
+{
+   uint32_t data[TEST_SPARSE_SLOTS] = {0};
+   struct reg_dev dev               = test_dev(data);
+   ext.slots                        = expected_slots;
+   ext.slot_num                     = TEST_SPARSE_SLOTS;
+
+   if (reg_check(&dev)) {
+      TEST_FAIL("reg_check failed");
+      return -1;
+   }
+
+   if (reg_set(&dev, "PLL_NUM", 0x12345678U) ||
+       reg_set(&dev, "PFD_DLY_SEL", 0x2a) || reg_set(&dev, "RESET", 1)) {
+      TEST_FAIL("reg_set failed");
+      return -1;
+   }
+
+   // slots 4 and 5 hold registers 42 and 43
+   if ((data[4] != 0x1234U) || (data[5] != 0x5678U) || (data[3] != 0x2a00U) ||
+       (data[0] != 0x2U)) {
+      TEST_FAIL("wrong buffer contents");
+      printout_buffer(data, TEST_SPARSE_SLOTS);
+      return -1;
+   }
+
+   // the physical device still sees the full register numbers
+   if ((phys[42] != 0x1234U) || (phys[43] != 0x5678U) ||
+       (phys[37] != 0x2a00U)) {
+      TEST_FAIL("wrong physical register contents");
+      return -1;
+   }
+
+   if ((reg_get(&dev, "PLL_NUM") != 0x12345678U) ||
+       (reg_get(&dev, "PFD_DLY_SEL") != 0x2a)) {
+      TEST_FAIL("reg_get returned wrong value");
+      return -1;
+   }
+
+   phys[36] = 0xbeefU;
+   if ((reg_read(&dev, 36) != 0xbeefU) || (data[2] != 0xbeefU)) {
+      TEST_FAIL("reg_read did not update slot 2");
+      return -1;
+   }
+
+   const uint32_t bulk[TEST_SPARSE_SLOTS] = {1, 2, 3, 4, 5, 6};
+   if (reg_bulk(&dev, bulk) || (reg_get(&dev, "PLL_NUM") != 0x50006U)) {
+      TEST_FAIL("reg_bulk did not use the compact layout");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Registers outside the slot table cannot be accessed.
+ */
+static int test_sparse_unpopulated(void)
+{
+   uint32_t data[TEST_SPARSE_SLOTS] = {0};
+   struct reg_dev dev               = test_dev(data);
+   ext.slots                        = expected_slots;
+   ext.slot_num                     = TEST_SPARSE_SLOTS;
+
+   if (reg_write(&dev, 35, 0x1234U) == 0) {
+      TEST_FAIL("reg_write to unpopulated register succeeded");
+      return -1;
+   }
+
+   if (phys[35] != 0) {
+      TEST_FAIL("unpopulated register written to device");
+      return -1;
+   }
+
+   if (reg_read(&dev, 1) != 0) {
+      TEST_FAIL("reg_read of unpopulated register returned data");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief reg_check must reject tables that miss a field register.
+ */
+static int test_sparse_missing_slot(void)
+{
+   static const size_t slots[] = {0, 34, 36, 37, 43};
+
+   uint32_t data[TEST_SPARSE_SLOTS] = {0};
+   struct reg_dev dev               = test_dev(data);
+   ext.slots                        = slots;
+   ext.slot_num                     = sizeof(slots) / sizeof(slots[0]);
+
+   if (reg_check(&dev) == 0) {
+      TEST_FAIL("reg_check accepted table without register 42");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief reg_check must reject unsorted tables.
+ */
+static int test_sparse_unsorted(void)
+{
+   static const size_t slots[] = {0, 34, 37, 36, 42, 43};
+
+   uint32_t data[TEST_SPARSE_SLOTS] = {0};
+   struct reg_dev dev               = test_dev(data);
+   ext.slots                        = slots;
+   ext.slot_num                     = sizeof(slots) / sizeof(slots[0]);
+
+   if (reg_check(&dev) == 0) {
+      TEST_FAIL("reg_check accepted unsorted table");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief reg_slots must not overrun a small table.
+ */
+static int test_sparse_small_table(void)
+{
+   uint32_t data[TEST_SPARSE_SLOTS]    = {0};
+   size_t slots[TEST_SPARSE_SLOTS + 1] = {0};
+   struct reg_dev dev                  = test_dev(data);
+
+   if (reg_slots(&dev, slots, TEST_SPARSE_SLOTS - 1) == 0) {
+      TEST_FAIL("reg_slots accepted a small table");
+      return -1;
+   }
+
+   if ((ext.slots != NULL) || (slots[TEST_SPARSE_SLOTS] != 0)) {
+      TEST_FAIL("reg_slots modified the device or overran the table");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_sparse(void)
+{
+   static int (*valid_fn[])(void) = {test_sparse_slots, test_sparse_get_set,
+                                     NULL};
+
+   static int (*invalid_fn[])(void) = {
+       test_sparse_unpopulated, test_sparse_missing_slot, test_sparse_unsorted,
+       test_sparse_small_table, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_sparse.c
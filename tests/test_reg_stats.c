@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_stats.c
+ * @brief Tests for the access statistics counters.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_STATS_REGS 4U
+
+static const struct reg_field test_fields[] = {
+    // name reg off wd  flags
+    {"A",    0,  0,  8,  0           },
+    {"B",    0,  8,  8,  0           },
+    {"W",    1,  0,  32, 0           }, // registers 1 and 2
+    {"S",    3,  0,  16, REG_VOLATILE},
+    {NULL,   0,  0,  0,  0           }
+};
+
+static uint32_t phys[TEST_STATS_REGS];
+
+static uint32_t test_read_fn(int arg, size_t reg)
+{
+   (void)arg;
+   return phys[reg];
+}
+
+static int test_write_fn(int arg, size_t reg, uint32_t val)
+{
+   (void)arg;
+   phys[reg] = val;
+   return 0;
+}
+
+static int test_group_fn(int arg, size_t reg, const uint32_t *vals)
+{
+   (void)arg;
+   (void)reg;
+   (void)vals;
+   return 0;
+}
+
+static int test_load_fn(int arg, int id)
+{
+   (void)arg;
+   (void)id;
+   return 0;
+}
+
+static struct reg_ext ext;
+
+static struct reg_dev test_dev(uint32_t *data, struct reg_stats *stats)
+{
+   memset(phys, 0, sizeof(phys));
+   memset(stats, 0, sizeof(*stats));
+   ext = (struct reg_ext){.stats = stats};
+
+   return (struct reg_dev){
+       .reg_width = 16,
+       .reg_num   = TEST_STATS_REGS,
+       .field_map = test_fields,
+       .read_fn   = test_read_fn,
+       .write_fn  = test_write_fn,
+       .data      = data,
+       .ext       = &ext,
+   };
+}
+
+/**
+ * @brief Reads, writes, lookups, and locks of a single device.
+ */
+static int test_stats_single(void)
+{
+   uint32_t data[TEST_STATS_REGS] = {0};
+   struct reg_stats stats;
+   struct reg_dev dev = test_dev(data, &stats);
+
+   if (reg_set(&dev, "W", 0x12345678U) || (reg_get(&dev, "S") != 0)) {
+      TEST_FAIL("field access failed");
+      return -1;
+   }
+
+   struct reg_stats s;
+   if (reg_stats_get(&dev, &s)) {
+      TEST_FAIL("reg_stats_get failed");
+      return -1;
+   }
+
+   if ((s.write_calls != 2) || (s.regs_written != 2) ||
+       (s.bits_written != 32) || (s.read_calls != 1) || (s.regs_read != 1) ||
+       (s.bits_read != 16) || (s.compares != 7) || (s.locks != 2) ||
+       (s.lock_fails != 0) || (s.page_calls != 0)) {
+      TEST_FAIL("wrong counters: %" PRIu32 " writes, %" PRIu32
+                " reads, %" PRIu32 " compares",
+                s.write_calls, s.read_calls, s.compares);
+      return -1;
+   }
+
+   if (reg_stats_reset(&dev) || reg_stats_get(&dev, &s) ||
+       (s.write_calls != 0) || (s.compares != 0) || (s.locks != 0)) {
+      TEST_FAIL("reg_stats_reset did not clear the counters");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Group writes count the registers of every device.
+ */
+static int test_stats_group(void)
+{
+   uint32_t data[2][TEST_STATS_REGS] = {{0}};
+   uint32_t vals[2];
+   struct reg_stats stats;
+   struct reg_dev devs[2] = {test_dev(data[0], &stats),
+                             test_dev(data[1], &stats)};
+
+   struct reg_group grp = {
+       .devs     = devs,
+       .dev_num  = 2,
+       .write_fn = test_group_fn,
+       .vals     = vals,
+   };
+
+   if (reg_group_set(&grp, "W", 0xffffU)) {
+      TEST_FAIL("reg_group_set failed");
+      return -1;
+   }
+
+   // one lookup, two locks, two registers on each of two devices
+   if ((stats.compares != 3) || (stats.locks != 2) ||
+       (stats.write_calls != 0) || (stats.regs_written != 4) ||
+       (stats.bits_written != 64)) {
+      TEST_FAIL("wrong group counters: %" PRIu32 " registers, %" PRIu32
+                " compares",
+                stats.regs_written, stats.compares);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Virtual devices count map loads and field resets.
+ */
+static int test_stats_virt(void)
+{
+   static const struct reg_field map1[] = {
+       {"A",  0, 0, 8, 0},
+       {"B",  0, 8, 8, 0},
+       {NULL, 0, 0, 0, 0}
+   };
+
+   static const struct reg_field map2[] = {
+       {"A",  0, 0, 16, 0},
+       {"B",  1, 0, 16, 0},
+       {NULL, 0, 0, 0,  0}
+   };
+
+   static const char *fields[]            = {"A", "B", NULL};
+   static const struct reg_field *maps[] = {map1, map2, NULL};
+
+   uint64_t virt_data[2]          = {0};
+   uint32_t data[TEST_STATS_REGS] = {0};
+   struct reg_stats stats;
+   struct reg_virt v = {
+       .fields  = fields,
+       .data    = virt_data,
+       .maps    = maps,
+       .load_fn = test_load_fn,
+       .base    = test_dev(data, &stats),
+   };
+   v.base.field_map = NULL;
+
+   // first access loads map 1, the wide value then needs map 2
+   if (reg_adjust(&v, "A", 0xff) || reg_adjust(&v, "A", 0x1ff)) {
+      TEST_FAIL("reg_adjust failed");
+      return -1;
+   }
+
+   if ((stats.loads != 2) || (stats.resets != 2)) {
+      TEST_FAIL("%" PRIu32 " loads, %" PRIu32 " resets", stats.loads,
+                stats.resets);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief A device that is already locked counts as a lock failure.
+ */
+static int test_stats_lock_fail(void)
+{
+   uint32_t data[TEST_STATS_REGS] = {0};
+   struct reg_stats stats;
+   struct reg_dev dev = test_dev(data, &stats);
+   dev.lock_count     = 1;
+
+   if ((reg_set(&dev, "A", 1) == 0) || (stats.lock_fails != 1) ||
+       (stats.locks != 0) || (stats.write_calls != 0)) {
+      TEST_FAIL("lock failure not counted");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Statistics must be attached to be read or cleared.
+ */
+static int test_stats_missing(void)
+{
+   uint32_t data[TEST_STATS_REGS] = {0};
+   struct reg_stats stats;
+   struct reg_dev dev = test_dev(data, &stats);
+
+   struct reg_stats s;
+   if (reg_stats_get(&dev, NULL) == 0) {
+      TEST_FAIL("reg_stats_get accepted NULL output");
+      return -1;
+   }
+
+   ext.stats = NULL;
+   if ((reg_stats_get(&dev, &s) == 0) || (reg_stats_reset(&dev) == 0)) {
+      TEST_FAIL("device without statistics accepted");
+      return -1;
+   }
+
+   // access without statistics still works
+   if (reg_set(&dev, "A", 1) || (stats.write_calls != 0)) {
+      TEST_FAIL("detached statistics were updated");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_stats(void)
+{
+   static int (*valid_fn[])(void) = {test_stats_single, test_stats_group,
+                                     test_stats_virt, NULL};
+
+   static int (*invalid_fn[])(void) = {test_stats_lock_fail, test_stats_missing,
+                                       NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_stats.c
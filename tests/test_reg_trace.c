@@ -0,0 +1,326 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_reg_trace.c
+ * @brief Tests for the access trace ring buffer.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_common.h"
+#include "tests/test_reg.h"
+#include "utils/reg.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_TRACE_REGS 4U
+#define TEST_TRACE_LEN  8U
+
+static const struct reg_field test_fields[] = {
+    // name reg off wd  flags
+    {"A",    0,  0,  16, 0           },
+    {"W",    1,  0,  32, 0           }, // registers 1 and 2
+    {"S",    3,  0,  16, REG_VOLATILE},
+    {NULL,   0,  0,  0,  0           }
+};
+
+static uint32_t phys[TEST_TRACE_REGS];
+static size_t page_base;
+static uint32_t ticks;
+static int write_fail;
+
+static uint32_t test_read_fn(int arg, size_t reg)
+{
+   (void)arg;
+   return phys[page_base + reg];
+}
+
+static int test_write_fn(int arg, size_t reg, uint32_t val)
+{
+   (void)arg;
+   if (write_fail)
+      return -1;
+   phys[page_base + reg] = val;
+   return 0;
+}
+
+static int test_page_fn(int arg, size_t page)
+{
+   (void)arg;
+   page_base = 2 * page;
+   return 0;
+}
+
+static int test_group_fn(int arg, size_t reg, const uint32_t *vals)
+{
+   (void)arg;
+   (void)reg;
+   (void)vals;
+   return 0;
+}
+
+static int test_load_fn(int arg, int id)
+{
+   (void)arg;
+   (void)id;
+   return 0;
+}
+
+static uint32_t test_clock_fn(void)
+{
+   return ticks++;
+}
+
+static struct reg_trace_rec buf[TEST_TRACE_LEN];
+static struct reg_ext ext;
+
+static struct reg_dev test_dev(uint32_t *data, struct reg_trace *trace)
+{
+   memset(phys, 0, sizeof(phys));
+   memset(trace, 0, sizeof(*trace));
+   page_base  = 0;
+   ticks      = 100;
+   write_fail = 0;
+
+   if (reg_trace_init(trace, buf, TEST_TRACE_LEN, test_clock_fn))
+      TEST_FAIL("reg_trace_init failed");
+   ext = (struct reg_ext){.trace = trace};
+
+   return (struct reg_dev){
+       .reg_width = 16,
+       .reg_num   = TEST_TRACE_REGS,
+       .field_map = test_fields,
+       .arg       = 7,
+       .read_fn   = test_read_fn,
+       .write_fn  = test_write_fn,
+       .data      = data,
+       .ext       = &ext,
+   };
+}
+
+/**
+ * @brief Compare a record against the expected operation.
+ */
+static int test_rec(const struct reg_trace_rec *r, const uint8_t op,
+                    const uint32_t reg, const uint32_t val, const uint8_t err)
+{
+   if ((r->op != op) || (r->reg != reg) || (r->val != val) ||
+       (r->err != err)) {
+      TEST_FAIL("record op %u reg %" PRIu32 " val 0x%" PRIx32 " err %u",
+                r->op, r->reg, r->val, r->err);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Calls, reads, writes, and page selections are recorded in order.
+ */
+static int test_trace_order(void)
+{
+   uint32_t data[TEST_TRACE_REGS] = {0};
+   struct reg_trace trace         = {0};
+   struct reg_dev dev             = test_dev(data, &trace);
+   ext.page_len                   = 2;
+   ext.page_fn                    = test_page_fn;
+
+   phys[3] = 0xbeefU;
+   if (reg_set(&dev, "W", 0x12345678U) || (reg_get(&dev, "S") != 0xbeefU)) {
+      TEST_FAIL("field access failed");
+      return -1;
+   }
+
+   struct reg_trace_rec out[TEST_TRACE_LEN];
+   if ((trace.head != 7) || (reg_trace_dump(&trace, out, 8) != 7)) {
+      TEST_FAIL("%zu records", trace.head);
+      return -1;
+   }
+
+   if (test_rec(&out[0], REG_TRACE_PAGE, 0, 0, 0) ||
+       test_rec(&out[1], REG_TRACE_WRITE, 1, 0x5678U, 0) ||
+       test_rec(&out[2], REG_TRACE_PAGE, 1, 0, 0) ||
+       test_rec(&out[3], REG_TRACE_WRITE, 2, 0x1234U, 0) ||
+       test_rec(&out[4], REG_TRACE_SET, 1, 0x12345678U, 0) ||
+       test_rec(&out[5], REG_TRACE_READ, 3, 0xbeefU, 0) ||
+       test_rec(&out[6], REG_TRACE_GET, 2, 0xbeefU, 0) ||
+       (phys[1] != 0x5678U) || (phys[2] != 0x1234U))
+      return -1;
+
+   for (size_t i = 0; i < 7; i++)
+      if ((out[i].time != 100 + i) || (out[i].dev != 7)) {
+         TEST_FAIL("record %zu: time %" PRIu32, i, out[i].time);
+         return -1;
+      }
+
+   return 0;
+}
+
+/**
+ * @brief The ring keeps the most recent records.
+ */
+static int test_trace_wrap(void)
+{
+   uint32_t data[TEST_TRACE_REGS] = {0};
+   struct reg_trace trace         = {0};
+   struct reg_dev dev             = test_dev(data, &trace);
+
+   for (uint32_t i = 1; i <= 10; i++)
+      if (reg_set(&dev, "A", i)) {
+         TEST_FAIL("reg_set failed");
+         return -1;
+      }
+
+   struct reg_trace_rec out[TEST_TRACE_LEN];
+   if (reg_trace_dump(&trace, out, TEST_TRACE_LEN) != TEST_TRACE_LEN) {
+      TEST_FAIL("full ring not dumped");
+      return -1;
+   }
+
+   // each reg_set() is a write followed by the call itself
+   for (size_t i = 0; i < TEST_TRACE_LEN; i += 2)
+      if (test_rec(&out[i], REG_TRACE_WRITE, 0, (uint32_t)i / 2 + 7, 0) ||
+          test_rec(&out[i + 1], REG_TRACE_SET, 0, (uint32_t)i / 2 + 7, 0))
+         return -1;
+
+   // a shorter dump gets the newest records
+   if ((reg_trace_dump(&trace, out, 2) != 2) || (out[0].val != 10) ||
+       (out[0].op != REG_TRACE_WRITE) || (out[1].op != REG_TRACE_SET)) {
+      TEST_FAIL("short dump did not return the newest records");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Group writes and virtual map loads are recorded per device.
+ */
+static int test_trace_group_load(void)
+{
+   uint32_t data[2][TEST_TRACE_REGS] = {{0}};
+   uint32_t vals[2];
+   struct reg_trace trace = {0};
+   struct reg_dev devs[2] = {test_dev(data[0], &trace),
+                             test_dev(data[1], &trace)};
+   devs[1].arg            = 8;
+
+   struct reg_group grp = {
+       .devs     = devs,
+       .dev_num  = 2,
+       .write_fn = test_group_fn,
+       .vals     = vals,
+   };
+
+   static const uint64_t a[2] = {0x11U, 0x22U};
+   struct reg_trace_rec out[TEST_TRACE_LEN];
+   if (reg_group_set_each(&grp, "A", a) ||
+       (reg_trace_dump(&trace, out, TEST_TRACE_LEN) != 2) ||
+       test_rec(&out[0], REG_TRACE_GROUP, 0, 0x11U, 0) ||
+       test_rec(&out[1], REG_TRACE_GROUP, 0, 0x22U, 0) || (out[0].dev != 7) ||
+       (out[1].dev != 8)) {
+      TEST_FAIL("group write not traced");
+      return -1;
+   }
+
+   static const struct reg_field map1[] = {
+       {"A",  0, 0, 8, 0},
+       {NULL, 0, 0, 0, 0}
+   };
+
+   static const struct reg_field map2[] = {
+       {"A",  0, 0, 16, 0},
+       {NULL, 0, 0, 0,  0}
+   };
+
+   static const char *fields[]            = {"A", NULL};
+   static const struct reg_field *maps[] = {map1, map2, NULL};
+
+   uint64_t virt_data[1] = {0};
+   struct reg_virt v = {
+       .fields  = fields,
+       .data    = virt_data,
+       .maps    = maps,
+       .load_fn = test_load_fn,
+       .base    = test_dev(data[0], &trace),
+   };
+   v.base.field_map = NULL;
+
+   // the value does not fit the default map 0, so map 1 is loaded
+   if (reg_adjust(&v, "A", 0x142) ||
+       (reg_trace_dump(&trace, out, TEST_TRACE_LEN) != 4) ||
+       test_rec(&out[0], REG_TRACE_LOAD, 0, 0, 0) ||
+       test_rec(&out[1], REG_TRACE_LOAD, 1, 0, 0) ||
+       test_rec(&out[2], REG_TRACE_WRITE, 0, 0x142U, 0) ||
+       test_rec(&out[3], REG_TRACE_ADJUST, 0, 0x142U, 0)) {
+      TEST_FAIL("map load not traced");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Failed writes are recorded with the error flag set.
+ */
+static int test_trace_error(void)
+{
+   uint32_t data[TEST_TRACE_REGS] = {0};
+   struct reg_trace trace         = {0};
+   struct reg_dev dev             = test_dev(data, &trace);
+   write_fail                     = 1;
+
+   struct reg_trace_rec out[TEST_TRACE_LEN];
+   if ((reg_set(&dev, "A", 5) == 0) ||
+       (reg_trace_dump(&trace, out, TEST_TRACE_LEN) != 2) ||
+       test_rec(&out[0], REG_TRACE_WRITE, 0, 5, 1) ||
+       test_rec(&out[1], REG_TRACE_SET, 0, 5, 1)) {
+      TEST_FAIL("failed write not traced");
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief The ring length must be a power of two.
+ */
+static int test_trace_invalid(void)
+{
+   struct reg_trace trace = {0};
+
+   if ((reg_trace_init(&trace, buf, 6, NULL) == 0) ||
+       (reg_trace_init(&trace, buf, 0, NULL) == 0) ||
+       (reg_trace_init(&trace, NULL, TEST_TRACE_LEN, NULL) == 0) ||
+       (trace.buf != NULL)) {
+      TEST_FAIL("invalid trace buffer accepted");
+      return -1;
+   }
+
+   struct reg_trace_rec out[1];
+   if (reg_trace_dump(&trace, out, 1) != 0) {
+      TEST_FAIL("dump of uninitialized trace returned records");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_reg_trace(void)
+{
+   static int (*valid_fn[])(void) = {test_trace_order, test_trace_wrap,
+                                     test_trace_group_load, NULL};
+
+   static int (*invalid_fn[])(void) = {test_trace_error, test_trace_invalid,
+                                       NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_reg_trace.c
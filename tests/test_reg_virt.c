@@ -6,6 +6,9 @@
  * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
  */
 
+// error site IDs, decoded by scripts/debug_ids.py
+#define DEBUG_FILE_ID 4
+
 #include "tests/test_common.h"
 #include "tests/test_reg.h"
 #include "utils/debug.h"
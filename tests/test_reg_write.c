@@ -74,6 +74,8 @@ static int test_reg_write_valid(void)
  */
 static int test_reg_write_null_device(void)
 {
+   TEST_NEED_CHECKS(1);
+
    if (reg_write(NULL, 0, 0x12345678) != -1) {
       TEST_FAIL("null device not rejected");
       return -1;
@@ -87,6 +89,8 @@ static int test_reg_write_null_device(void)
  */
 static int test_reg_write_null_data(void)
 {
+   TEST_NEED_CHECKS(1);
+
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = 2,
@@ -129,6 +133,8 @@ static int test_reg_write_zero_width(void)
  */
 static int test_reg_write_oob_register(void)
 {
+   TEST_NEED_CHECKS(1);
+
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = 3,
@@ -266,6 +272,8 @@ static int test_reg_write_max_value(void)
  */
 static int test_reg_write_size_max_index(void)
 {
+   TEST_NEED_CHECKS(1);
+
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = 4,
@@ -288,6 +296,8 @@ static int test_reg_write_size_max_index(void)
  */
 static int test_reg_write_zero_registers(void)
 {
+   TEST_NEED_CHECKS(1);
+
    struct reg_dev dev = {
        .reg_width = 32,
        .reg_num   = 0,
@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_snprintf.c
+ * @brief Tests for the replacement snprintf.c.
+ *
+ * Most conversions are compared with those of the C library of the host.
+ *
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#include "tests/test_snprintf.h"
+#include "tests/test_common.h"
+#include "utils/snprintf.h"
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_SNPRINTF_LEN 128U
+
+#define TEST_ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+/**
+ * @brief Compare a conversion with the C library, for a given output size.
+ *
+ * @param size Size of the output buffer, at most TEST_SNPRINTF_LEN.
+ * @param fmt Format string, followed by its arguments.
+ * @return 0 if the output and the return value match, -1 otherwise.
+ */
+__attribute__((format(printf, 2, 3))) static int
+test_fmt(const size_t size, const char *fmt, ...)
+{
+   char got[TEST_SNPRINTF_LEN];
+   char want[TEST_SNPRINTF_LEN];
+   memset(got, 'x', sizeof(got));
+   memset(want, 'x', sizeof(want));
+
+   va_list a;
+   va_list b;
+   va_start(a, fmt);
+   va_copy(b, a);
+   const int n_got  = rpl_vsnprintf(got, size, fmt, a);
+   const int n_want = vsnprintf(want, size, fmt, b);
+   va_end(b);
+   va_end(a);
+
+   if ((n_got != n_want) || (memcmp(got, want, sizeof(got)) != 0)) {
+      got[sizeof(got) - 1]   = '\0';
+      want[sizeof(want) - 1] = '\0';
+      TEST_FAIL("\"%s\", size %zu: \"%s\" (%d), expected \"%s\" (%d)", fmt,
+                size, got, n_got, want, n_want);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Integers in all bases, across the wide and narrow division paths.
+ */
+static int test_snprintf_int(void)
+{
+   static const unsigned long long vals[] = {
+       0,           1,           9,
+       10,          99,          100,
+       101,         999,         1000,
+       65535,       UINT_MAX,    (unsigned long long)UINT_MAX + 1,
+       4294967395U, 99999999999, 10000000000000000000U,
+       ULLONG_MAX,
+   };
+
+   for (size_t i = 0; i < TEST_ARRAY_LEN(vals); i++) {
+      const unsigned long long v = vals[i];
+      const long long s          = (long long)(v >> 1U);
+      if (test_fmt(TEST_SNPRINTF_LEN, "%llu %llx %llX %llo", v, v, v, v) ||
+          test_fmt(TEST_SNPRINTF_LEN, "%#llx %#llo %25llu|%-25llu|", v, v, v,
+                   v) ||
+          test_fmt(TEST_SNPRINTF_LEN, "%.22llu %lld %+lld %06lld", v, s, -s,
+                   -s) ||
+          test_fmt(TEST_SNPRINTF_LEN, "%u %hu %hhu %zu", (unsigned)v,
+                   (unsigned short)v, (unsigned char)v, (size_t)v))
+         return -1;
+
+      // output truncated at every length
+      for (size_t size = 0; size <= 22; size++)
+         if (test_fmt(size, "%llu", v))
+            return -1;
+   }
+
+   if (test_fmt(TEST_SNPRINTF_LEN, "%lld %d %ld", LLONG_MIN, INT_MIN,
+                LONG_MIN))
+      return -1;
+
+   return 0;
+}
+
+#if !NO_FLOAT && HAVE_IEEE_DOUBLE
+/**
+ * @brief Doubles in the range of the integer "%f" path are printed exactly.
+ */
+static int test_snprintf_exact(void)
+{
+   static const double vals[] = {
+       0.0,
+       0.00390625, // 2^-8, the smallest value on the exact path
+       0.1,
+       0.125,
+       0.375,
+       0.5,
+       1.0 / 3.0,
+       1.5,
+       2.5,
+       999.9999999,
+       123456.789,
+       4503599627370495.5,
+       9007199254740993.0,
+       1e19,
+       18446744073709549568.0, // largest double below 2^64
+   };
+
+   for (size_t i = 0; i < TEST_ARRAY_LEN(vals); i++) {
+      // the sign of negative zero is not kept, unlike in the C library
+      const double v   = vals[i];
+      const double neg = (v > 0.0) ? -v : v;
+      for (int prec = 0; prec <= 19; prec++)
+         if (test_fmt(TEST_SNPRINTF_LEN, "%.*f %.*f", prec, v, prec, neg))
+            return -1;
+
+      if (test_fmt(TEST_SNPRINTF_LEN, "%f|%30.3f|%-30.3f|%+f|%#.0f", v, v, v,
+                   v, v) ||
+          test_fmt(TEST_SNPRINTF_LEN, "%F %g", v, v))
+         return -1;
+   }
+
+   // ties round to an even last digit
+   if (test_fmt(TEST_SNPRINTF_LEN, "%.0f %.0f %.0f %.2f %.2f", 0.5, 1.5, 2.5,
+                0.125, 0.375))
+      return -1;
+
+   return 0;
+}
+#endif
+
+#if NO_FLOAT
+/**
+ * @brief Without floating point, the conversions skip their argument.
+ */
+static int test_snprintf_nofloat(void)
+{
+   char buf[TEST_SNPRINTF_LEN];
+   const char *const want = "1 ? ?|    ?|?  |? ? 8";
+
+   const int n = rpl_snprintf(buf, sizeof(buf), "%d %f %e|%5g|%-3G|%a %Lf %d",
+                              1, 2.0, 3.0, 4.0, 5.0, 6.0, (long double)7, 8);
+   if ((n != (int)strlen(want)) || (strcmp(buf, want) != 0)) {
+      TEST_FAIL("\"%s\" (%d), expected \"%s\"", buf, n, want);
+      return -1;
+   }
+
+   return 0;
+}
+#endif
+
+/**
+ * @brief Scaled integers are printed as fixed-point numbers.
+ */
+static int test_snprintf_fixed(void)
+{
+   static const struct {
+      long long value;
+      int decimals;
+      const char *want;
+   } cases[] = {
+       {0,         0,  "0"                    },
+       {7,         0,  "7"                    },
+       {-7,        1,  "-0.7"                 },
+       {-5,        2,  "-0.05"                },
+       {100,       2,  "1.00"                 },
+       {12345,     3,  "12.345"               },
+       {LLONG_MAX, 18, "9.223372036854775807" },
+       {LLONG_MIN, 18, "-9.223372036854775808"},
+       {LLONG_MIN, 0,  "-9223372036854775808" },
+   };
+
+   char buf[TEST_SNPRINTF_LEN];
+   for (size_t i = 0; i < TEST_ARRAY_LEN(cases); i++) {
+      const int n = rpl_fmtfixed(buf, sizeof(buf), cases[i].value,
+                                 cases[i].decimals);
+      if ((n != (int)strlen(cases[i].want)) ||
+          (strcmp(buf, cases[i].want) != 0)) {
+         TEST_FAIL("\"%s\" (%d), expected \"%s\"", buf, n, cases[i].want);
+         return -1;
+      }
+   }
+
+   // truncated like snprintf, returning the full length
+   memset(buf, 'x', sizeof(buf));
+   if ((rpl_fmtfixed(buf, 4, 12345, 3) != 6) || (strcmp(buf, "12.") != 0)) {
+      TEST_FAIL("truncated output \"%s\"", buf);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief The number of decimals is limited to what a long long can hold.
+ */
+static int test_snprintf_fixed_range(void)
+{
+   char buf[TEST_SNPRINTF_LEN];
+   if ((rpl_fmtfixed(buf, sizeof(buf), 1, -1) != -1) ||
+       (rpl_fmtfixed(buf, sizeof(buf), 1, 19) != -1)) {
+      TEST_FAIL("decimals outside 0 to 18 accepted");
+      return -1;
+   }
+
+   return 0;
+}
+
+int test_snprintf(void)
+{
+   static int (*valid_fn[])(void) = {test_snprintf_int,
+#if !NO_FLOAT && HAVE_IEEE_DOUBLE
+                                     test_snprintf_exact,
+#endif
+#if NO_FLOAT
+                                     test_snprintf_nofloat,
+#endif
+                                     test_snprintf_fixed,
+                                     NULL};
+
+   static int (*invalid_fn[])(void) = {test_snprintf_fixed_range, NULL};
+
+   if (test_runner(valid_fn, invalid_fn) != 0)
+      return -1;
+
+   TEST_SUCCESS();
+   return 0;
+}
+
+// end file test_snprintf.c
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: MIT
+/**
+ * @file test_snprintf.h
+ * @brief Tests for the replacement snprintf.c.
+ * @author Jakob Kastelic
+ * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
+ */
+
+#ifndef TEST_SNPRINTF_H
+#define TEST_SNPRINTF_H
+
+/**
+ * @brief Run the tests of snprintf.c.
+ */
+int test_snprintf(void);
+
+#endif // TEST_SNPRINTF_H
+
+// end file test_snprintf.h
@@ -9,11 +9,143 @@
 
 #include "utils/debug.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
-static bool silence_errors;
+// per-thread state
+static DEBUG_TLS bool silence_errors;
+static DEBUG_TLS struct debug_last debug_last;
 
-static void (*debug_error_cb)(const char *fn, const char *file, int line,
-                              const char *msg);
+static DEBUG_TLS void (*debug_error_cb)(const char *fn, const char *file,
+                                        int line, const char *msg);
+
+static DEBUG_TLS void (*debug_error_id_cb)(uint32_t id);
+
+#if DEBUG_RATE_LIMIT
+// rate limiting, per thread like the site counts
+static DEBUG_TLS uint16_t debug_limit;
+static DEBUG_TLS uint16_t debug_period;
+static DEBUG_TLS uint32_t debug_dropped;
+static DEBUG_TLS void (*debug_suppressed_cb)(uint32_t count);
+#endif
+
+// deferred error queue
+enum debug_kind {
+   DEBUG_MSG,
+   DEBUG_SITE_ID,
+#if DEBUG_RATE_LIMIT
+   DEBUG_SUPPRESSED,
+#endif
+};
+
+// callbacks are taken when an error is stored, as they may be per thread
+struct debug_rec {
+   const char *fn;
+   const char *file;
+   const char *msg;
+   int line;
+   uint32_t val; // site ID or suppressed count
+   enum debug_kind kind;
+   void (*error_cb)(const char *fn, const char *file, int line,
+                    const char *msg);
+   void (*val_cb)(uint32_t val); // site ID or suppressed count callback
+};
+
+#if DEBUG_QUEUE
+static volatile struct debug_rec debug_queue[DEBUG_QUEUE];
+static volatile uint32_t debug_head;
+static volatile uint32_t debug_tail;
+static volatile bool debug_storing; // a store is in progress
+#endif
+static uint32_t debug_lost;
+static void (*debug_lock_fn)(void);
+static void (*debug_unlock_fn)(void);
+
+/**
+ * @brief Pass an error to its callback.
+ */
+static void debug_deliver(const struct debug_rec *r)
+{
+   switch (r->kind) {
+      case DEBUG_MSG:
+         if (r->error_cb)
+            (*r->error_cb)(r->fn, r->file, r->line, r->msg);
+         break;
+      case DEBUG_SITE_ID:
+#if DEBUG_RATE_LIMIT
+      case DEBUG_SUPPRESSED:
+#endif
+         if (r->val_cb)
+            (*r->val_cb)(r->val);
+         break;
+   }
+}
+
+#if DEBUG_QUEUE
+/**
+ * @brief Store an error in the queue.
+ *
+ * Without the lock, a store that interrupts another one would take the same
+ * slot, so it is dropped and counted as lost instead.
+ */
+static void debug_store(const struct debug_rec *r)
+{
+   if (debug_storing) {
+      debug_lost++;
+      return;
+   }
+   debug_storing = true;
+
+   const uint32_t head = debug_head;
+   if ((head - debug_tail) >= DEBUG_QUEUE) {
+      debug_lost++;
+   } else {
+      debug_queue[head % DEBUG_QUEUE] = *r;
+      debug_head                      = head + 1;
+   }
+
+   debug_storing = false;
+}
+
+/**
+ * @brief Take the oldest error out of the queue.
+ * @return true if an error was taken, false if the queue is empty.
+ */
+static bool debug_pop(struct debug_rec *r)
+{
+   if (debug_lock_fn)
+      (*debug_lock_fn)();
+
+   const uint32_t tail = debug_tail;
+   const bool found    = (tail != debug_head);
+   if (found) {
+      *r         = debug_queue[tail % DEBUG_QUEUE];
+      debug_tail = tail + 1;
+   }
+
+   if (debug_unlock_fn)
+      (*debug_unlock_fn)();
+   return found;
+}
+#endif
+
+/**
+ * @brief Store an error in the queue, or pass it on if there is no queue.
+ */
+static void debug_push(const struct debug_rec *r)
+{
+#if DEBUG_QUEUE
+   if (debug_lock_fn)
+      (*debug_lock_fn)();
+
+   debug_store(r);
+
+   if (debug_unlock_fn)
+      (*debug_unlock_fn)();
+#else
+   debug_deliver(r);
+#endif
+}
 
 void debug_set_error_cb(void (*cb)(const char *fn, const char *file, int line,
                                    const char *msg))
@@ -21,14 +153,130 @@ void debug_set_error_cb(void (*cb)(const char *fn, const char *file, int line,
    debug_error_cb = cb;
 }
 
+void debug_set_error_id_cb(void (*cb)(uint32_t id))
+{
+   debug_error_id_cb = cb;
+}
+
 // cppcheck-suppress unusedFunction
 void debug_error(const char *fn, const char *file, int line, const char *msg)
 {
+   debug_last.fn   = fn;
+   debug_last.file = file;
+   debug_last.msg  = msg;
+   debug_last.line = line;
+   debug_last.id   = 0;
+   debug_last.count++;
+
    if (silence_errors)
       return;
 
-   if (debug_error_cb)
-      (*debug_error_cb)(fn, file, line, msg);
+   const struct debug_rec r = {
+       .fn       = fn,
+       .file     = file,
+       .msg      = msg,
+       .line     = line,
+       .kind     = DEBUG_MSG,
+       .error_cb = debug_error_cb,
+   };
+   debug_push(&r);
+}
+
+// cppcheck-suppress unusedFunction
+void debug_error_id(uint32_t id)
+{
+   debug_last.fn   = NULL;
+   debug_last.file = NULL;
+   debug_last.msg  = NULL;
+   debug_last.line = 0;
+   debug_last.id   = id;
+   debug_last.count++;
+
+   if (silence_errors)
+      return;
+
+   const struct debug_rec r = {
+       .val = id, .kind = DEBUG_SITE_ID, .val_cb = debug_error_id_cb};
+   debug_push(&r);
+}
+
+#if DEBUG_RATE_LIMIT
+bool debug_pass(struct debug_site *s)
+{
+   // silenced errors are still recorded as the most recent error
+   if (silence_errors || (debug_limit == 0))
+      return true;
+
+   if (s->period != debug_period) {
+      s->period = debug_period;
+      s->count  = 0;
+   }
+
+   if (s->count >= debug_limit) {
+      if (s->dropped < UINT16_MAX)
+         s->dropped++;
+      debug_dropped++;
+      return false;
+   }
+
+   s->count++;
+   if (s->dropped) {
+      const struct debug_rec r = {.val    = s->dropped,
+                                  .kind   = DEBUG_SUPPRESSED,
+                                  .val_cb = debug_suppressed_cb};
+      debug_push(&r);
+   }
+   s->dropped = 0;
+
+   return true;
+}
+
+void debug_set_rate_limit(uint32_t limit)
+{
+   // the site counts are 16 bits
+   debug_limit = (limit > UINT16_MAX) ? UINT16_MAX : (uint16_t)limit;
+}
+
+void debug_new_period(void)
+{
+   debug_period++;
+}
+
+void debug_set_suppressed_cb(void (*cb)(uint32_t count))
+{
+   debug_suppressed_cb = cb;
+}
+
+uint32_t debug_suppressed(void)
+{
+   return debug_dropped;
+}
+#endif
+
+uint32_t debug_flush(void)
+{
+   uint32_t num = 0;
+
+#if DEBUG_QUEUE
+   struct debug_rec r;
+   while (debug_pop(&r)) {
+      debug_deliver(&r);
+      num++;
+   }
+#endif
+
+   return num;
+}
+
+uint32_t debug_overflows(void)
+{
+   return debug_lost;
+}
+
+void debug_set_queue_lock(void (*lock_fn)(void), void (*unlock_fn)(void))
+{
+   debug_lock_fn   = lock_fn;
+   debug_unlock_fn = unlock_fn;
 }
 
 void debug_silent(bool silent)
@@ -36,4 +284,14 @@ void debug_silent(bool silent)
    silence_errors = silent;
 }
 
+const struct debug_last *debug_last_error(void)
+{
+   return &debug_last;
+}
+
+void debug_clear_error(void)
+{
+   debug_last = (struct debug_last){0};
+}
+
 // end file debug.c
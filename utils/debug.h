@@ -3,6 +3,14 @@
  * @file debug.h
  * @brief Callback-based error handling.
  *
+ * With `DEBUG_BINARY` nonzero, ERROR() does not keep any strings. It passes
+ * a numeric site ID instead, made of the `DEBUG_FILE_ID` of the source file
+ * in the upper 16 bits and the line number in the lower 16 bits. Source files
+ * define their `DEBUG_FILE_ID` before including this header, and
+ * scripts/debug_ids.py maps the IDs back to file, line, and message.
+ *
+ * ERROR() is to be followed by a semicolon.
+ *
  * @author Jakob Kastelic
  * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
  */
@@ -11,8 +19,84 @@
 #define DEBUG_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifndef DEBUG_BINARY
+#define DEBUG_BINARY 0
+#endif
+
+#ifndef DEBUG_FILE_ID
+#define DEBUG_FILE_ID 0
+#endif
+
+// storage class of the per-thread state, e.g. __thread
+#ifndef DEBUG_TLS
+#define DEBUG_TLS
+#endif
 
+// length of the deferred error queue, or 0 to call the callbacks directly
+#ifndef DEBUG_QUEUE
+#define DEBUG_QUEUE 0
+#endif
+
+// nonzero to count errors per site and rate limit the error callbacks
+#ifndef DEBUG_RATE_LIMIT
+#define DEBUG_RATE_LIMIT 0
+#endif
+
+#define DEBUG_ID(line) (((uint32_t)(DEBUG_FILE_ID) << 16U) | (uint32_t)(line))
+
+#if DEBUG_RATE_LIMIT
+/**
+ * With `DEBUG_RATE_LIMIT` nonzero, each ERROR() site counts its errors, so
+ * that a storm of errors from one site can be rate limited (see
+ * debug_set_rate_limit()). The counts saturate at 16 bits, and the period is
+ * kept as the low 16 bits of the period counter.
+ */
+
+struct debug_site {
+   uint16_t period;  // rate limiting period of the last error
+   uint16_t count;   // errors reported in that period
+   uint16_t dropped; // errors suppressed since the last one reported
+};
+
+#define DEBUG_REPORT(report)                                                   \
+   do {                                                                        \
+      static DEBUG_TLS struct debug_site debug_site_;                          \
+      if (debug_pass(&debug_site_))                                            \
+         report;                                                               \
+   } while (0)
+
+#if DEBUG_BINARY
+#define ERROR(x) DEBUG_REPORT(debug_error_id(DEBUG_ID(__LINE__)))
+#else
+#define ERROR(x) DEBUG_REPORT(debug_error(__func__, __FILE__, __LINE__, x))
+#endif
+#elif DEBUG_BINARY
+#define ERROR(x) debug_error_id(DEBUG_ID(__LINE__)) // no semicolon!
+#else
 #define ERROR(x) debug_error(__func__, __FILE__, __LINE__, x) // no semicolon!
+#endif
+
+/**
+ * The most recent error is kept in the following structure. The silence
+ * flag, the callbacks, and the most recent error are per thread if
+ * `DEBUG_TLS` is defined to a thread-local storage class; each thread then
+ * sets its own callbacks. A queued error keeps the callbacks of the thread
+ * that reported it, whichever thread flushes the queue. The rate limit, its
+ * period, the site counts, and the suppressed callback are per thread as well;
+ * the deferred error queue is shared by all threads (see
+ * debug_set_queue_lock()).
+ */
+
+struct debug_last {
+   const char *fn;   // function name, or NULL in binary mode
+   const char *file; // file name, or NULL in binary mode
+   const char *msg;  // message, or NULL in binary mode
+   int line;         // line number, or 0 in binary mode
+   uint32_t id;      // site ID in binary mode, else 0
+   uint32_t count;   // errors recorded since debug_clear_error()
+};
 
 /**
  * @brief Set error callback function.
@@ -21,6 +105,12 @@
 void debug_set_error_cb(void (*cb)(const char *fn, const char *file, int line,
                                    const char *msg));
 
+/**
+ * @brief Set error callback function for the binary mode.
+ * @param cb Error callback to use from now on.
+ */
+void debug_set_error_id_cb(void (*cb)(uint32_t id));
+
 /**
  * @brief Call the error callback function.
  * @param fn String to print (typically function name).
@@ -30,12 +120,114 @@ void debug_set_error_cb(void (*cb)(const char *fn, const char *file, int line,
  */
 void debug_error(const char *fn, const char *file, int line, const char *msg);
 
+/**
+ * @brief Call the binary mode error callback function.
+ * @param id Error site ID, as made by DEBUG_ID().
+ */
+void debug_error_id(uint32_t id);
+
+#if DEBUG_RATE_LIMIT
+/**
+ * @brief Count an error at a given site, and decide whether to report it.
+ *
+ * Called by ERROR(). If the site had errors suppressed since its last report,
+ * passes their number to the suppressed callback first.
+ *
+ * @param s Error site.
+ * @return true if the error is to be reported, false if suppressed.
+ */
+bool debug_pass(struct debug_site *s);
+
+/**
+ * @brief Report at most a given number of errors per site and period.
+ * @param limit Errors per site and period, at most 65535, or 0 to report
+ *              all errors.
+ */
+void debug_set_rate_limit(uint32_t limit);
+
+/**
+ * @brief Start a new rate limiting period.
+ *
+ * Call this periodically, e.g. once a second or once per control loop
+ * iteration, to let each site report errors again.
+ */
+void debug_new_period(void);
+
+/**
+ * @brief Set callback for the number of suppressed errors.
+ *
+ * The callback is called just before the next reported error of a site that
+ * had errors suppressed, with the number of errors suppressed at that site.
+ *
+ * @param cb Suppressed count callback to use from now on.
+ */
+void debug_set_suppressed_cb(void (*cb)(uint32_t count));
+
+/**
+ * @brief Number of errors suppressed by the rate limit so far, at all sites
+ * (of this thread, with `DEBUG_TLS`).
+ */
+uint32_t debug_suppressed(void);
+#endif
+
+/**
+ * @brief Call the callbacks for the errors in the deferred error queue.
+ *
+ * With `DEBUG_QUEUE` nonzero, errors are stored in a queue instead of being
+ * passed to the callbacks where they occur, so that slow callbacks do not
+ * delay interrupt handlers or code holding a lock. Call this function from a
+ * low-priority task to pass the stored errors on. Each error goes to the
+ * callbacks that were set when it was stored.
+ *
+ * Without a lock (see debug_set_queue_lock()), errors may be stored from the
+ * main program and from interrupt handlers preempting it on the same core, and
+ * only one task may flush. An error stored while an interrupted store is in
+ * progress is dropped and counted (see debug_overflows()).
+ *
+ * @return Number of errors passed to the callbacks.
+ */
+uint32_t debug_flush(void);
+
+/**
+ * @brief Number of errors lost because the deferred error queue was full, or
+ * was taken by an interrupted store.
+ */
+uint32_t debug_overflows(void);
+
+/**
+ * @brief Set the functions that guard the deferred error queue.
+ *
+ * Needed when errors are stored from several threads or cores, or flushed by
+ * more than one task. The lock is taken only to store an error or to take one
+ * out of the queue, never while calling the error callbacks. Typical choices
+ * are a mutex, or disabling interrupts on a single core.
+ *
+ * @param lock_fn Function to take the lock, or NULL for none.
+ * @param unlock_fn Function to release the lock, or NULL for none.
+ */
+void debug_set_queue_lock(void (*lock_fn)(void), void (*unlock_fn)(void));
+
 /**
  * @brief Suppress debugging/error messages (or not).
  * @param silent If true, suppress messages; if false, enable them.
  */
 void debug_silent(bool silent);
 
+/**
+ * @brief Most recent error of this thread.
+ *
+ * Includes errors hidden by debug_silent(), but not those dropped by the rate
+ * limit of `DEBUG_RATE_LIMIT`, which are only counted (see debug_suppressed()).
+ *
+ * @return Pointer to the most recent error, valid until the next error.
+ */
+const struct debug_last *debug_last_error(void);
+
+/**
+ * @brief Forget the most recent error of this thread.
+ */
+void debug_clear_error(void);
+
 #endif // DEBUG_H
 
 // end file debug.h
@@ -6,6 +6,9 @@
  * @copyright Copyright (c) 2025 Stanford Research Systems, Inc.
  */
 
+// error site IDs, decoded by scripts/debug_ids.py
+#define DEBUG_FILE_ID 1
+
 #include "utils/reg.h"
 #include "utils/debug.h"
 #include <limits.h>
@@ -18,6 +21,37 @@
 #define MAX_REG        WIDTH_OF(uint32_t)
 #define MAX_FIELD      WIDTH_OF(uint64_t)
 
+// specialized kernels must be inlined for the constant arguments to take effect
+#if defined(__GNUC__)
+#define REG_INLINE inline __attribute__((always_inline))
+#else
+#define REG_INLINE inline
+#endif
+
+// order trace records against the head counter, for readers on other cores
+#if defined(__GNUC__)
+#define REG_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define REG_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#else
+#define REG_RELEASE() ((void)0)
+#define REG_ACQUIRE() ((void)0)
+#endif
+
+// access statistics, if compiled in and attached to the device
+#if REG_STATS
+#define REG_COUNT(s, cnt, n)                                                   \
+   do {                                                                        \
+      if (s)                                                                   \
+         (s)->cnt += (n);                                                      \
+   } while (0)
+#else
+#define REG_COUNT(s, cnt, n) ((void)(s))
+#endif
+
+// argument checks in internal helpers, and at the public entry points
+#define REG_CHECKS_FULL  (REG_CHECK_LEVEL >= 2)
+#define REG_CHECKS_ENTRY (REG_CHECK_LEVEL >= 1)
+
 /***********************************************************
  * BASIC MATH
  ***********************************************************/
@@ -46,6 +80,20 @@ static inline size_t reg_cdiv(size_t x, size_t y)
    return (x + y - 1) / y;
 }
 
+/**
+ * @brief Bitmask of consecutive bits, without checking the arguments.
+ *
+ * @param start Starting bit position, with start + len at most 64.
+ * @param len Number of bits to set, at most 64.
+ * @return Bitmask with bits set in [start, start+len-1].
+ */
+static inline uint64_t reg_bits(const size_t start, const size_t len)
+{
+   const uint64_t mask = (len >= MAX_FIELD) ? UINT64_MAX : (1ULL << len) - 1;
+
+   return mask << start;
+}
+
 /**
  * @brief Create a bitmask of consecutive bits set within a 64-bit word.
  *
@@ -55,19 +103,18 @@ static inline size_t reg_cdiv(size_t x, size_t y)
  */
 uint64_t reg_mask64(size_t start, size_t len)
 {
-   if ((len == 0) || (len > MAX_FIELD)) {
+   if (REG_CHECKS_ENTRY && ((len == 0) || (len > MAX_FIELD))) {
       ERROR("invalid mask length");
       return 0;
    }
 
-   if ((start >= MAX_FIELD) || ((start + len) > MAX_FIELD)) {
+   if (REG_CHECKS_ENTRY &&
+       ((start >= MAX_FIELD) || ((start + len) > MAX_FIELD))) {
       ERROR("invalid mask start");
       return 0;
    }
 
-   uint64_t mask = (len == MAX_FIELD) ? UINT64_MAX : (1ULL << len) - 1;
-
-   return mask << start;
+   return reg_bits(start, len);
 }
 
 /**
@@ -83,17 +130,17 @@ uint64_t reg_mask64(size_t start, size_t len)
  */
 uint32_t reg_mask32(size_t start, size_t len)
 {
-   if ((len == 0) || (len > MAX_REG)) {
+   if (REG_CHECKS_ENTRY && ((len == 0) || (len > MAX_REG))) {
       ERROR("invalid mask len");
       return 0;
    }
 
-   if ((start >= MAX_REG) || ((start + len) > MAX_REG)) {
+   if (REG_CHECKS_ENTRY && ((start >= MAX_REG) || ((start + len) > MAX_REG))) {
       ERROR("invalid mask start");
       return 0;
    }
 
-   return (uint32_t)reg_mask64(start, len);
+   return (uint32_t)reg_bits(start, len);
 }
 
 /**
@@ -140,6 +187,95 @@ static inline bool reg_flags(const struct reg_dev *const d,
    return false;
 }
 
+/**
+ * @brief Check whether field access bypasses the data buffer.
+ *
+ * @param d Pointer to the device to check.
+ * @return True for memory-mapped REG_DIRECT devices, unless REG_NOCOMM is set.
+ */
+static inline bool reg_bypass(const struct reg_dev *const d)
+{
+   return d->mmio && reg_flags(d, NULL, REG_DIRECT) &&
+          !reg_flags(d, NULL, REG_NOCOMM);
+}
+
+/**
+ * @brief Check whether the device has a data buffer of any width.
+ *
+ * @param d Pointer to the device to check.
+ * @return True if one of the buffer pointers is set.
+ */
+static inline bool reg_has_buf(const struct reg_dev *const d)
+{
+   return d->data || d->data16 || d->data8;
+}
+
+/**
+ * @brief Get the statistics attached to a device.
+ *
+ * @param d Pointer to the device structure.
+ * @return Statistics, or NULL if none are attached.
+ */
+static inline struct reg_stats *reg_stats_of(const struct reg_dev *const d)
+{
+   return d->ext ? d->ext->stats : NULL;
+}
+
+/**
+ * @brief Get the access trace attached to a device.
+ *
+ * @param d Pointer to the device structure.
+ * @return Trace, or NULL if none is attached.
+ */
+static inline struct reg_trace *reg_trace_of(const struct reg_dev *const d)
+{
+   return d->ext ? d->ext->trace : NULL;
+}
+
+/**
+ * @brief Get the latency histogram attached to a device.
+ *
+ * @param d Pointer to the device structure.
+ * @return Histogram, or NULL if none is attached.
+ */
+static inline struct reg_hist *reg_hist_of(const struct reg_dev *const d)
+{
+   return d->ext ? d->ext->hist : NULL;
+}
+
+/**
+ * @brief Get the plain field map of a device, from the shared map if given.
+ *
+ * @param d Pointer to the device structure.
+ * @return Field map, or NULL if the device has a packed map or none.
+ */
+static inline const struct reg_field *reg_fmap(const struct reg_dev *const d)
+{
+   return d->map ? d->map->field_map : d->field_map;
+}
+
+/**
+ * @brief Get the packed field map of a device, from the shared map if given.
+ *
+ * @param d Pointer to the device structure.
+ * @return Packed map, or NULL if the device has a plain map or none.
+ */
+static inline const struct reg_packed *reg_pmap(const struct reg_dev *const d)
+{
+   return d->map ? d->map->packed : d->packed;
+}
+
+/**
+ * @brief Get the string table of a packed map, from the shared map if given.
+ *
+ * @param d Pointer to the device structure.
+ * @return String table, or NULL.
+ */
+static inline const char *reg_names(const struct reg_dev *const d)
+{
+   return d->map ? d->map->names : d->names;
+}
+
 /**
  * @brief Check that all the usual fields are filled out.
  *
@@ -152,12 +288,12 @@ static int reg_empty(const struct reg_dev *const d)
       return -1;
    }
 
-   if (!d->read_fn) {
+   if (!d->mmio && !d->read_fn) {
       ERROR("missing read_fn");
       return -1;
    }
 
-   if (!d->write_fn) {
+   if (!d->mmio && !d->write_fn) {
       ERROR("missing write_fn");
       return -1;
    }
@@ -172,409 +308,2133 @@ static int reg_empty(const struct reg_dev *const d)
       return -1;
    }
 
-   if (!d->data) {
+   if (!reg_has_buf(d) && !reg_bypass(d)) {
       ERROR("d->data is NULL");
       return -1;
    }
 
-   if (!d->field_map) {
-      ERROR("missing field map");
+   if ((d->data != NULL) + (d->data16 != NULL) + (d->data8 != NULL) > 1) {
+      ERROR("more than one data buffer given");
       return -1;
    }
 
-   return 0;
-}
-
-/***********************************************************
- * REGISTER MANIPULATION
- ***********************************************************/
-
-/**
- * @brief Lock a mutex, if a mutex is provided.
- *
- * @return 0 on success, -1 on error.
- */
-static int reg_lock(struct reg_dev *d)
-{
-   if (reg_empty(d)) {
-      ERROR("invalid device");
+   if ((d->data16 && (d->reg_width > 16)) || (d->data8 && (d->reg_width > 8))) {
+      ERROR("reg_width too large for data buffer");
       return -1;
    }
 
-   if (d->mutex && d->lock_fn && (*d->lock_fn)(d->mutex)) {
-      ERROR("lock failed");
+   if (d->map && (d->field_map || d->packed || d->names)) {
+      ERROR("field map given with a shared map");
       return -1;
    }
 
-   if (d->lock_count != 0) {
-      ERROR("mutex already locked");
+   if (d->map && !d->map->index) {
+      ERROR("map index not built");
       return -1;
    }
 
-   d->lock_count++;
-   return 0;
-}
+   if (!reg_fmap(d) && !reg_pmap(d)) {
+      ERROR("missing field map");
+      return -1;
+   }
 
-/**
- * @brief Unlock a mutex, if a mutex is provided.
- *
- * @return 0 on success, -1 on error.
- */
-static int reg_unlock(struct reg_dev *d)
-{
-   if (reg_empty(d)) {
-      ERROR("invalid device");
+   if (d->field_map && d->packed) {
+      ERROR("more than one field map given");
       return -1;
    }
 
-   if (d->mutex && d->unlock_fn && (*d->unlock_fn)(d->mutex)) {
-      ERROR("unlock failed");
+   if (d->packed && !d->names) {
+      ERROR("missing string table for packed map");
       return -1;
    }
 
-   if (d->lock_count != 1) {
-      ERROR("invalid lock count");
+   if (d->ext && d->ext->page_len && !d->ext->page_fn) {
+      ERROR("missing page_fn");
       return -1;
    }
 
-   d->lock_count--;
    return 0;
 }
 
-uint32_t reg_read(struct reg_dev *d, const size_t reg)
+/***********************************************************
+ * FIELD MAP ACCESS
+ ***********************************************************/
+
+/**
+ * @brief Check for the terminator of either kind of field map.
+ *
+ * @param d Pointer to the device structure, with a field map.
+ * @param i Field number, not past the terminator.
+ * @return True if field i terminates the map.
+ */
+static inline bool reg_field_end(const struct reg_dev *const d, const size_t i)
 {
-   if (reg_empty(d)) {
-      ERROR("invalid device");
-      return 0;
-   }
+   const struct reg_field *fm = reg_fmap(d);
+   if (fm)
+      return !fm[i].name;
 
-   if (reg >= d->reg_num) {
-      ERROR("register outside device bounds");
-      return 0;
-   }
+   return reg_pmap(d)[i].width == 0;
+}
 
-   // read register from hardware, unless REG_NOCOMM is set
-   if (!reg_flags(d, NULL, REG_NOCOMM)) {
-      uint32_t val = d->read_fn(d->arg, reg);
-      if (val & ~reg_mask32(0, d->reg_width)) {
-         ERROR("read too many bits");
-         return 0;
-      }
+/**
+ * @brief Get a field from either kind of field map.
+ *
+ * @param d Pointer to the device structure, with a field map.
+ * @param i Field number, before the terminator.
+ * @return Copy of the field, expanded from the packed form if needed.
+ */
+static inline struct reg_field reg_field_at(const struct reg_dev *const d,
+                                            const size_t i)
+{
+   const struct reg_field *fm = reg_fmap(d);
+   if (fm)
+      return fm[i];
+
+   const struct reg_packed *p = &reg_pmap(d)[i];
+   return (struct reg_field){
+       .name  = &reg_names(d)[p->name],
+       .reg   = p->reg,
+       .offs  = p->offs,
+       .width = p->width,
+       .flags = p->flags,
+   };
+}
 
-      // set buffer
-      d->data[reg] = val;
-   }
+/**
+ * @brief Get the name of a field in an indexed map.
+ *
+ * @param m Pointer to the map structure.
+ * @param i Field number, before the terminator.
+ * @return Null-terminated field name.
+ */
+static inline const char *reg_map_name(const struct reg_map *const m,
+                                       const size_t i)
+{
+   if (m->field_map)
+      return m->field_map[i].name;
 
-   const uint32_t val = d->data[reg];
+   return &m->names[m->packed[i].name];
+}
 
-   return val;
+/**
+ * @brief Find a field by name using the map index.
+ *
+ * @param m Pointer to the map structure, with the index built.
+ * @param field Null-terminated name of the field to find.
+ * @param stats Statistics to count comparisons in, or NULL.
+ * @return Field number, or -1 if not found.
+ */
+static int reg_map_find(const struct reg_map *const m, const char *const field,
+                        struct reg_stats *const stats)
+{
+   // first of any equal names, as in the linear search
+   size_t lo = 0;
+   size_t hi = m->field_num;
+   while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      REG_COUNT(stats, compares, 1);
+      if (strcmp(reg_map_name(m, m->index[mid]), field) < 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   REG_COUNT(stats, compares, 1);
+   if ((lo < m->field_num) &&
+       (strcmp(reg_map_name(m, m->index[lo]), field) == 0))
+      return (int)m->index[lo];
+
+   return -1;
 }
 
-int reg_write(struct reg_dev *d, size_t reg, const uint32_t val)
+/**
+ * @brief Find a field by name in either kind of field map.
+ *
+ * @param d Pointer to the device structure to search in.
+ * @param field Null-terminated name of the field to find.
+ * @return Field number, or -1 if not found.
+ */
+static int reg_index(const struct reg_dev *const d, const char *const field)
 {
-   if (reg_empty(d)) {
-      ERROR("invalid device");
+   if (!reg_fmap(d) && !reg_pmap(d)) {
+      ERROR("no field map");
       return -1;
    }
 
-   if (reg >= d->reg_num) {
-      ERROR("register outside device bounds");
+   if (!field) {
+      ERROR("missing field");
       return -1;
    }
 
-   if (val & ~reg_mask32(0, d->reg_width)) {
-      ERROR("value too large for register width");
-      return -1;
-   }
+   if (d->map)
+      return reg_map_find(d->map, field, reg_stats_of(d));
 
-   if (!reg_flags(d, NULL, REG_NOCOMM))
-      if (d->write_fn(d->arg, reg, val) != 0) {
-         ERROR("write_fn callback failed");
-         return -1;
+   // packed maps keep the names in the string table
+   if (d->packed) {
+      for (int i = 0; d->packed[i].width; i++) {
+         REG_COUNT(reg_stats_of(d), compares, 1);
+         if (strcmp(&d->names[d->packed[i].name], field) == 0)
+            return i;
       }
+      return -1;
+   }
 
-   d->data[reg] = val;
+   for (int i = 0; d->field_map[i].name; i++) {
+      REG_COUNT(reg_stats_of(d), compares, 1);
+      if (strcmp(d->field_map[i].name, field) == 0)
+         return i;
+   }
 
-   return 0;
+   return -1;
 }
 
-int reg_bulk(struct reg_dev *d, const uint32_t *data)
+/***********************************************************
+ * PHYSICAL AND BUFFER ACCESS
+ ***********************************************************/
+
+/**
+ * @brief Append a record to the access trace, if compiled in and attached.
+ *
+ * @param t Trace to append to, or NULL.
+ * @param dev Device identifier (`arg`).
+ * @param op One of the REG_TRACE_* operation codes.
+ * @param reg Register, page, or map number.
+ * @param val Value transferred.
+ * @param err True if the access failed.
+ */
+static inline void reg_trace_add(struct reg_trace *const t, const int dev,
+                                 const uint8_t op, const size_t reg,
+                                 const uint32_t val, const bool err)
 {
-   if (reg_empty(d)) {
-      ERROR("invalid device");
-      return -1;
-   }
+#if REG_TRACE
+   if (!t)
+      return;
+
+   struct reg_trace_rec *const r = &t->buf[t->head & (t->len - 1)];
+
+   r->time = t->clock_fn ? t->clock_fn() : 0;
+   r->reg  = (uint32_t)reg;
+   r->val  = val;
+   r->dev  = (uint16_t)dev;
+   r->op   = op;
+   r->err  = err;
+
+   // the record is complete before a reader can see the new head
+   REG_RELEASE();
+   t->head++;
+#else
+   (void)t;
+   (void)dev;
+   (void)op;
+   (void)reg;
+   (void)val;
+   (void)err;
+#endif
+}
 
-   if (d->reg_num == 0) {
-      // no-op: zero registers to copy
-      return 0;
-   }
+/**
+ * @brief Append a record of an API call to the access trace.
+ *
+ * @param d Device the call was made on, or NULL.
+ * @param op One of REG_TRACE_SET, _GET, _ADJUST, or _OBTAIN.
+ * @param id Field ID, or -1 if the field was not found.
+ * @param val Value set or returned.
+ * @param err True if the call failed.
+ */
+static inline void reg_trace_call(const struct reg_dev *const d,
+                                  const uint8_t op, const int id,
+                                  const uint64_t val, const bool err)
+{
+   struct reg_trace *const t = d ? reg_trace_of(d) : NULL;
+   if (!t)
+      return;
+
+   const size_t reg = (id < 0) ? UINT32_MAX : (size_t)id;
+   if (val >> 32U)
+      reg_trace_add(t, d->arg, REG_TRACE_HIGH, reg,
+                    (uint32_t)(val >> 32U), err);
+   reg_trace_add(t, d->arg, op, reg, (uint32_t)val, err);
+}
 
-   if (reg_lock(d)) {
-      ERROR("cannot lock the mutex");
-      return -1;
-   }
+/**
+ * @brief Find the log-linear histogram bucket of a duration.
+ *
+ * @param t Duration, in units of the histogram clock.
+ * @return Bucket index, less than REG_HIST_BUCKETS.
+ */
+static inline size_t reg_hist_bucket(const uint32_t t)
+{
+   if (t < REG_HIST_SUB)
+      return t;
 
-   if (data == NULL)
-      memset(d->data, 0, d->reg_num * sizeof(uint32_t));
-   else
-      memcpy(d->data, data, d->reg_num * sizeof(uint32_t));
+   // position of the most significant bit, then the bits below it
+   size_t e = 31;
+   while (!(t >> e))
+      e--;
 
-   if (reg_unlock(d)) {
-      ERROR("cannot unlock the mutex");
-      return -1;
-   }
+   const size_t sub = (t >> (e - REG_HIST_SUB_BITS)) & (REG_HIST_SUB - 1U);
+   return ((e - REG_HIST_SUB_BITS + 1U) << REG_HIST_SUB_BITS) + sub;
+}
 
+/**
+ * @brief Start timing a call for the latency histogram.
+ *
+ * @param d Device with the histogram, or NULL.
+ * @return Start time, or 0 if the call is not timed.
+ */
+static inline uint32_t reg_hist_start(const struct reg_dev *const d)
+{
+#if REG_HIST
+   const struct reg_hist *const h = d ? reg_hist_of(d) : NULL;
+   if (h && h->clock_fn)
+      return h->clock_fn();
+#else
+   (void)d;
+#endif
    return 0;
 }
 
-/***********************************************************
- * FIELD MANIPULATION
- ***********************************************************/
-
 /**
- * @brief Get mask of register bits occupied by field bits.
+ * @brief Count the duration of a call in the latency histogram.
  *
- * @param n Field chunk number, starting from n=0 for the first, least
- * significant, chunk (the one located in register f->reg).
- * @param f_offs Field offset.
- * @param f_width Field width.
- * @param reg_width Width of device registers.
+ * @param d Device with the histogram, or NULL.
+ * @param op One of the REG_HIST_* operation codes.
+ * @param t0 Start time from reg_hist_start().
  */
-static uint32_t reg_field_mask(const uint8_t n, const uint8_t f_offs,
-                               const uint8_t f_width, const uint8_t reg_width)
+static inline void reg_hist_add(const struct reg_dev *const d,
+                                const size_t op, const uint32_t t0)
 {
-   const size_t len0 = reg_min(f_offs + f_width, reg_width) - f_offs;
-   size_t start      = 0;
-   size_t len        = 0;
-
-   if (n == 0) {
-      start = f_offs;
-      len   = len0;
-   } else {
-      start = 0;
-      len   = f_width - len0 - ((size_t)(n - 1) * reg_width);
-      len   = reg_min(len, reg_width);
-   }
+#if REG_HIST
+   struct reg_hist *const h = d ? reg_hist_of(d) : NULL;
+   if (!h || !h->clock_fn)
+      return;
+
+   const uint32_t t  = h->clock_fn() - t0;
+   uint32_t *const c = &h->count[op][reg_hist_bucket(t)];
+
+   if (*c < UINT32_MAX)
+      (*c)++;
+
+   if (t > h->max[op])
+      h->max[op] = t;
+#else
+   (void)d;
+   (void)op;
+   (void)t0;
+#endif
+}
 
-   return reg_mask32(start, len);
+/**
+ * @brief Get the address of a memory-mapped register.
+ *
+ * @param d Pointer to a device with `mmio` set.
+ * @param reg Sequential register number.
+ * @return Pointer into the register window.
+ */
+static inline volatile uint32_t *reg_mmio(const struct reg_dev *const d,
+                                          const size_t reg)
+{
+   const size_t stride = d->mmio_stride ? d->mmio_stride : 1;
+   return d->mmio + (reg * stride);
 }
 
 /**
- * @brief Get the part of a field in a given register.
+ * @brief Select the page a register is on, unless already selected.
  *
  * @param d Pointer to the device structure.
- * @param f Field to get data of.
- * @param n Chunk number, starting from n=0 for the first, least significant,
- * chunk (the one located in f->reg).
- * @return Result, shifted to its position in the field value, or 0 on error.
- * Note that 0 is also a valid return value.
+ * @param reg Sequential register number.
+ * @param addr Output: address of the register within its page.
+ * @return 0 on success, -1 on failure.
  */
-static uint64_t reg_get_chunk(struct reg_dev *const d,
-                              const struct reg_field *const f, const uint8_t n)
+static inline int reg_page(struct reg_dev *const d, const size_t reg,
+                           size_t *const addr)
 {
-   if (reg_empty(d)) {
-      ERROR("invalid device");
+   struct reg_ext *const x = d->ext;
+   if (!x || !x->page_len) {
+      *addr = reg;
       return 0;
    }
 
-   if (!f) {
-      ERROR("null field passed");
-      return 0;
-   }
+   const size_t page = reg / x->page_len;
+   *addr             = reg % x->page_len;
 
-   if (reg_flags(d, f, REG_DESCEND) && (f->reg < n)) {
-      ERROR("descending chunk out of bounds");
+   if (x->page_ok && (x->page == page))
       return 0;
-   }
 
-   const size_t len0 = reg_min(f->offs + f->width, d->reg_width) - f->offs;
-   if ((n != 0) && (len0 + ((size_t)(n - 1) * d->reg_width) >= 64)) {
-      ERROR("too many bits to obtain");
-      return 0;
+   x->page_ok = false;
+   REG_COUNT(x->stats, page_calls, 1);
+   const int fail = x->page_fn(d->arg, page);
+   reg_trace_add(x->trace, d->arg, REG_TRACE_PAGE, page, 0, fail);
+   if (fail) {
+      ERROR("page_fn callback failed");
+      return -1;
    }
 
-   // volatile fields must be re-read from physical device
-   // (except for REG_NOCOMM fields and/or devices)
-   size_t r = (reg_flags(d, f, REG_DESCEND)) ? f->reg - n : f->reg + n;
-   if (!reg_flags(d, f, REG_NOCOMM))
-      if (reg_flags(d, f, REG_VOLATILE))
-         reg_read(d, r);
+   x->page    = page;
+   x->page_ok = true;
+   return 0;
+}
 
-   // fetch register contents
-   uint64_t chunk = 0;
-   if (reg_flags(d, f, REG_DESCEND))
-      chunk = d->data[f->reg - n];
+/**
+ * @brief Read a register from the physical device.
+ *
+ * @param d Pointer to the device structure.
+ * @param reg Sequential register number.
+ * @param val Output: value as returned by the device, or 0 on error.
+ * @return 0 on success, -1 on failure.
+ */
+static inline int reg_phy_read(struct reg_dev *const d, const size_t reg,
+                               uint32_t *const val)
+{
+   *val = 0;
+
+   size_t addr = 0;
+   if (reg_page(d, reg, &addr)) {
+      ERROR("cannot select page");
+      return -1;
+   }
+
+   REG_COUNT(reg_stats_of(d), read_calls, 1);
+   REG_COUNT(reg_stats_of(d), regs_read, 1);
+   REG_COUNT(reg_stats_of(d), bits_read, d->reg_width);
+
+   if (d->mmio)
+      *val = *reg_mmio(d, addr);
    else
-      chunk = d->data[f->reg + n];
+      *val = d->read_fn(d->arg, addr);
 
-   // mask out irrelevant fields
-   chunk &= reg_field_mask(n, f->offs, f->width, d->reg_width);
+   reg_trace_add(reg_trace_of(d), d->arg, REG_TRACE_READ, reg, *val, false);
+   return 0;
+}
 
-   // shift into position
-   if (n == 0) {
-      chunk >>= f->offs;
-   } else {
-      chunk <<= len0 + ((size_t)(n - 1) * d->reg_width);
+/**
+ * @brief Write a register to the physical device.
+ *
+ * @param d Pointer to the device structure.
+ * @param reg Sequential register number.
+ * @param val Value to write.
+ * @return 0 on success, -1 on failure.
+ */
+static inline int reg_phy_write(struct reg_dev *const d, const size_t reg,
+                                const uint32_t val)
+{
+   size_t addr = 0;
+   if (reg_page(d, reg, &addr)) {
+      ERROR("cannot select page");
+      return -1;
    }
 
-   return chunk;
+   REG_COUNT(reg_stats_of(d), write_calls, 1);
+   REG_COUNT(reg_stats_of(d), regs_written, 1);
+   REG_COUNT(reg_stats_of(d), bits_written, d->reg_width);
+
+   int fail = 0;
+   if (d->mmio)
+      *reg_mmio(d, addr) = val;
+   else
+      fail = d->write_fn(d->arg, addr, val);
+
+   reg_trace_add(reg_trace_of(d), d->arg, REG_TRACE_WRITE, reg, val, fail);
+   return fail;
 }
 
 /**
- * @brief Set the part of a field in a given register.
+ * @brief Find the data buffer slot holding a given register.
+ *
+ * For sparse devices, the slot is looked up in the sorted slot table. For all
+ * other devices, the slot number is the same as the register number.
  *
  * @param d Pointer to the device structure.
- * @param f Field to set data in.
- * @param n Chunk number, starting from n=0 for the first, least significant,
- * chunk (the one located in register f->reg).
- * @param val Value to be written to the registers.
- * @return 0 on success, -1 on failure.
+ * @param reg Sequential register number.
+ * @param slot Output: index into the data buffer.
+ * @return 0 on success, -1 if the register is not populated.
+ */
+static inline int reg_slot(const struct reg_dev *const d, const size_t reg,
+                           size_t *const slot)
+{
+   const struct reg_ext *const x = d->ext;
+   if (!x || !x->slots) {
+      *slot = reg;
+      return 0;
+   }
+
+   // binary search for the first slot not below reg
+   size_t lo = 0;
+   size_t hi = x->slot_num;
+   while (lo < hi) {
+      const size_t mid = lo + ((hi - lo) / 2);
+      if (x->slots[mid] < reg)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   if ((lo == x->slot_num) || (x->slots[lo] != reg))
+      return -1;
+
+   *slot = lo;
+   return 0;
+}
+
+/**
+ * @brief Number of registers stored in the data buffer.
+ *
+ * @param d Pointer to the device structure.
+ * @return Buffer length, in words.
+ */
+static inline size_t reg_buf_len(const struct reg_dev *const d)
+{
+   return (d->ext && d->ext->slots) ? d->ext->slot_num : d->reg_num;
+}
+
+/**
+ * @brief Width of the data buffer elements.
+ *
+ * @param d Pointer to the device structure.
+ * @return 8, 16, or 32, according to which buffer pointer is set.
+ */
+static inline size_t reg_buf_width(const struct reg_dev *const d)
+{
+   if (d->data8)
+      return 8;
+
+   if (d->data16)
+      return 16;
+
+   return 32;
+}
+
+/**
+ * @brief Load the value stored in a data buffer slot.
+ *
+ * @param d Pointer to the device structure.
+ * @param slot Index into the data buffer.
+ * @param b Buffer element width, equal to reg_buf_width(d).
+ * @return Stored value.
+ */
+static inline uint32_t reg_slot_get(const struct reg_dev *const d,
+                                    const size_t slot, const size_t b)
+{
+   switch (b) {
+      case 8: return d->data8[slot];
+      case 16: return d->data16[slot];
+      default: return d->data[slot];
+   }
+}
+
+/**
+ * @brief Store a value in a data buffer slot.
+ *
+ * @param d Pointer to the device structure.
+ * @param slot Index into the data buffer.
+ * @param val Value to store; must fit into the buffer element.
+ * @param b Buffer element width, equal to reg_buf_width(d).
+ */
+static inline void reg_slot_put(struct reg_dev *const d, const size_t slot,
+                                const uint32_t val, const size_t b)
+{
+   switch (b) {
+      case 8: d->data8[slot] = (uint8_t)val; break;
+      case 16: d->data16[slot] = (uint16_t)val; break;
+      default: d->data[slot] = val; break;
+   }
+}
+
+/**
+ * @brief Get a register value from the data buffer.
+ *
+ * For devices that bypass the buffer, the register is read from the register
+ * window instead.
+ *
+ * @param d Pointer to the device structure.
+ * @param reg Sequential register number.
+ * @param b Buffer element width, equal to reg_buf_width(d).
+ * @return Register value, or 0 on error.
+ */
+static inline uint32_t reg_buf_get(struct reg_dev *const d, const size_t reg,
+                                   const size_t b)
+{
+   if (reg_bypass(d)) {
+      uint32_t val = 0;
+      (void)reg_phy_read(d, reg, &val);
+      return val;
+   }
+
+   size_t slot = 0;
+   if (reg_slot(d, reg, &slot)) {
+      ERROR("register not populated");
+      return 0;
+   }
+
+   return reg_slot_get(d, slot, b);
+}
+
+/**
+ * @brief Store a register value in the data buffer.
+ *
+ * Devices that bypass the buffer have nothing to store; the caller is
+ * responsible for writing the value to the physical device.
+ *
+ * @param d Pointer to the device structure.
+ * @param reg Sequential register number.
+ * @param val Value to store.
+ * @param b Buffer element width, equal to reg_buf_width(d).
+ */
+static inline void reg_buf_put(struct reg_dev *const d, const size_t reg,
+                               const uint32_t val, const size_t b)
+{
+   if (reg_bypass(d))
+      return;
+
+   size_t slot = 0;
+   if (reg_slot(d, reg, &slot)) {
+      ERROR("register not populated");
+      return;
+   }
+
+   reg_slot_put(d, slot, val, b);
+}
+
+/***********************************************************
+ * REGISTER MANIPULATION
+ ***********************************************************/
+
+/**
+ * @brief Lock a mutex, if a mutex is provided.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int reg_lock(struct reg_dev *d)
+{
+   if (REG_CHECKS_ENTRY && reg_empty(d)) {
+      ERROR("invalid device");
+      return -1;
+   }
+
+   if (d->mutex && d->lock_fn && (*d->lock_fn)(d->mutex)) {
+      ERROR("lock failed");
+      REG_COUNT(reg_stats_of(d), lock_fails, 1);
+      return -1;
+   }
+
+   if (d->lock_count != 0) {
+      ERROR("mutex already locked");
+      REG_COUNT(reg_stats_of(d), lock_fails, 1);
+      return -1;
+   }
+
+   REG_COUNT(reg_stats_of(d), locks, 1);
+   d->lock_count++;
+   return 0;
+}
+
+/**
+ * @brief Unlock a mutex, if a mutex is provided.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int reg_unlock(struct reg_dev *d)
+{
+   // the device was checked when it was locked
+   if (REG_CHECKS_FULL && reg_empty(d)) {
+      ERROR("invalid device");
+      return -1;
+   }
+
+   if (d->mutex && d->unlock_fn && (*d->unlock_fn)(d->mutex)) {
+      ERROR("unlock failed");
+      return -1;
+   }
+
+   if (d->lock_count != 1) {
+      ERROR("invalid lock count");
+      return -1;
+   }
+
+   d->lock_count--;
+   return 0;
+}
+
+uint32_t reg_read(struct reg_dev *d, const size_t reg)
+{
+   if (REG_CHECKS_ENTRY && reg_empty(d)) {
+      ERROR("invalid device");
+      return 0;
+   }
+
+   if (REG_CHECKS_ENTRY && (reg >= d->reg_num)) {
+      ERROR("register outside device bounds");
+      return 0;
+   }
+
+   size_t slot = 0;
+   if (reg_slot(d, reg, &slot)) {
+      ERROR("register not populated");
+      return 0;
+   }
+
+   // read register from hardware, unless REG_NOCOMM is set
+   if (!reg_flags(d, NULL, REG_NOCOMM)) {
+      // keep the buffered value if the register cannot be read
+      uint32_t val = 0;
+      if (reg_phy_read(d, reg, &val)) {
+         ERROR("cannot read register");
+         return 0;
+      }
+
+      if (val & ~(uint32_t)reg_bits(0, d->reg_width)) {
+         ERROR("read too many bits");
+         return 0;
+      }
+
+      // set buffer
+      reg_buf_put(d, reg, val, reg_buf_width(d));
+      return val;
+   }
+
+   const uint32_t val = reg_buf_get(d, reg, reg_buf_width(d));
+
+   return val;
+}
+
+int reg_write(struct reg_dev *d, size_t reg, const uint32_t val)
+{
+   if (REG_CHECKS_ENTRY && reg_empty(d)) {
+      ERROR("invalid device");
+      return -1;
+   }
+
+   if (REG_CHECKS_ENTRY && (reg >= d->reg_num)) {
+      ERROR("register outside device bounds");
+      return -1;
+   }
+
+   size_t slot = 0;
+   if (reg_slot(d, reg, &slot)) {
+      ERROR("register not populated");
+      return -1;
+   }
+
+   if (val & ~(uint32_t)reg_bits(0, d->reg_width)) {
+      ERROR("value too large for register width");
+      return -1;
+   }
+
+   if (!reg_flags(d, NULL, REG_NOCOMM))
+      if (reg_phy_write(d, reg, val) != 0) {
+         ERROR("write_fn callback failed");
+         return -1;
+      }
+
+   reg_buf_put(d, reg, val, reg_buf_width(d));
+
+   return 0;
+}
+
+int reg_bulk(struct reg_dev *d, const uint32_t *data)
+{
+   if (reg_empty(d)) {
+      ERROR("invalid device");
+      return -1;
+   }
+
+   if (!reg_has_buf(d)) {
+      ERROR("no data buffer to import into");
+      return -1;
+   }
+
+   const size_t len = reg_buf_len(d);
+   if (len == 0) {
+      // no-op: zero registers to copy
+      return 0;
+   }
+
+   if (reg_lock(d)) {
+      ERROR("cannot lock the mutex");
+      return -1;
+   }
+
+   // narrow buffers cannot store arbitrary words
+   int fail = 0;
+   if (data && (d->data16 || d->data8)) {
+      const uint32_t max = d->data8 ? UINT8_MAX : UINT16_MAX;
+      for (size_t i = 0; i < len; i++)
+         if (data[i] > max) {
+            ERROR("value too large for data buffer");
+            fail = -1;
+            break;
+         }
+   }
+
+   if (fail) {
+      // leave the buffer as it was
+   } else if (d->data && (data == NULL)) {
+      memset(d->data, 0, len * sizeof(uint32_t));
+   } else if (d->data) {
+      memcpy(d->data, data, len * sizeof(uint32_t));
+   } else {
+      for (size_t i = 0; i < len; i++)
+         reg_slot_put(d, i, data ? data[i] : 0, reg_buf_width(d));
+   }
+
+   if (reg_unlock(d)) {
+      ERROR("cannot unlock the mutex");
+      return -1;
+   }
+
+   return fail;
+}
+
+/***********************************************************
+ * FIELD MANIPULATION
+ ***********************************************************/
+
+/**
+ * @brief Get the register holding a given chunk of a field.
+ *
+ * @param d Pointer to the device structure.
+ * @param f Field to locate.
+ * @param n Chunk number, starting from n=0 for the chunk in f->reg.
+ * @return Sequential register number.
+ */
+static inline size_t reg_chunk_reg(const struct reg_dev *const d,
+                                   const struct reg_field *const f,
+                                   const size_t n)
+{
+   return (reg_flags(d, f, REG_DESCEND)) ? f->reg - n : f->reg + n;
+}
+
+/**
+ * @brief Number of registers occupied by a field.
+ *
+ * The common register widths are handled with constant divisors, which
+ * compile to shifts rather than to (possibly software) division.
+ *
+ * @param d Pointer to the device structure.
+ * @param f Field to count the registers of.
+ * @return Number of registers.
+ */
+static inline size_t reg_field_regs(const struct reg_dev *const d,
+                                    const struct reg_field *const f)
+{
+   const size_t end = (size_t)f->offs + f->width;
+
+   switch (d->reg_width) {
+      case 8: return reg_cdiv(end, 8);
+      case 16: return reg_cdiv(end, 16);
+      case 32: return reg_cdiv(end, 32);
+      default: return reg_cdiv(end, d->reg_width);
+   }
+}
+
+/**
+ * @brief Get mask of register bits occupied by field bits.
+ *
+ * @param n Field chunk number, starting from n=0 for the first, least
+ * significant, chunk (the one located in register f->reg).
+ * @param f_offs Field offset.
+ * @param f_width Field width.
+ * @param reg_width Width of device registers.
+ */
+static uint32_t reg_field_mask(const uint8_t n, const uint8_t f_offs,
+                               const uint8_t f_width, const uint8_t reg_width)
+{
+   const size_t len0 = reg_min(f_offs + f_width, reg_width) - f_offs;
+   size_t start      = 0;
+   size_t len        = 0;
+
+   if (n == 0) {
+      start = f_offs;
+      len   = len0;
+   } else {
+      start = 0;
+      len   = f_width - len0 - ((size_t)(n - 1) * reg_width);
+      len   = reg_min(len, reg_width);
+   }
+
+   return (uint32_t)reg_bits(start, len);
+}
+
+/**
+ * @brief Get the part of a field in a given register.
+ *
+ * @param d Pointer to the device structure.
+ * @param f Field to get data of.
+ * @param n Chunk number, starting from n=0 for the first, least significant,
+ * chunk (the one located in f->reg).
+ * @return Result, shifted to its position in the field value, or 0 on error.
+ * Note that 0 is also a valid return value.
+ */
+static uint64_t reg_get_chunk(struct reg_dev *const d,
+                              const struct reg_field *const f, const uint8_t n)
+{
+   if (REG_CHECKS_FULL && reg_empty(d)) {
+      ERROR("invalid device");
+      return 0;
+   }
+
+   if (REG_CHECKS_FULL && !f) {
+      ERROR("null field passed");
+      return 0;
+   }
+
+   if (REG_CHECKS_FULL && reg_flags(d, f, REG_DESCEND) && (f->reg < n)) {
+      ERROR("descending chunk out of bounds");
+      return 0;
+   }
+
+   const size_t len0 = reg_min(f->offs + f->width, d->reg_width) - f->offs;
+   if (REG_CHECKS_FULL && (n != 0) &&
+       (len0 + ((size_t)(n - 1) * d->reg_width) >= 64)) {
+      ERROR("too many bits to obtain");
+      return 0;
+   }
+
+   // volatile fields must be re-read from physical device
+   // (except for REG_NOCOMM fields and/or devices, and those that bypass the
+   // buffer, since these read the physical device anyway)
+   const size_t r = reg_chunk_reg(d, f, n);
+   if (!reg_flags(d, f, REG_NOCOMM) && !reg_bypass(d))
+      if (reg_flags(d, f, REG_VOLATILE))
+         reg_read(d, r);
+
+   // fetch register contents
+   uint64_t chunk = reg_buf_get(d, r, reg_buf_width(d));
+
+   // mask out irrelevant fields
+   chunk &= reg_field_mask(n, f->offs, f->width, d->reg_width);
+
+   // shift into position
+   if (n == 0) {
+      chunk >>= f->offs;
+   } else {
+      chunk <<= len0 + ((size_t)(n - 1) * d->reg_width);
+   }
+
+   return chunk;
+}
+
+/**
+ * @brief Set the part of a field in a given register.
+ *
+ * @param d Pointer to the device structure.
+ * @param f Field to set data in.
+ * @param n Chunk number, starting from n=0 for the first, least significant,
+ * chunk (the one located in register f->reg).
+ * @param val Value to be written to the registers.
+ * @return 0 on success, -1 on failure.
+ */
+static int reg_set_chunk(struct reg_dev *const d,
+                         const struct reg_field *const f, const uint8_t n,
+                         uint64_t val)
+{
+   if (REG_CHECKS_FULL && reg_empty(d)) {
+      ERROR("invalid device");
+      return -1;
+   }
+
+   if (REG_CHECKS_FULL && !f) {
+      ERROR("null field passed");
+      return -1;
+   }
+
+   if (REG_CHECKS_FULL && reg_flags(d, f, REG_DESCEND) && (f->reg < n)) {
+      ERROR("descending chunk out of bounds");
+      return -1;
+   }
+
+   // shift value into position
+   if (n == 0) {
+      val <<= f->offs;
+   } else {
+      const size_t len0 = reg_min(f->offs + f->width, d->reg_width) - f->offs;
+      val >>= len0 + ((size_t)(n - 1) * d->reg_width);
+   }
+
+   // mask out irrelevant fields
+   const uint32_t mask = reg_field_mask(n, f->offs, f->width, d->reg_width);
+   val &= mask;
+
+   const size_t r = reg_chunk_reg(d, f, n);
+
+   // store register contents
+   const size_t b      = reg_buf_width(d);
+   const uint32_t reg = (reg_buf_get(d, r, b) & ~mask) | (uint32_t)val;
+   reg_buf_put(d, r, reg, b);
+
+   // write to physical device (if no REG_NOCOMM flag)
+   if (!reg_flags(d, f, REG_NOCOMM))
+      if (reg_phy_write(d, r, reg)) {
+         ERROR("error writing to device");
+         return -1;
+      }
+
+   return 0;
+}
+
+static int reg_check_field_width(const struct reg_dev *const d,
+                                 const struct reg_field *const f)
+{
+   if (f->width == 0) {
+      ERROR("zero-width field not allowed");
+      return -1;
+   }
+
+   if (f->width > MAX_FIELD) {
+      ERROR("field too wide");
+      return -1;
+   }
+
+   if (f->reg >= d->reg_num) {
+      ERROR("register outside the bounds of device");
+      return -1;
+   }
+
+   const size_t num_regs = reg_field_regs(d, f);
+
+   if (reg_flags(d, f, REG_DESCEND)) {
+      if (f->reg + 1 < num_regs) {
+         ERROR("too many descending registers");
+         return -1;
+      }
+   }
+
+   else { // ascending
+      if (f->reg + num_regs > d->reg_num) {
+         ERROR("too many ascending registers");
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Assemble a field chunk by chunk, for any register width.
+ *
+ * @param d Pointer to the device structure.
+ * @param f Field to get, already validated.
+ * @return Field value.
+ */
+static uint64_t reg_get_chunks(struct reg_dev *const d,
+                               const struct reg_field *const f)
+{
+   // assemble chunks into a single number
+   uint64_t val          = 0;
+   const size_t num_regs = reg_field_regs(d, f);
+   for (size_t n = 0; n < num_regs; n++)
+      val |= reg_get_chunk(d, f, n);
+
+   return val;
+}
+
+/**
+ * @brief Distribute a field chunk by chunk, for any register width.
+ *
+ * @param d Pointer to the device structure.
+ * @param f Field to set, already validated.
+ * @param val Value to set, already checked to fit the field.
+ * @return 0 on success, -1 on failure.
+ */
+static int reg_set_chunks(struct reg_dev *const d,
+                          const struct reg_field *const f, const uint64_t val)
+{
+   const size_t num_regs = reg_field_regs(d, f);
+   for (size_t n = 0; n < num_regs; n++) {
+      // invert order of register writes if REG_MSR_FIRST is set
+      size_t n_eff = n;
+      if (reg_flags(d, f, REG_MSR_FIRST))
+         n_eff = num_regs - n - 1;
+
+      // write to buffer
+      if (reg_set_chunk(d, f, n_eff, val)) {
+         ERROR("error writing chunk");
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Mask of the lowest bits of a register.
+ *
+ * @param len Number of bits to set, from 1 to 32.
+ * @return Bitmask with bits set in [0, len-1].
+ */
+static inline uint32_t reg_low_mask(const size_t len)
+{
+   return (len >= MAX_REG) ? UINT32_MAX : ((1U << len) - 1U);
+}
+
+/**
+ * @brief Assemble a field from registers of a given width.
+ *
+ * This does the same as reg_get_chunks(), but all at once. It is meant to be
+ * called with a constant register width `w` and buffer width `b`, so that the
+ * compiler can replace the divisions and variable shifts with constant ones,
+ * and select the buffer element type at compile time.
+ *
+ * @param d Pointer to the device structure.
+ * @param f Field to get, already validated.
+ * @param w Register width, equal to d->reg_width.
+ * @param b Buffer element width, equal to reg_buf_width(d).
+ * @return Field value.
+ */
+static REG_INLINE uint64_t reg_get_bits(struct reg_dev *const d,
+                                        const struct reg_field *const f,
+                                        const size_t w, const size_t b)
+{
+   const size_t end      = (size_t)f->offs + f->width;
+   const size_t num_regs = reg_cdiv(end, w);
+
+   // volatile fields must be re-read, as in reg_get_chunk()
+   const bool reread = reg_flags(d, f, REG_VOLATILE) &&
+                       !reg_flags(d, f, REG_NOCOMM) && !reg_bypass(d);
+
+   uint64_t val = 0;
+   size_t pos   = 0;
+   for (size_t n = 0; n < num_regs; n++) {
+      const size_t r = reg_chunk_reg(d, f, n);
+      if (reread)
+         reg_read(d, r);
+
+      // bits [lo, hi) of this register belong to the field
+      const size_t lo = (n == 0) ? f->offs : 0;
+      const size_t hi = (n == num_regs - 1) ? end - (n * w) : w;
+
+      const uint32_t chunk =
+          (reg_buf_get(d, r, b) >> lo) & reg_low_mask(hi - lo);
+      val |= (uint64_t)chunk << pos;
+      pos += hi - lo;
+   }
+
+   return val;
+}
+
+/**
+ * @brief Distribute a field into registers of a given width.
+ *
+ * This does the same as reg_set_chunks(), but is meant to be called with a
+ * constant register width `w` and buffer width `b` (see reg_get_bits()).
+ *
+ * @param d Pointer to the device structure.
+ * @param f Field to set, already validated.
+ * @param val Value to set, already checked to fit the field.
+ * @param w Register width, equal to d->reg_width.
+ * @param b Buffer element width, equal to reg_buf_width(d).
+ * @return 0 on success, -1 on failure.
+ */
+static REG_INLINE int reg_set_bits(struct reg_dev *const d,
+                                   const struct reg_field *const f,
+                                   const uint64_t val, const size_t w,
+                                   const size_t b)
+{
+   const size_t end       = (size_t)f->offs + f->width;
+   const size_t num_regs  = reg_cdiv(end, w);
+   const bool msr_first   = reg_flags(d, f, REG_MSR_FIRST);
+   const bool communicate = !reg_flags(d, f, REG_NOCOMM);
+
+   for (size_t i = 0; i < num_regs; i++) {
+      // invert order of register writes if REG_MSR_FIRST is set
+      const size_t n = msr_first ? num_regs - i - 1 : i;
+
+      // bits [lo, hi) of this register belong to the field, starting with
+      // field bit pos
+      const size_t lo  = (n == 0) ? f->offs : 0;
+      const size_t hi  = (n == num_regs - 1) ? end - (n * w) : w;
+      const size_t pos = (n == 0) ? 0 : (n * w) - f->offs;
+
+      const uint32_t mask = reg_low_mask(hi - lo) << lo;
+      const uint32_t bits = ((uint32_t)(val >> pos) << lo) & mask;
+
+      // store register contents
+      const size_t r     = reg_chunk_reg(d, f, n);
+      const uint32_t reg = (reg_buf_get(d, r, b) & ~mask) | bits;
+      reg_buf_put(d, r, reg, b);
+
+      // write to physical device (if no REG_NOCOMM flag)
+      if (communicate && reg_phy_write(d, r, reg)) {
+         ERROR("error writing to device");
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Kernels specialized for register and buffer widths.
+ */
+enum reg_kernel_type {
+   REG_KERNEL_ANY,
+   REG_KERNEL_8_8,
+   REG_KERNEL_8_32,
+   REG_KERNEL_16_16,
+   REG_KERNEL_16_32,
+   REG_KERNEL_32_32,
+};
+
+/**
+ * @brief Select the kernel for the register and buffer width of a device.
+ *
+ * @param d Pointer to the device structure.
+ * @return Kernel type, or REG_KERNEL_ANY for the chunk-by-chunk path.
+ */
+static inline enum reg_kernel_type reg_kernel(const struct reg_dev *const d)
+{
+   const size_t w = d->reg_width;
+   const size_t b = reg_buf_width(d);
+
+   if ((w == 8) && (b == 8))
+      return REG_KERNEL_8_8;
+
+   if ((w == 8) && (b == 32))
+      return REG_KERNEL_8_32;
+
+   if ((w == 16) && (b == 16))
+      return REG_KERNEL_16_16;
+
+   if ((w == 16) && (b == 32))
+      return REG_KERNEL_16_32;
+
+   if ((w == 32) && (b == 32))
+      return REG_KERNEL_32_32;
+
+   return REG_KERNEL_ANY;
+}
+
+static uint64_t reg_get_field(struct reg_dev *const d,
+                              const struct reg_field *const f)
+{
+   if (REG_CHECKS_FULL && reg_empty(d)) {
+      ERROR("invalid device");
+      return 0;
+   }
+
+   if (REG_CHECKS_FULL && !f) {
+      ERROR("invalid field");
+      return 0;
+   }
+
+   if (REG_CHECKS_ENTRY && reg_check_field_width(d, f)) {
+      ERROR("field width invalid");
+      return 0;
+   }
+
+   // common register widths, in buffers of the same width or of words:
+   // specialized kernels
+   switch (reg_kernel(d)) {
+      case REG_KERNEL_8_8: return reg_get_bits(d, f, 8, 8);
+      case REG_KERNEL_8_32: return reg_get_bits(d, f, 8, 32);
+      case REG_KERNEL_16_16: return reg_get_bits(d, f, 16, 16);
+      case REG_KERNEL_16_32: return reg_get_bits(d, f, 16, 32);
+      case REG_KERNEL_32_32: return reg_get_bits(d, f, 32, 32);
+      default: return reg_get_chunks(d, f);
+   }
+}
+
+static int reg_set_field(struct reg_dev *const d,
+                         const struct reg_field *const f, const uint64_t val)
+{
+   if (REG_CHECKS_FULL && reg_empty(d)) {
+      ERROR("invalid device");
+      return -1;
+   }
+
+   if (REG_CHECKS_FULL && !f) {
+      ERROR("invalid field");
+      return -1;
+   }
+
+   if (REG_CHECKS_ENTRY && reg_check_field_width(d, f)) {
+      ERROR("field width invalid");
+      return -1;
+   }
+
+   if (!reg_fits(val, f->width)) {
+      ERROR("value too large for field width");
+      return -1;
+   }
+
+   // common register widths: specialized kernels, as in reg_get_field()
+   int fail = 0;
+   switch (reg_kernel(d)) {
+      case REG_KERNEL_8_8: fail = reg_set_bits(d, f, val, 8, 8); break;
+      case REG_KERNEL_8_32: fail = reg_set_bits(d, f, val, 8, 32); break;
+      case REG_KERNEL_16_16: fail = reg_set_bits(d, f, val, 16, 16); break;
+      case REG_KERNEL_16_32: fail = reg_set_bits(d, f, val, 16, 32); break;
+      case REG_KERNEL_32_32: fail = reg_set_bits(d, f, val, 32, 32); break;
+      default: fail = reg_set_chunks(d, f, val); break;
+   }
+
+   if (fail) {
+      ERROR("error writing to buffer");
+      if (d->unlock_fn)
+         (*d->unlock_fn)(d->mutex);
+      return -1;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Get a field given by its number in the field map.
+ *
+ * Fields of a plain map are passed by reference; only packed fields are
+ * expanded into a temporary copy.
+ *
+ * @param d Pointer to the device structure.
+ * @param i Field number, before the terminator.
+ * @return Field value.
+ */
+static uint64_t reg_get_nth(struct reg_dev *const d, const size_t i)
+{
+   const struct reg_field *fm = reg_fmap(d);
+   if (fm)
+      return reg_get_field(d, &fm[i]);
+
+   const struct reg_field f = reg_field_at(d, i);
+   return reg_get_field(d, &f);
+}
+
+/**
+ * @brief Set a field given by its number in the field map.
+ *
+ * @param d Pointer to the device structure.
+ * @param i Field number, before the terminator.
+ * @param val Value to set.
+ * @return 0 on success, -1 on failure.
+ */
+static int reg_set_nth(struct reg_dev *const d, const size_t i,
+                       const uint64_t val)
+{
+   const struct reg_field *fm = reg_fmap(d);
+   if (fm)
+      return reg_set_field(d, &fm[i], val);
+
+   const struct reg_field f = reg_field_at(d, i);
+   return reg_set_field(d, &f, val);
+}
+
+/***********************************************************
+ * CONSISTENCY CHECKS
+ ***********************************************************/
+
+/**
+ * @brief Check that all registers of a field are populated.
+ *
+ * @param d Pointer to the device structure to query.
+ * @param f Field to check.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_check_field_slots(const struct reg_dev *const d,
+                                 const struct reg_field *const f)
+{
+   const size_t num_regs = reg_field_regs(d, f);
+   for (size_t n = 0; n < num_regs; n++) {
+      size_t slot = 0;
+      if (reg_slot(d, reg_chunk_reg(d, f, n), &slot)) {
+         ERROR("field in register not populated:");
+         ERROR(f->name);
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Check that the slot table is sorted and within device bounds.
+ *
+ * @param d Pointer to the device structure to query.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_check_slots(const struct reg_dev *const d)
+{
+   const struct reg_ext *const x = d->ext;
+   if (!x || !x->slots)
+      return 0;
+
+   for (size_t i = 0; i < x->slot_num; i++) {
+      if (x->slots[i] >= d->reg_num) {
+         ERROR("slot outside device bounds");
+         return -1;
+      }
+
+      if ((i > 0) && (x->slots[i] <= x->slots[i - 1])) {
+         ERROR("slots not sorted");
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+static int reg_check_fields(const struct reg_dev *const d, const size_t i)
+{
+   const struct reg_field fi = reg_field_at(d, i);
+
+   if (reg_check_field_width(d, &fi)) {
+      ERROR("field width invalid");
+      return -1;
+   }
+
+   if (reg_check_field_slots(d, &fi)) {
+      ERROR("field registers invalid");
+      return -1;
+   }
+
+   for (size_t j = i + 1; !reg_field_end(d, j); j++) {
+      if (fi.name[0] == '_')
+         continue;
+
+      if (strcmp(fi.name, reg_field_at(d, j).name) == 0) {
+         ERROR("detected duplicate strings");
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Check that no field is kept only in the buffer of a bypass device.
+ *
+ * A REG_NOCOMM field is never written to the device, and a device that
+ * bypasses the buffer does not store it either, so its value would be lost.
+ *
+ * @param d Pointer to the device structure, with its original flags.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_check_direct(const struct reg_dev *const d)
+{
+   if (!reg_bypass(d))
+      return 0;
+
+   for (size_t i = 0; !reg_field_end(d, i); i++)
+      if (reg_field_at(d, i).flags & REG_NOCOMM) {
+         ERROR("REG_NOCOMM field on a device that bypasses the buffer");
+         return -1;
+      }
+
+   return 0;
+}
+
+static int reg_clear_buffer(struct reg_dev *d)
+{
+   if (reg_empty(d)) {
+      ERROR("invalid device");
+      return -1;
+   }
+
+   if (!reg_has_buf(d)) {
+      ERROR("no data buffer to clear");
+      return -1;
+   }
+
+   for (size_t i = 0; i < reg_buf_len(d); i++)
+      reg_slot_put(d, i, 0, reg_buf_width(d));
+
+   return 0;
+}
+
+/**
+ * @brief Check no field overlaps with the given one.
+ *
+ * @param d Pointer to the device structure to query.
+ * @param i Field number to check, from 0 to number of fields.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_check_field_overlaps(struct reg_dev *d, const size_t i)
+{
+   // write all 1's in field i
+   const struct reg_field fi = reg_field_at(d, i);
+   const uint64_t mask       = reg_mask64(0, fi.width);
+   if (reg_set_field(d, &fi, mask)) {
+      ERROR("cannot set field i");
+      return -1;
+   }
+
+   // clear all other fields
+   for (size_t j = 0; !reg_field_end(d, j); j++) {
+      if (j != i) {
+         const struct reg_field fj = reg_field_at(d, j);
+         if (fj.name[0] == '_')
+            continue;
+
+         if (reg_set_field(d, &fj, 0)) {
+            ERROR("cannot set field j");
+            return -1;
+         }
+      }
+   }
+
+   // read back field i
+   if (reg_get_field(d, &fi) != mask) {
+      ERROR("cannot read original value; overlap likely for field");
+      ERROR(fi.name);
+      return -1;
+   }
+
+   // clear field i
+   if (reg_set_field(d, &fi, 0)) {
+      ERROR("cannot clear field i");
+      return -1;
+   }
+
+   // check all registers are now zero
+   for (size_t j = 0; !reg_field_end(d, j); j++) {
+      const struct reg_field fj = reg_field_at(d, j);
+      if (reg_get_field(d, &fj) != 0) {
+         ERROR("registers failed to clear");
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+static int reg_check_field_partial_coverage(struct reg_dev *d)
+{
+   // write all 1's in all fields
+   for (size_t i = 0; !reg_field_end(d, i); i++) {
+      const struct reg_field f = reg_field_at(d, i);
+      const uint64_t mask      = reg_mask64(0, f.width);
+      if (reg_set_field(d, &f, mask)) {
+         ERROR("cannot set field i");
+         return -1;
+      }
+   }
+
+   // read back all fields
+   for (size_t i = 0; !reg_field_end(d, i); i++) {
+      const struct reg_field f = reg_field_at(d, i);
+      const uint64_t mask      = reg_mask64(0, f.width);
+      if (reg_get_field(d, &f) != mask) {
+         ERROR("value not all ones");
+         return -1;
+      }
+   }
+
+   // check all registers are either completely full or empty
+   for (size_t i = 0; i < reg_buf_len(d); i++) {
+      const uint32_t val = reg_slot_get(d, i, reg_buf_width(d));
+      if ((val != 0) && (val != reg_mask32(0, d->reg_width))) {
+         ERROR("register partially covered by fields");
+         if (d->unlock_fn)
+            (*d->unlock_fn)(d->mutex);
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+int reg_check(struct reg_dev *const d)
+{
+   if (reg_empty(d)) {
+      ERROR("invalid device");
+      return -1;
+   }
+
+   if ((d->lock_fn && !d->unlock_fn) || (!d->lock_fn && d->unlock_fn)) {
+      ERROR("both or none of lock_fn, unlock_fn must be given");
+      return -1;
+   }
+
+   if (reg_check_direct(d)) {
+      ERROR("invalid field flags");
+      return -1;
+   }
+
+   if (reg_lock(d)) {
+      ERROR("cannot lock the mutex");
+      return -1;
+   }
+
+   // disable writing to physical device
+   const uint16_t flags = d->flags;
+   d->flags |= REG_NOCOMM;
+
+   int fail = 0;
+   if (reg_check_slots(d))
+      fail = -1;
+
+   if (!fail && reg_clear_buffer(d))
+      fail = -1;
+
+   // validate every field before the overlap checks write any of them
+   for (size_t i = 0; !reg_field_end(d, i); i++)
+      if (!fail && reg_check_fields(d, i))
+         fail = -1;
+
+   for (size_t i = 0; !reg_field_end(d, i); i++)
+      if (!fail && reg_check_field_overlaps(d, i))
+         fail = -1;
+
+   if (!fail && reg_clear_buffer(d))
+      fail = -1;
+
+   if (!fail && reg_check_field_partial_coverage(d))
+      fail = -1;
+
+   if (!fail && reg_clear_buffer(d))
+      fail = -1;
+
+   // restore original flags
+   d->flags = flags;
+
+   if (reg_unlock(d)) {
+      ERROR("cannot unlock the mutex");
+      return -1;
+   }
+
+   if (fail)
+      return -1;
+
+   return 0;
+}
+
+/***********************************************************
+ * SPARSE DEVICES
+ ***********************************************************/
+
+/**
+ * @brief Insert a register into a sorted table, unless already present.
+ *
+ * @param slots Sorted table of register numbers.
+ * @param num Pointer to number of entries in the table, updated on insert.
+ * @param len Capacity of the table.
+ * @param reg Register number to insert.
+ * @return 0 on success, -1 if the table is full.
+ */
+static int reg_slot_insert(size_t *const slots, size_t *const num,
+                           const size_t len, const size_t reg)
+{
+   size_t i = 0;
+   while ((i < *num) && (slots[i] < reg))
+      i++;
+
+   if ((i < *num) && (slots[i] == reg))
+      return 0;
+
+   if (*num >= len) {
+      ERROR("slot table too small");
+      return -1;
+   }
+
+   memmove(&slots[i + 1], &slots[i], (*num - i) * sizeof(slots[0]));
+   slots[i] = reg;
+   (*num)++;
+
+   return 0;
+}
+
+int reg_slots(struct reg_dev *const d, size_t *const slots, const size_t len)
+{
+   if (!d || (!reg_fmap(d) && !reg_pmap(d)) ||
+       (reg_pmap(d) && !reg_names(d))) {
+      ERROR("invalid device");
+      return -1;
+   }
+
+   if (!slots) {
+      ERROR("missing slot table");
+      return -1;
+   }
+
+   if (!d->ext) {
+      ERROR("missing device extension for the slot table");
+      return -1;
+   }
+
+   if ((d->reg_width == 0) || (d->reg_width > MAX_REG)) {
+      ERROR("invalid reg_width");
+      return -1;
+   }
+
+   size_t num = 0;
+   for (size_t i = 0; !reg_field_end(d, i); i++) {
+      const struct reg_field fi = reg_field_at(d, i);
+      const struct reg_field *f = &fi;
+      if (reg_check_field_width(d, f)) {
+         ERROR("field width invalid");
+         return -1;
+      }
+
+      const size_t num_regs = reg_field_regs(d, f);
+      for (size_t n = 0; n < num_regs; n++)
+         if (reg_slot_insert(slots, &num, len, reg_chunk_reg(d, f, n))) {
+            ERROR("cannot insert register:");
+            ERROR(f->name);
+            return -1;
+         }
+   }
+
+   d->ext->slots    = slots;
+   d->ext->slot_num = num;
+
+   return 0;
+}
+
+/***********************************************************
+ * FIELD MAP MANIPULATION
+ ***********************************************************/
+
+/**
+ * @brief Find a field by name.
+ *
+ * @param map Pointer to the field map to search in.
+ * @param field Null-terminated name of the field to find.
+ * @param stats Statistics to count comparisons in, or NULL.
+ * @return The requested field, or NULL on error.
+ */
+static const struct reg_field *reg_find(const struct reg_field *const map,
+                                        const char *const field,
+                                        struct reg_stats *const stats)
+{
+   if (!map) {
+      ERROR("no field map");
+      return NULL;
+   }
+
+   if (!field) {
+      ERROR("missing field");
+      return NULL;
+   }
+
+   const struct reg_field *f = NULL;
+   for (size_t i = 0; map[i].name; i++) {
+      REG_COUNT(stats, compares, 1);
+      if (strcmp(map[i].name, field) == 0) {
+         f = &map[i];
+         break;
+      }
+   }
+
+   return f;
+}
+
+uint64_t reg_get(struct reg_dev *const d, const char *const field)
+{
+   if (!field) {
+      ERROR("missing field");
+      return 0;
+   }
+
+   const uint32_t t0 = reg_hist_start(d);
+   if (reg_lock(d)) {
+      ERROR("cannot lock the mutex");
+      return 0;
+   }
+
+   const int i = reg_index(d, field);
+   int fail    = 0;
+   if (i < 0) {
+      ERROR("cannot find field");
+      fail = -1;
+   }
+
+   uint64_t val = 0;
+   if (!fail)
+      val = reg_get_nth(d, (size_t)i);
+
+   reg_trace_call(d, REG_TRACE_GET, i, val, fail);
+
+   // counted under the lock, as the histogram is shared like the device
+   reg_hist_add(d, REG_HIST_GET, t0);
+
+   if (reg_unlock(d)) {
+      ERROR("cannot unlock the mutex");
+      return 0;
+   }
+
+   return val;
+}
+
+int reg_set(struct reg_dev *const d, const char *const field,
+            const uint64_t val)
+{
+   if (!field) {
+      ERROR("missing field");
+      return -1;
+   }
+
+   const uint32_t t0 = reg_hist_start(d);
+   if (reg_lock(d)) {
+      ERROR("cannot lock the mutex");
+      return -1;
+   }
+
+   const int i = reg_index(d, field);
+   int fail    = 0;
+   if (i < 0) {
+      ERROR("cannot find field");
+      fail = -1;
+   }
+
+   if (!fail && reg_set_nth(d, (size_t)i, val)) {
+      ERROR("cannot set field");
+      fail = -1;
+   }
+
+   reg_trace_call(d, REG_TRACE_SET, i, val, fail);
+   reg_hist_add(d, REG_HIST_SET, t0);
+
+   if (reg_unlock(d)) {
+      ERROR("cannot unlock the mutex");
+      fail = -1;
+   }
+
+   return fail;
+}
+
+uint8_t reg_fwidth(const struct reg_dev *const d, const char *const field)
+{
+   if (!field) {
+      ERROR("missing field");
+      return -1;
+   }
+
+   const int i = reg_index(d, field);
+   if (i < 0) {
+      // not an error: can use this functio to check if a field is present
+      return -1;
+   }
+
+   return reg_field_at(d, (size_t)i).width;
+}
+
+/***********************************************************
+ * PACKED FIELD MAPS
+ ***********************************************************/
+
+int reg_pack(const struct reg_field *const map, struct reg_packed *const packed,
+             const size_t len, char *const names, const size_t names_len)
+{
+   if (!map || !packed || !names) {
+      ERROR("missing field map or buffer");
+      return -1;
+   }
+
+   size_t pos = 0;
+   size_t i   = 0;
+   for (; map[i].name; i++) {
+      const struct reg_field *f = &map[i];
+
+      if (i + 1 >= len) {
+         ERROR("packed map too small");
+         return -1;
+      }
+
+      // zero width terminates a packed map
+      if (f->width == 0) {
+         ERROR("zero-width field not allowed:");
+         ERROR(f->name);
+         return -1;
+      }
+
+      if (f->reg > UINT16_MAX) {
+         ERROR("register number too large for packed map:");
+         ERROR(f->name);
+         return -1;
+      }
+
+      const size_t n = strlen(f->name) + 1;
+      if ((pos > UINT16_MAX) || (pos + n > names_len)) {
+         ERROR("string table too small");
+         return -1;
+      }
+
+      memcpy(&names[pos], f->name, n);
+      packed[i] = (struct reg_packed){
+          .name  = (uint16_t)pos,
+          .reg   = (uint16_t)f->reg,
+          .offs  = f->offs,
+          .width = f->width,
+          .flags = f->flags,
+      };
+      pos += n;
+   }
+
+   if (i >= len) {
+      ERROR("packed map too small");
+      return -1;
+   }
+
+   packed[i] = (struct reg_packed){0};
+
+   return 0;
+}
+
+/***********************************************************
+ * SHARED MAP INDEX
+ ***********************************************************/
+
+/**
+ * @brief Order two fields of a map by name, then by field number.
+ *
+ * @param m Pointer to the map structure.
+ * @param a Field number of the first field.
+ * @param b Field number of the second field.
+ * @return True if field a sorts before field b.
+ */
+static bool reg_map_less(const struct reg_map *const m, const size_t a,
+                         const size_t b)
+{
+   const int c = strcmp(reg_map_name(m, a), reg_map_name(m, b));
+   return (c < 0) || ((c == 0) && (a < b));
+}
+
+/**
+ * @brief Restore the heap property below one node of the index.
+ *
+ * @param m Pointer to the map structure.
+ * @param index Index array holding the heap.
+ * @param i Node to sift down.
+ * @param num Number of nodes in the heap.
+ */
+static void reg_map_sift(const struct reg_map *const m, size_t *const index,
+                         size_t i, const size_t num)
+{
+   for (;;) {
+      size_t top     = i;
+      const size_t l = 2 * i + 1;
+      const size_t r = l + 1;
+
+      if ((l < num) && reg_map_less(m, index[top], index[l]))
+         top = l;
+      if ((r < num) && reg_map_less(m, index[top], index[r]))
+         top = r;
+      if (top == i)
+         return;
+
+      const size_t t = index[i];
+      index[i]       = index[top];
+      index[top]     = t;
+      i              = top;
+   }
+}
+
+int reg_map_init(struct reg_map *const m, size_t *const index,
+                 const size_t len)
+{
+   if (!m || (!m->field_map && !m->packed) || (m->field_map && m->packed) ||
+       (m->packed && !m->names)) {
+      ERROR("invalid field map");
+      return -1;
+   }
+
+   if (!index) {
+      ERROR("missing index");
+      return -1;
+   }
+
+   // count the fields through a device that uses the map
+   const struct reg_dev view = {.map = m};
+   size_t num                = 0;
+   for (; !reg_field_end(&view, num); num++) {
+      if (num >= len) {
+         ERROR("index too small");
+         return -1;
+      }
+      index[num] = num;
+   }
+
+   // heap sort; ties are broken by field number, so equal names keep map
+   // order and the search finds the first of them
+   for (size_t i = num / 2; i > 0; i--)
+      reg_map_sift(m, index, i - 1, num);
+
+   for (size_t n = num; n > 1; n--) {
+      const size_t t = index[0];
+      index[0]       = index[n - 1];
+      index[n - 1]   = t;
+      reg_map_sift(m, index, 0, n - 1);
+   }
+
+   m->index     = index;
+   m->field_num = num;
+
+   return 0;
+}
+
+/***********************************************************
+ * FIELD ACCESS BY ID
+ ***********************************************************/
+
+/**
+ * @brief Count the fields of the map, once.
+ *
+ * @param d Pointer to the device structure, already validated.
+ * @return Number of fields before the terminator.
+ */
+static size_t reg_field_count(struct reg_dev *const d)
+{
+   if (d->map)
+      return d->map->field_num;
+
+   // counted on first use, and again only if the map is empty
+   if (d->field_num == 0)
+      while (!reg_field_end(d, d->field_num))
+         d->field_num++;
+
+   return d->field_num;
+}
+
+/**
+ * @brief Check that a field ID is within the map.
+ *
+ * @param d Pointer to the device structure, already validated.
+ * @param id Field ID, i.e., index into the field map.
+ * @return 0 on success, -1 on error.
  */
-static int reg_set_chunk(struct reg_dev *const d,
-                         const struct reg_field *const f, const uint8_t n,
-                         uint64_t val)
+static int reg_check_id(struct reg_dev *const d, const int id)
 {
-   if (reg_empty(d)) {
-      ERROR("invalid device");
+   if (id < 0) {
+      ERROR("negative field ID");
       return -1;
    }
 
-   if (!f) {
-      ERROR("null field passed");
+   if ((size_t)id >= reg_field_count(d)) {
+      ERROR("field ID outside map");
       return -1;
    }
 
-   if (reg_flags(d, f, REG_DESCEND) && (f->reg < n)) {
-      ERROR("descending chunk out of bounds");
+   return 0;
+}
+
+int reg_id(const struct reg_dev *const d, const char *const field)
+{
+   if (!d) {
+      ERROR("null device given");
       return -1;
    }
 
-   // shift value into position
-   if (n == 0) {
-      val <<= f->offs;
-   } else {
-      const size_t len0 = reg_min(f->offs + f->width, d->reg_width) - f->offs;
-      val >>= len0 + ((size_t)(n - 1) * d->reg_width);
+   const int i = reg_index(d, field);
+   if (i < 0) {
+      ERROR("cannot find field");
+      return -1;
    }
 
-   // mask out irrelevant fields
-   const uint32_t mask = reg_field_mask(n, f->offs, f->width, d->reg_width);
-   val &= mask;
-
-   // store register contents
-   size_t r   = (reg_flags(d, f, REG_DESCEND)) ? f->reg - n : f->reg + n;
-   d->data[r] = (d->data[r] & ~mask) | val;
-
-   // write to physical device (if no REG_NOCOMM flag)
-   if (!reg_flags(d, f, REG_NOCOMM))
-      if (d->write_fn(d->arg, r, d->data[r])) {
-         ERROR("error writing to device");
-         return -1;
-      }
-
-   return 0;
+   return i;
 }
 
-static int reg_check_field_width(const struct reg_dev *const d,
-                                 const struct reg_field *const f)
+uint64_t reg_get_id(struct reg_dev *const d, const int id)
 {
-   if (f->width == 0) {
-      ERROR("zero-width field not allowed");
-      return -1;
+   if (reg_lock(d)) {
+      ERROR("cannot lock the mutex");
+      return 0;
    }
 
-   if (f->width > MAX_FIELD) {
-      ERROR("field too wide");
-      return -1;
+   uint64_t val = 0;
+   if (!REG_CHECKS_ENTRY || (reg_check_id(d, id) == 0))
+      val = reg_get_nth(d, (size_t)id);
+
+   if (reg_unlock(d)) {
+      ERROR("cannot unlock the mutex");
+      return 0;
    }
 
-   if (f->reg >= d->reg_num) {
-      ERROR("register outside the bounds of device");
+   return val;
+}
+
+int reg_set_id(struct reg_dev *const d, const int id, const uint64_t val)
+{
+   if (reg_lock(d)) {
+      ERROR("cannot lock the mutex");
       return -1;
    }
 
-   const size_t num_regs = reg_cdiv(f->offs + f->width, d->reg_width);
+   int fail = 0;
+   if (REG_CHECKS_ENTRY && reg_check_id(d, id)) {
+      ERROR("cannot find field");
+      fail = -1;
+   }
 
-   if (reg_flags(d, f, REG_DESCEND)) {
-      if (f->reg + 1 < num_regs) {
-         ERROR("too many descending registers");
-         return -1;
-      }
+   if (!fail && reg_set_nth(d, (size_t)id, val)) {
+      ERROR("cannot set field");
+      fail = -1;
    }
 
-   else { // ascending
-      if (f->reg + num_regs > d->reg_num) {
-         ERROR("too many ascending registers");
-         return -1;
-      }
+   if (reg_unlock(d)) {
+      ERROR("cannot unlock the mutex");
+      fail = -1;
    }
 
-   return 0;
+   return fail;
 }
 
-static uint64_t reg_get_field(struct reg_dev *const d,
-                              const struct reg_field *const f)
+const char *reg_field_name(const struct reg_dev *const d, const int id)
 {
    if (reg_empty(d)) {
       ERROR("invalid device");
-      return 0;
-   }
-
-   if (!f) {
-      ERROR("invalid field");
-      return 0;
+      return NULL;
    }
 
-   if (reg_check_field_width(d, f)) {
-      ERROR("field width invalid");
-      return 0;
+   if (id < 0) {
+      ERROR("negative field ID");
+      return NULL;
    }
 
-   // assemble chunks into a single number
-   uint64_t val          = 0;
-   const size_t num_regs = reg_cdiv(f->offs + f->width, d->reg_width);
-   for (size_t n = 0; n < num_regs; n++)
-      val |= reg_get_chunk(d, f, n);
+   for (size_t i = 0; !reg_field_end(d, i); i++)
+      if (i == (size_t)id)
+         return reg_field_at(d, i).name;
 
-   return val;
+   ERROR("field ID outside map");
+   return NULL;
 }
 
-static int reg_set_field(struct reg_dev *const d,
-                         const struct reg_field *const f, const uint64_t val)
+/***********************************************************
+ * DEVICE GROUPS
+ ***********************************************************/
+
+/**
+ * @brief Check that the devices in a group are alike.
+ *
+ * @param g Pointer to the group to check.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_group_check(const struct reg_group *const g)
 {
-   if (reg_empty(d)) {
-      ERROR("invalid device");
+   if (!g || !g->devs || (g->dev_num == 0)) {
+      ERROR("empty group");
       return -1;
    }
 
-   if (!f) {
-      ERROR("invalid field");
+   if (g->write_fn && !g->vals) {
+      ERROR("missing vals for group write_fn");
       return -1;
    }
 
-   if (reg_check_field_width(d, f)) {
-      ERROR("field width invalid");
-      return -1;
-   }
+   const struct reg_dev *d0 = &g->devs[0];
+   for (size_t i = 0; i < g->dev_num; i++) {
+      const struct reg_dev *d = &g->devs[i];
 
-   if (!reg_fits(val, f->width)) {
-      ERROR("value too large for field width");
-      return -1;
-   }
+      if ((d->field_map != d0->field_map) || (d->packed != d0->packed) ||
+          (d->names != d0->names) || (d->map != d0->map) ||
+          (d->reg_width != d0->reg_width) || (d->reg_num != d0->reg_num)) {
+         ERROR("group devices have different maps");
+         return -1;
+      }
 
-   const size_t num_regs = reg_cdiv(f->offs + f->width, d->reg_width);
-   for (size_t n = 0; n < num_regs; n++) {
-      // invert order of register writes if REG_MSR_FIRST is set
-      size_t n_eff = n;
-      if (reg_flags(d, f, REG_MSR_FIRST))
-         n_eff = num_regs - n - 1;
+      if (!g->write_fn)
+         continue;
 
-      // write to buffer
-      if (reg_set_chunk(d, f, n_eff, val)) {
-         ERROR("error writing to buffer");
-         if (d->unlock_fn)
-            (*d->unlock_fn)(d->mutex);
+      if (!reg_has_buf(d)) {
+         ERROR("group write_fn requires data buffers");
+         return -1;
+      }
+
+      // the frames are made from the buffers, not the register window
+      if (d->mmio && reg_flags(d, NULL, REG_DIRECT)) {
+         ERROR("group write_fn cannot bypass the data buffers");
+         return -1;
+      }
+
+      if ((d->flags & ~REG_NOCOMM) != (d0->flags & ~REG_NOCOMM)) {
+         ERROR("group devices have different flags");
          return -1;
       }
    }
@@ -582,89 +2442,107 @@ static int reg_set_field(struct reg_dev *const d,
    return 0;
 }
 
-/***********************************************************
- * CONSISTENCY CHECKS
- ***********************************************************/
-
-static int reg_check_fields(const struct reg_dev *const d, const size_t i)
+/**
+ * @brief Unlock the first few devices of a group.
+ *
+ * @param g Pointer to the group.
+ * @param num Number of devices to unlock.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_group_unlock(struct reg_group *const g, const size_t num)
 {
-   if (reg_check_field_width(d, &d->field_map[i])) {
-      ERROR("field width invalid");
-      return -1;
-   }
+   int fail = 0;
+   for (size_t i = 0; i < num; i++)
+      if (reg_unlock(&g->devs[i])) {
+         ERROR("cannot unlock the mutex");
+         fail = -1;
+      }
 
-   for (size_t j = i + 1; d->field_map[j].name; j++) {
-      if (d->field_map[i].name[0] == '_')
-         continue;
+   return fail;
+}
 
-      if (strcmp(d->field_map[i].name, d->field_map[j].name) == 0) {
-         ERROR("detected duplicate strings");
+/**
+ * @brief Lock all devices of a group, or none of them.
+ *
+ * @param g Pointer to the group.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_group_lock(struct reg_group *const g)
+{
+   for (size_t i = 0; i < g->dev_num; i++)
+      if (reg_lock(&g->devs[i])) {
+         ERROR("cannot lock the mutex");
+         reg_group_unlock(g, i);
          return -1;
       }
-   }
 
    return 0;
 }
 
-static int reg_clear_buffer(struct reg_dev *d)
+/**
+ * @brief Check whether a field is written to the devices of a group.
+ *
+ * @param g Pointer to the group.
+ * @param f Field to check.
+ * @return 1 if REG_NOCOMM is set on the field or all devices, 0 if on none,
+ * and -1 if only on some of the devices.
+ */
+static int reg_group_quiet(const struct reg_group *const g,
+                           const struct reg_field *const f)
 {
-   if (reg_empty(d)) {
-      ERROR("invalid device");
+   size_t quiet = 0;
+   for (size_t i = 0; i < g->dev_num; i++)
+      if (reg_flags(&g->devs[i], NULL, REG_NOCOMM))
+         quiet++;
+
+   if (reg_flags(NULL, f, REG_NOCOMM) || (quiet == g->dev_num))
+      return 1;
+
+   if (quiet) {
+      ERROR("REG_NOCOMM set on some devices of the group");
       return -1;
    }
 
-   for (size_t i = 0; i < d->reg_num; i++)
-      d->data[i] = 0;
-
    return 0;
 }
 
 /**
- * @brief Check no field overlaps with the given one.
+ * @brief Write the registers of a field to all devices at once.
  *
- * @param d Pointer to the device structure to query.
- * @param i Field number to check, from 0 to number of fields.
+ * @param g Pointer to the group, with a write_fn.
+ * @param f Field to write, with buffers already updated.
  * @return 0 on success, -1 on error.
  */
-static int reg_check_field_overlaps(struct reg_dev *d, const size_t i)
+static int reg_group_write(struct reg_group *const g,
+                           const struct reg_field *const f)
 {
-   // write all 1's in field i
-   const uint64_t mask = reg_mask64(0, d->field_map[i].width);
-   if (reg_set_field(d, &d->field_map[i], mask)) {
-      ERROR("cannot set field i");
-      return -1;
-   }
+   const int quiet = reg_group_quiet(g, f);
+   if (quiet)
+      return (quiet > 0) ? 0 : -1;
 
-   // clear all other fields
-   for (size_t j = 0; d->field_map[j].name; j++) {
-      if (j != i) {
-         if (d->field_map[j].name[0] == '_')
-            continue;
+   struct reg_dev *const d0 = &g->devs[0];
+   const size_t num_regs    = reg_field_regs(d0, f);
+   for (size_t n = 0; n < num_regs; n++) {
+      // same write order as for a single device
+      size_t n_eff = n;
+      if (reg_flags(d0, f, REG_MSR_FIRST))
+         n_eff = num_regs - n - 1;
 
-         if (reg_set_field(d, &d->field_map[j], 0)) {
-            ERROR("cannot set field j");
-            return -1;
-         }
+      const size_t r = reg_chunk_reg(d0, f, n_eff);
+      for (size_t i = 0; i < g->dev_num; i++) {
+         struct reg_dev *const d = &g->devs[i];
+         g->vals[i]              = reg_buf_get(d, r, reg_buf_width(d));
+         REG_COUNT(reg_stats_of(d), regs_written, 1);
+         REG_COUNT(reg_stats_of(d), bits_written, d->reg_width);
       }
-   }
-
-   // read back field i
-   if (reg_get_field(d, &d->field_map[i]) != mask) {
-      ERROR("cannot read original value; overlap likely for field");
-      ERROR(d->field_map[i].name);
-      return -1;
-   }
 
-   // clear field i
-   if (reg_set_field(d, &d->field_map[i], 0)) {
-      ERROR("cannot clear field i");
-      return -1;
-   }
+      const int fail = (*g->write_fn)(g->arg, r, g->vals);
+      for (size_t i = 0; i < g->dev_num; i++)
+         reg_trace_add(reg_trace_of(&g->devs[i]), g->devs[i].arg,
+                       REG_TRACE_GROUP, r, g->vals[i], fail);
 
-   // check all registers are now zero
-   for (size_t j = 0; d->field_map[j].name; j++) {
-      if (reg_get_field(d, &d->field_map[j]) != 0) {
-         ERROR("registers failed to clear");
+      if (fail) {
+         ERROR("error writing to group");
          return -1;
       }
    }
@@ -672,210 +2550,285 @@ static int reg_check_field_overlaps(struct reg_dev *d, const size_t i)
    return 0;
 }
 
-static int reg_check_field_partial_coverage(struct reg_dev *d)
+/**
+ * @brief Set a field in all devices of a locked group.
+ *
+ * @param g Pointer to the group.
+ * @param f Field to set.
+ * @param val Value for all devices, if vals is NULL.
+ * @param vals Array of values, one per device, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_group_set_field(struct reg_group *const g,
+                               const struct reg_field *const f,
+                               const uint64_t val, const uint64_t *const vals)
 {
-   // write all 1's in all fields
-   for (size_t i = 0; d->field_map[i].name; i++) {
-      const uint64_t mask = reg_mask64(0, d->field_map[i].width);
-      if (reg_set_field(d, &d->field_map[i], mask)) {
-         ERROR("cannot set field i");
+   for (size_t i = 0; i < g->dev_num; i++)
+      if (!reg_fits(vals ? vals[i] : val, f->width)) {
+         ERROR("value too large for field width");
          return -1;
       }
-   }
 
-   // read back all fields
-   for (size_t i = 0; d->field_map[i].name; i++) {
-      const uint64_t mask = reg_mask64(0, d->field_map[i].width);
-      if (reg_get_field(d, &d->field_map[i]) != mask) {
-         ERROR("value not all ones");
+   for (size_t i = 0; i < g->dev_num; i++) {
+      struct reg_dev *const d = &g->devs[i];
+
+      // with a group write_fn, only update the buffers here
+      const uint16_t flags = d->flags;
+      if (g->write_fn)
+         d->flags |= REG_NOCOMM;
+
+      const int fail = reg_set_field(d, f, vals ? vals[i] : val);
+      d->flags       = flags;
+
+      if (fail) {
+         ERROR("cannot set field");
          return -1;
       }
    }
 
-   // check all registers are either completely full or empty
-   for (size_t i = 0; i < d->reg_num; i++) {
-      const uint32_t val = d->data[i];
-      if ((val != 0) && (val != reg_mask32(0, d->reg_width))) {
-         ERROR("register partially covered by fields");
-         if (d->unlock_fn)
-            (*d->unlock_fn)(d->mutex);
-         return -1;
-      }
+   if (g->write_fn && reg_group_write(g, f)) {
+      ERROR("cannot write group");
+      return -1;
    }
 
    return 0;
 }
 
-int reg_check(struct reg_dev *const d)
+/**
+ * @brief Look up a field once, and set it in all devices of a group.
+ *
+ * @param g Pointer to the group.
+ * @param field Null-terminated name of the field to set.
+ * @param val Value for all devices, if vals is NULL.
+ * @param vals Array of values, one per device, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_group_apply(struct reg_group *const g, const char *const field,
+                           const uint64_t val, const uint64_t *const vals)
 {
-   if (reg_empty(d)) {
-      ERROR("invalid device");
-      return -1;
-   }
-
-   if ((d->lock_fn && !d->unlock_fn) || (!d->lock_fn && d->unlock_fn)) {
-      ERROR("both or none of lock_fn, unlock_fn must be given");
+   if (reg_group_check(g)) {
+      ERROR("invalid group");
       return -1;
    }
 
-   if (reg_lock(d)) {
-      ERROR("cannot lock the mutex");
+   if (reg_group_lock(g)) {
+      ERROR("cannot lock the group");
       return -1;
    }
 
-   // disable writing to physical device
-   const uint16_t flags = d->flags;
-   d->flags |= REG_NOCOMM;
-
-   int fail = 0;
-   if (reg_clear_buffer(d))
+   const int i = reg_index(&g->devs[0], field);
+   int fail    = 0;
+   if (i < 0) {
+      ERROR("cannot find field");
       fail = -1;
+   }
 
-   for (size_t i = 0; d->field_map[i].name; i++) {
-      if (!fail && reg_check_fields(d, i))
-         fail = -1;
-
-      if (!fail && reg_check_field_overlaps(d, i))
+   if (!fail) {
+      const struct reg_field f = reg_field_at(&g->devs[0], (size_t)i);
+      if (reg_group_set_field(g, &f, val, vals)) {
+         ERROR("cannot set field in group");
          fail = -1;
+      }
    }
 
-   if (!fail && reg_clear_buffer(d))
-      fail = -1;
-
-   if (!fail && reg_check_field_partial_coverage(d))
-      fail = -1;
-
-   if (!fail && reg_clear_buffer(d))
+   if (reg_group_unlock(g, g->dev_num)) {
+      ERROR("cannot unlock the group");
       fail = -1;
+   }
 
-   // restore original flags
-   d->flags = flags;
+   return fail;
+}
 
-   if (reg_unlock(d)) {
-      ERROR("cannot unlock the mutex");
-      return -1;
-   }
+int reg_group_set(struct reg_group *const g, const char *const field,
+                  const uint64_t val)
+{
+   return reg_group_apply(g, field, val, NULL);
+}
 
-   if (fail)
+int reg_group_set_each(struct reg_group *const g, const char *const field,
+                       const uint64_t *const vals)
+{
+   if (!vals) {
+      ERROR("missing values");
       return -1;
+   }
 
-   return 0;
+   return reg_group_apply(g, field, 0, vals);
 }
 
 /***********************************************************
- * FIELD MAP MANIPULATION
+ * DAISY CHAINS
  ***********************************************************/
 
 /**
- * @brief Find a field by name.
+ * @brief Set a field in the devices of a locked chain, register by register.
  *
- * @param map Pointer to the field map to search in.
- * @param field Null-terminated name of the field to find.
- * @return The requested field, or NULL on error.
+ * @param c Pointer to the chain.
+ * @param g Group view of the chain.
+ * @param f Field to set.
+ * @param vals Array of values, one per device, or NULL to set only one.
+ * @param pos Device to set if vals is NULL.
+ * @param val Value to set if vals is NULL.
+ * @return 0 on success, -1 on error.
  */
-static const struct reg_field *reg_find(const struct reg_field *const map,
-                                        const char *const field)
+static int reg_chain_set_field(struct reg_chain *const c,
+                               const struct reg_group *const g,
+                               const struct reg_field *const f,
+                               const uint64_t *const vals, const size_t pos,
+                               const uint64_t val)
 {
-   if (!map) {
-      ERROR("no field map");
-      return NULL;
-   }
+   for (size_t i = 0; i < c->dev_num; i++)
+      if ((vals || (i == pos)) && !reg_fits(vals ? vals[i] : val, f->width)) {
+         ERROR("value too large for field width");
+         return -1;
+      }
 
-   if (!field) {
-      ERROR("missing field");
-      return NULL;
+   if (reg_check_field_width(&c->devs[0], f)) {
+      ERROR("field width invalid");
+      return -1;
    }
 
-   const struct reg_field *f = NULL;
-   for (size_t i = 0; map[i].name; i++) {
-      if (strcmp(map[i].name, field) == 0) {
-         f = &map[i];
-         break;
-      }
-   }
+   const int quiet = reg_group_quiet(g, f);
+   if (quiet < 0)
+      return -1;
 
-   return f;
-}
+   struct reg_dev *const d0 = &c->devs[0];
+   const size_t num_regs    = reg_field_regs(d0, f);
+   for (size_t n = 0; n < num_regs; n++) {
+      // same write order as for a single device
+      size_t n_eff = n;
+      if (reg_flags(d0, f, REG_MSR_FIRST))
+         n_eff = num_regs - n - 1;
 
-uint64_t reg_get(struct reg_dev *const d, const char *const field)
-{
-   if (!field) {
-      ERROR("missing field");
-      return 0;
-   }
+      // update the buffers, replacing unchanged registers with nop
+      const size_t r = reg_chunk_reg(d0, f, n_eff);
+      bool dirty     = false;
+      for (size_t i = 0; i < c->dev_num; i++) {
+         c->vals[i] = c->nop;
+         if (!vals && (i != pos))
+            continue;
 
-   if (reg_lock(d)) {
-      ERROR("cannot lock the mutex");
-      return 0;
-   }
+         struct reg_dev *const d = &c->devs[i];
+         const uint32_t old      = reg_buf_get(d, r, reg_buf_width(d));
+         const uint16_t flags    = d->flags;
+         d->flags |= REG_NOCOMM;
+         const int fail = reg_set_chunk(d, f, (uint8_t)n_eff,
+                                        vals ? vals[i] : val);
+         d->flags       = flags;
+         if (fail) {
+            ERROR("cannot set chunk");
+            return -1;
+         }
 
-   const struct reg_field *f = reg_find(d->field_map, field);
-   int fail                  = 0;
-   if (!f) {
-      ERROR("cannot find field");
-      fail = -1;
-   }
+         const uint32_t reg = reg_buf_get(d, r, reg_buf_width(d));
+         if (reg != old) {
+            c->vals[i] = reg;
+            dirty      = true;
+            if (!quiet) {
+               REG_COUNT(reg_stats_of(d), regs_written, 1);
+               REG_COUNT(reg_stats_of(d), bits_written, d->reg_width);
+            }
+         }
+      }
 
-   uint64_t val = 0;
-   if (!fail) {
-      val = reg_get_field(d, f);
-   }
+      if (!dirty || quiet)
+         continue;
 
-   if (reg_unlock(d)) {
-      ERROR("cannot unlock the mutex");
-      return 0;
+      const int fail = (*c->write_fn)(c->arg, r, c->vals);
+      for (size_t i = 0; i < c->dev_num; i++)
+         if ((vals || (i == pos)) && (c->vals[i] != c->nop))
+            reg_trace_add(reg_trace_of(&c->devs[i]), c->devs[i].arg,
+                          REG_TRACE_GROUP, r, c->vals[i], fail);
+
+      if (fail) {
+         ERROR("error writing to chain");
+         return -1;
+      }
    }
 
-   return val;
+   return 0;
 }
 
-int reg_set(struct reg_dev *const d, const char *const field,
-            const uint64_t val)
+/**
+ * @brief Look up a field once, and set it in the devices of a chain.
+ *
+ * @param c Pointer to the chain.
+ * @param field Null-terminated name of the field to set.
+ * @param vals Array of values, one per device, or NULL to set only one.
+ * @param pos Device to set if vals is NULL.
+ * @param val Value to set if vals is NULL.
+ * @return 0 on success, -1 on error.
+ */
+static int reg_chain_apply(struct reg_chain *const c, const char *const field,
+                           const uint64_t *const vals, const size_t pos,
+                           const uint64_t val)
 {
-   if (!field) {
-      ERROR("missing field");
+   if (!c || !c->write_fn || !c->vals) {
+      ERROR("chain requires write_fn and vals");
       return -1;
    }
 
-   if (reg_lock(d)) {
-      ERROR("cannot lock the mutex");
+   struct reg_group g = {
+       .devs     = c->devs,
+       .dev_num  = c->dev_num,
+       .arg      = c->arg,
+       .write_fn = c->write_fn,
+       .vals     = c->vals,
+   };
+
+   if (reg_group_check(&g)) {
+      ERROR("invalid chain");
       return -1;
    }
 
-   const struct reg_field *f = reg_find(d->field_map, field);
-   int fail                  = 0;
-   if (!f) {
+   if (!vals && (pos >= c->dev_num)) {
+      ERROR("device not in chain");
+      return -1;
+   }
+
+   if (reg_group_lock(&g)) {
+      ERROR("cannot lock the chain");
+      return -1;
+   }
+
+   const int i = reg_index(&c->devs[0], field);
+   int fail    = 0;
+   if (i < 0) {
       ERROR("cannot find field");
       fail = -1;
    }
 
-   if (!fail && reg_set_field(d, f, val)) {
-      ERROR("cannot set field");
-      fail = -1;
+   if (!fail) {
+      const struct reg_field f = reg_field_at(&c->devs[0], (size_t)i);
+      if (reg_chain_set_field(c, &g, &f, vals, pos, val)) {
+         ERROR("cannot set field in chain");
+         fail = -1;
+      }
    }
 
-   if (reg_unlock(d)) {
-      ERROR("cannot unlock the mutex");
+   if (reg_group_unlock(&g, g.dev_num)) {
+      ERROR("cannot unlock the chain");
       fail = -1;
    }
 
    return fail;
 }
 
-uint8_t reg_fwidth(const struct reg_dev *const d, const char *const field)
+int reg_chain_set(struct reg_chain *const c, const char *const field,
+                  const uint64_t *const vals)
 {
-   if (!field) {
-      ERROR("missing field");
+   if (!vals) {
+      ERROR("missing values");
       return -1;
    }
 
-   const struct reg_field *f = reg_find(d->field_map, field);
-   if (!f) {
-      // not an error: can use this functio to check if a field is present
-      return -1;
-   }
+   return reg_chain_apply(c, field, vals, 0, 0);
+}
 
-   return f->width;
+int reg_chain_set_one(struct reg_chain *const c, const size_t pos,
+                      const char *const field, const uint64_t val)
+{
+   return reg_chain_apply(c, field, NULL, pos, val);
 }
 
 /***********************************************************
@@ -928,6 +2881,7 @@ static int reg_verify_maps(struct reg_virt *const v)
 {
    for (int i = 0; v->maps[i]; i++) {
       v->base.field_map = v->maps[i];
+      v->base.field_num = 0;
       if (reg_check(&v->base)) {
          ERROR("bad map or bad device");
          return -1;
@@ -962,7 +2916,7 @@ int reg_verify(struct reg_virt *v)
 
       const struct reg_field *f = NULL;
       for (int j = 0; v->maps[j]; j++) {
-         f = reg_find(v->maps[j], v->fields[i]);
+         f = reg_find(v->maps[j], v->fields[i], reg_stats_of(&v->base));
          if (f)
             break;
       }
@@ -976,10 +2930,31 @@ int reg_verify(struct reg_virt *v)
 
    // clear map, to be initialized on first reg_adjust
    v->base.field_map = NULL;
+   v->base.field_num = 0;
 
    return 0;
 }
 
+/**
+ * @brief Find a field of a virtual device.
+ *
+ * @param v Virtual device, already validated.
+ * @param field Name of the virtual field.
+ * @return Index of the field in `fields`, or -1 if not found.
+ */
+static int reg_virt_index(const struct reg_virt *const v,
+                          const char *const field)
+{
+   if (!field)
+      return -1;
+
+   for (int i = 0; v->fields[i]; i++)
+      if (strcmp(v->fields[i], field) == 0)
+         return i;
+
+   return -1;
+}
+
 uint64_t reg_obtain(struct reg_virt *v, const char *field)
 {
    if (reg_bad(v)) {
@@ -987,13 +2962,16 @@ uint64_t reg_obtain(struct reg_virt *v, const char *field)
       return -1;
    }
 
-   for (int i = 0; v->fields[i]; i++)
-      if (strcmp(v->fields[i], field) == 0)
-         return v->data[i];
+   const int i = reg_virt_index(v, field);
+   if (i < 0) {
+      ERROR("virtual field not found:");
+      ERROR(field);
+      reg_trace_call(&v->base, REG_TRACE_OBTAIN, i, 0, true);
+      return 0;
+   }
 
-   ERROR("virtual field not found:");
-   ERROR(field);
-   return 0;
+   reg_trace_call(&v->base, REG_TRACE_OBTAIN, i, v->data[i], false);
+   return v->data[i];
 }
 
 /**
@@ -1006,7 +2984,10 @@ uint64_t reg_obtain(struct reg_virt *v, const char *field)
 static int reg_reset(struct reg_virt *v, const struct reg_field *const except)
 {
    // clear device data
-   memset(v->base.data, 0, v->base.reg_num * sizeof(v->base.data[0]));
+   if (reg_clear_buffer(&v->base)) {
+      ERROR("cannot clear device data");
+      return -1;
+   }
 
    // re-set all fields in the currently-loaded device map
    for (int i = 0; v->base.field_map[i].name; i++) {
@@ -1022,10 +3003,17 @@ static int reg_reset(struct reg_virt *v, const struct reg_field *const except)
          continue;
 
       // skip re-setting fields that don't fit
-      uint64_t fi_val = reg_obtain(v, fi->name);
+      const int vi = reg_virt_index(v, fi->name);
+      if (vi < 0) {
+         ERROR("virtual field not found:");
+         ERROR(fi->name);
+      }
+
+      const uint64_t fi_val = (vi < 0) ? 0 : v->data[vi];
       if (!reg_fits(fi_val, fi->width))
          continue;
 
+      REG_COUNT(reg_stats_of(&v->base), resets, 1);
       if (reg_set_field(&v->base, fi, fi_val)) {
          ERROR("could not set field:");
          ERROR(fi->name);
@@ -1036,32 +3024,19 @@ static int reg_reset(struct reg_virt *v, const struct reg_field *const except)
    return 0;
 }
 
-int reg_adjust(struct reg_virt *v, const char *const field, uint64_t val)
+/**
+ * @brief Set a virtual field, loading a new map if needed; see reg_adjust().
+ *
+ * @param v Virtual device, already validated.
+ * @param field Name of the virtual field.
+ * @param i Index of the field in `fields`.
+ * @param val Value to set.
+ * @return 0 on success, -1 on failure.
+ */
+static int reg_adjust_field(struct reg_virt *v, const char *const field,
+                            const int i, const uint64_t val)
 {
-   if (reg_bad(v)) {
-      ERROR("malformed virtual device");
-      return -1;
-   }
-
-   if (!field) {
-      ERROR("no field string given");
-      return -1;
-   }
-
-   // locate virtual field
-   bool found = false;
-   for (int i = 0; v->fields[i]; i++)
-      if (strcmp(v->fields[i], field) == 0) {
-         v->data[i] = val;
-         found      = true;
-         break;
-      }
-
-   if (!found) {
-      ERROR("did not find the virtual field");
-      ERROR(field);
-      return -1;
-   }
+   v->data[i] = val;
 
    // non-physical fields: that's it, we're done!
    if (field[0] == '_')
@@ -1069,15 +3044,23 @@ int reg_adjust(struct reg_virt *v, const char *const field, uint64_t val)
 
    // install default map, if missing (the first one, id = 0)
    if (!v->base.field_map) {
-      if (v->load_fn(v->base.arg, 0)) {
+      REG_COUNT(reg_stats_of(&v->base), loads, 1);
+      const uint32_t t0 = reg_hist_start(&v->base);
+      const int fail    = v->load_fn(v->base.arg, 0);
+      reg_hist_add(&v->base, REG_HIST_LOAD, t0);
+      reg_trace_add(reg_trace_of(&v->base), v->base.arg, REG_TRACE_LOAD, 0, 0,
+                    fail);
+      if (fail) {
          ERROR("cannot load new device configuration");
          return -1;
       }
       v->base.field_map = v->maps[0];
+      v->base.field_num = 0;
    }
 
    // look in the current map
-   const struct reg_field *f = reg_find(v->base.field_map, field);
+   const struct reg_field *f =
+       reg_find(v->base.field_map, field, reg_stats_of(&v->base));
    if (f && reg_fits(val, f->width)) {
       return reg_set_field(&v->base, f, val);
    }
@@ -1085,7 +3068,7 @@ int reg_adjust(struct reg_virt *v, const char *const field, uint64_t val)
    // not found: check the other maps for match and fit
    int id = 0;
    for (id = 0; v->maps[id]; id++) {
-      f = reg_find(v->maps[id], field);
+      f = reg_find(v->maps[id], field, reg_stats_of(&v->base));
       if (f && reg_fits(val, f->width))
          break;
       f = NULL; // if found but doesn't fit
@@ -1098,7 +3081,13 @@ int reg_adjust(struct reg_virt *v, const char *const field, uint64_t val)
    }
 
    // load a new configuration
-   if (v->load_fn(v->base.arg, id)) {
+   REG_COUNT(reg_stats_of(&v->base), loads, 1);
+   const uint32_t t0 = reg_hist_start(&v->base);
+   const int fail    = v->load_fn(v->base.arg, id);
+   reg_hist_add(&v->base, REG_HIST_LOAD, t0);
+   reg_trace_add(reg_trace_of(&v->base), v->base.arg, REG_TRACE_LOAD,
+                 (size_t)id, 0, fail);
+   if (fail) {
       ERROR("cannot load new device configuration");
       return -1;
    }
@@ -1106,6 +3095,7 @@ int reg_adjust(struct reg_virt *v, const char *const field, uint64_t val)
    // record the new map, if found
    if (v->maps[id]) {
       v->base.field_map = v->maps[id];
+      v->base.field_num = 0;
    } else {
       ERROR("new map is NULL");
       return -1;
@@ -1119,4 +3109,197 @@ int reg_adjust(struct reg_virt *v, const char *const field, uint64_t val)
    return 0;
 }
 
+int reg_adjust(struct reg_virt *v, const char *const field, uint64_t val)
+{
+   if (reg_bad(v)) {
+      ERROR("malformed virtual device");
+      return -1;
+   }
+
+   if (!field) {
+      ERROR("no field string given");
+      return -1;
+   }
+
+   const int i = reg_virt_index(v, field);
+   if (i < 0) {
+      ERROR("did not find the virtual field");
+      ERROR(field);
+      reg_trace_call(&v->base, REG_TRACE_ADJUST, i, val, true);
+      return -1;
+   }
+
+   const uint32_t t0 = reg_hist_start(&v->base);
+   const int fail    = reg_adjust_field(v, field, i, val);
+   reg_hist_add(&v->base, REG_HIST_ADJUST, t0);
+   reg_trace_call(&v->base, REG_TRACE_ADJUST, i, val, fail);
+   return fail;
+}
+
+/***********************************************************
+ * ACCESS STATISTICS
+ ***********************************************************/
+
+int reg_stats_get(const struct reg_dev *const d, struct reg_stats *const out)
+{
+   if (!d || !reg_stats_of(d) || !out) {
+      ERROR("missing device or statistics");
+      return -1;
+   }
+
+   *out = *reg_stats_of(d);
+   return 0;
+}
+
+int reg_stats_reset(struct reg_dev *const d)
+{
+   struct reg_stats *const stats = d ? reg_stats_of(d) : NULL;
+   if (!stats) {
+      ERROR("missing device or statistics");
+      return -1;
+   }
+
+   memset(stats, 0, sizeof(*stats));
+   return 0;
+}
+
+/***********************************************************
+ * ACCESS TRACE
+ ***********************************************************/
+
+int reg_trace_init(struct reg_trace *const t, struct reg_trace_rec *const buf,
+                   const size_t len, uint32_t (*const clock_fn)(void))
+{
+   if (!t || !buf) {
+      ERROR("missing trace or buffer");
+      return -1;
+   }
+
+   if ((len == 0) || (len & (len - 1))) {
+      ERROR("trace length must be a power of two");
+      return -1;
+   }
+
+   t->buf      = buf;
+   t->len      = len;
+   t->head     = 0;
+   t->clock_fn = clock_fn;
+
+   return 0;
+}
+
+size_t reg_trace_dump(const struct reg_trace *const t,
+                      struct reg_trace_rec *const out, const size_t len)
+{
+   if (!t || !t->buf || !out) {
+      ERROR("missing trace or buffer");
+      return 0;
+   }
+
+   // the most recent records still in the ring, oldest first
+   const size_t head = t->head;
+   REG_ACQUIRE();
+   const size_t num = reg_min(reg_min(head, t->len), len);
+   for (size_t i = 0; i < num; i++)
+      out[i] = t->buf[(head - num + i) & (t->len - 1)];
+
+   return num;
+}
+
+/***********************************************************
+ * LATENCY HISTOGRAMS
+ ***********************************************************/
+
+void reg_hist_reset(struct reg_hist *const h)
+{
+   if (!h) {
+      ERROR("missing histogram");
+      return;
+   }
+
+   memset(h->count, 0, sizeof(h->count));
+   memset(h->max, 0, sizeof(h->max));
+}
+
+/**
+ * @brief Find the range of durations counted in a histogram bucket.
+ *
+ * @param b Bucket index, less than REG_HIST_BUCKETS.
+ * @param lo Output: shortest duration in the bucket.
+ * @param hi Output: longest duration in the bucket.
+ */
+static void reg_hist_range(const size_t b, uint32_t *const lo,
+                           uint32_t *const hi)
+{
+   if (b < REG_HIST_SUB) {
+      *lo = (uint32_t)b;
+      *hi = (uint32_t)b;
+      return;
+   }
+
+   // inverse of reg_hist_bucket()
+   const size_t shift = (b >> REG_HIST_SUB_BITS) - 1U;
+   const size_t sub   = b & (REG_HIST_SUB - 1U);
+
+   *lo = (uint32_t)((REG_HIST_SUB + sub) << shift);
+   *hi = *lo + (uint32_t)((1UL << shift) - 1U);
+}
+
+int reg_hist_export(const struct reg_hist *const h, const size_t op,
+                    int (*fn)(void *ctx, uint32_t lo, uint32_t hi,
+                              uint32_t count),
+                    void *const ctx)
+{
+   if (!h || !fn || (op >= REG_HIST_OPS)) {
+      ERROR("invalid histogram export");
+      return -1;
+   }
+
+   for (size_t b = 0; b < REG_HIST_BUCKETS; b++) {
+      if (!h->count[op][b])
+         continue;
+
+      uint32_t lo = 0;
+      uint32_t hi = 0;
+      reg_hist_range(b, &lo, &hi);
+      if (fn(ctx, lo, hi, h->count[op][b])) {
+         ERROR("histogram export stopped");
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+uint32_t reg_hist_quantile(const struct reg_hist *const h, const size_t op,
+                           const uint32_t ppm)
+{
+   if (!h || (op >= REG_HIST_OPS) || (ppm > 1000000U)) {
+      ERROR("invalid histogram quantile");
+      return 0;
+   }
+
+   uint64_t total = 0;
+   for (size_t b = 0; b < REG_HIST_BUCKETS; b++)
+      total += h->count[op][b];
+
+   if (!total)
+      return 0;
+
+   // smallest bucket with at least the given fraction of calls at or below
+   const uint64_t rank = ((total * ppm) + 999999U) / 1000000U;
+   uint64_t seen       = 0;
+   for (size_t b = 0; b < REG_HIST_BUCKETS; b++) {
+      seen += h->count[op][b];
+      if (seen && (seen >= rank)) {
+         uint32_t lo = 0;
+         uint32_t hi = 0;
+         reg_hist_range(b, &lo, &hi);
+         return (uint32_t)reg_min(hi, h->max[op]);
+      }
+   }
+
+   return h->max[op];
+}
+
 // end file reg.c
@@ -64,6 +64,7 @@
 #ifndef REG_H
 #define REG_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -79,6 +80,70 @@
 #define REG_DESCEND   (1U << 5U)
 #define REG_MSR_FIRST (1U << 6U)
 #define REG_NORESET   (1U << 7U)
+#define REG_DIRECT    (1U << 8U)
+
+/**
+ * Access statistics are only compiled in if `REG_STATS` is nonzero:
+ */
+
+#ifndef REG_STATS
+#define REG_STATS 0
+#endif
+
+/**
+ * Likewise, the access trace is only compiled in if `REG_TRACE` is nonzero.
+ * The trace records carry one of the following operation codes:
+ */
+
+#ifndef REG_TRACE
+#define REG_TRACE 0
+#endif
+
+#define REG_TRACE_READ  1U
+#define REG_TRACE_WRITE 2U
+#define REG_TRACE_PAGE  3U
+#define REG_TRACE_LOAD  4U
+#define REG_TRACE_GROUP 5U
+
+#define REG_TRACE_SET    6U
+#define REG_TRACE_GET    7U
+#define REG_TRACE_ADJUST 8U
+#define REG_TRACE_OBTAIN 9U
+#define REG_TRACE_HIGH   10U
+
+/**
+ * Latency histograms are only compiled in if `REG_HIST` is nonzero. Each
+ * histogram has one row of buckets for each of the following operations:
+ */
+
+#ifndef REG_HIST
+#define REG_HIST 0
+#endif
+
+#define REG_HIST_GET    0U
+#define REG_HIST_SET    1U
+#define REG_HIST_ADJUST 2U
+#define REG_HIST_LOAD   3U
+#define REG_HIST_OPS    4U
+
+#define REG_HIST_SUB_BITS 2U
+#define REG_HIST_SUB      (1U << REG_HIST_SUB_BITS)
+#define REG_HIST_BUCKETS  ((33U - REG_HIST_SUB_BITS) << REG_HIST_SUB_BITS)
+
+/**
+ * Argument validation is selected with `REG_CHECK_LEVEL`. At level 2, the
+ * default, every layer of the library checks its inputs. At level 1, only
+ * the public entry points check their arguments, and the internal helpers
+ * trust them. At level 0, even the entry points skip the checks of devices,
+ * field widths, and register numbers; this is only safe once the register
+ * maps have passed reg_check() in a build with checks enabled. Callback
+ * failures, missing fields, and values too wide for their field are
+ * reported at every level.
+ */
+
+#ifndef REG_CHECK_LEVEL
+#define REG_CHECK_LEVEL 2
+#endif
 
 /**
  * Each field in a register map is of the following type:
@@ -92,6 +157,105 @@ struct reg_field {
    const uint16_t flags;
 };
 
+/**
+ * Alternatively, fields may be given in the packed form described in the
+ * section on packed field maps:
+ */
+
+struct reg_packed {
+   uint16_t name; // offset into the string table
+   uint16_t reg;
+   uint8_t offs;
+   uint8_t width;
+   uint16_t flags;
+};
+
+/**
+ * A field map shared between several devices can be indexed once for all of
+ * them, as described in the section on shared map indices:
+ */
+
+struct reg_map {
+   const struct reg_field *field_map;
+   const struct reg_packed *packed;
+   const char *names;
+   const size_t *index;
+   size_t field_num;
+};
+
+/**
+ * Counters of device accesses, described in the section on statistics:
+ */
+
+struct reg_stats {
+   uint32_t read_calls;
+   uint32_t write_calls;
+   uint32_t page_calls;
+   uint32_t regs_read;
+   uint32_t regs_written;
+   uint64_t bits_read;
+   uint64_t bits_written;
+   uint32_t compares;
+   uint32_t locks;
+   uint32_t lock_fails;
+   uint32_t loads;
+   uint32_t resets;
+};
+
+/**
+ * Trace records and the trace ring buffer, described in the section on the
+ * access trace:
+ */
+
+struct reg_trace_rec {
+   uint32_t time;
+   uint32_t reg;
+   uint32_t val;
+   uint16_t dev;
+   uint8_t op;
+   uint8_t err;
+};
+
+struct reg_trace {
+   struct reg_trace_rec *buf;
+   size_t len;
+   volatile size_t head;
+   uint32_t (*clock_fn)(void);
+};
+
+/**
+ * Latency histogram, described in the section on latency histograms:
+ */
+
+struct reg_hist {
+   uint32_t (*clock_fn)(void);
+   uint32_t count[REG_HIST_OPS][REG_HIST_BUCKETS];
+   uint32_t max[REG_HIST_OPS];
+};
+
+/**
+ * Optional features of a device are attached through a pointer to an
+ * extension, so that devices without them stay small. Each feature is
+ * described in its own section:
+ */
+
+struct reg_ext {
+   // paged access
+   size_t page_len;
+   int (*page_fn)(int arg, size_t page);
+   size_t page;
+   bool page_ok;
+
+   // sparse register space
+   const size_t *slots;
+   size_t slot_num;
+
+   // statistics and tracing
+   struct reg_stats *stats;
+   struct reg_trace *trace;
+   struct reg_hist *hist;
+};
+
 /**
  * A physical device is represented as `struct reg_dev`:
  */
@@ -103,18 +267,56 @@ struct reg_dev {
    uint8_t reg_width;
    size_t reg_num;
    const struct reg_field *field_map;
+   const struct reg_packed *packed;
+   const char *names;
+   const struct reg_map *map;
+   size_t field_num;
 
    // physical read/write
    int arg;
    uint32_t (*read_fn)(int arg, size_t reg);
    int (*write_fn)(int arg, size_t reg, uint32_t val);
 
+   // memory-mapped I/O
+   volatile uint32_t *mmio;
+   size_t mmio_stride;
+
    // data buffer
    uint32_t *data;
+   uint16_t *data16;
+   uint8_t *data8;
    void *mutex;
    int (*lock_fn)(void *mutex);
    int (*unlock_fn)(void *mutex);
    int lock_count;
+
+   // optional features, or NULL
+   struct reg_ext *ext;
+};
+
+/**
+ * Several identical devices can be updated together as a group:
+ */
+
+struct reg_group {
+   struct reg_dev *devs;
+   size_t dev_num;
+   int arg;
+   int (*write_fn)(int arg, size_t reg, const uint32_t *vals);
+   uint32_t *vals;
+};
+
+/**
+ * Identical devices daisy-chained on one bus are updated as a chain:
+ */
+
+struct reg_chain {
+   struct reg_dev *devs;
+   size_t dev_num;
+   int arg;
+   int (*write_fn)(int arg, size_t reg, const uint32_t *vals);
+   uint32_t *vals;
+   uint32_t nop;
 };
 
 /**
@@ -200,8 +402,9 @@ int reg_write(struct reg_dev *d, size_t reg, uint32_t val);
 /// @func Bulk import of register data into the device data structure.
 int reg_bulk(struct reg_dev *d, const uint32_t *data);
 /// @param `d` Device data structure.
-/// @param `data` Data to read from, at least `d->reg_num` words (32 bits each).
-/// If pointer is `NULL`, all the data will be cleared to 0.
+/// @param `data` Data to read from, at least `d->reg_num` words (32 bits each),
+/// or `d->ext->slot_num` words for sparse devices. If pointer is `NULL`, all
+/// the data will be cleared to 0.
 /// @return 0 on success, $-1$ on error.
 /// @endfunc
 
@@ -214,15 +417,20 @@ int reg_bulk(struct reg_dev *d, const uint32_t *data);
  * @subsection Device Data Structure
  *
  * A device is configured by filling the members of `struct reg_dev`. All
- * members must be set to appropriate values.
+ * members must be set to appropriate values. Paging, sparse register spaces,
+ * statistics, tracing, and histograms are configured in a `struct reg_ext`
+ * pointed to by `ext`, which may be `NULL` if none of them are used. Devices
+ * must not share an extension while paging is in use, since it caches the
+ * selected page.
  *
  * @subsubsection Data Buffer
  *
  * The register data is stored in an internal data buffer as per the `data`
  * pointer in `struct reg_dev`. The buffer must be a contiguous array of
- * `uint32_t` values, in length at least `reg_num`. The code cannot detect a
- * mismatch between the size of the allocated buffer and `reg_num` and will
- * cause a buffer overrun if the buffer is too small for the given `reg_num`.
+ * `uint32_t` values (or narrower, see below), in length at least `reg_num` (or
+ * `slot_num` for sparse devices). The code cannot detect a mismatch between
+ * the size of the allocated buffer and `reg_num` and will cause a buffer
+ * overrun if the buffer is too small for the given `reg_num`.
  *
  * In a multi-threaded program, some form of synchronization will be required to
  * prevent interleaved write calls from corrupting the data buffer. To this end,
@@ -246,6 +454,83 @@ int reg_bulk(struct reg_dev *d, const uint32_t *data);
  * not the functions are defined.
  */
 
+/**
+ * @subsubsection Narrow Registers
+ *
+ * Devices with registers of at most 16 or 8 bits need not spend a full 32-bit
+ * word to store each register. Instead of `data`, such devices may provide a
+ * buffer of smaller elements through one of the following members of
+ * `struct reg_dev`:
+ *
+ *     uint16_t *data16; // for reg_width up to 16
+ *     uint8_t *data8;   // for reg_width up to 8
+ *
+ * Exactly one of `data`, `data16`, and `data8` shall be set (or none of them
+ * for devices that bypass the buffer). The choice of buffer is invisible to the
+ * rest of the interface: registers are still read and written as `uint32_t`
+ * values, and `reg_bulk()` still imports an array of `uint32_t` words, though
+ * it rejects words that do not fit in the buffer elements.
+ */
+
+/**
+ * @subsubsection Sparse Register Space
+ *
+ * Some devices have a large register address space with only a few of the
+ * addresses populated. Rather than allocating `reg_num` words, such devices can
+ * store only the registers that are actually used. The `slots` member of the
+ * device extension points to a table of the populated register numbers, sorted
+ * in ascending order, and `slot_num` gives the number of table entries. The
+ * data buffer then holds `slot_num` words, such that `data[i]` contains
+ * register `slots[i]`:
+ *
+ *     const size_t dev_slots[] = {0, 34, 36, 37, 42, 43};
+ *     uint32_t dev_data[6];
+ *
+ *     struct reg_ext dev_ext = {
+ *        .slots    = dev_slots,
+ *        .slot_num = 6,
+ *     };
+ *
+ *     struct reg_dev dev = {
+ *        .reg_width = 16,
+ *        .reg_num   = 126,
+ *        .field_map = dev_map,
+ *        ...
+ *        .data      = dev_data,
+ *        .ext       = &dev_ext,
+ *     };
+ *
+ * The `reg_num` still gives the size of the register address space. Accessing
+ * a register not listed in `slots` is an error, as is a field in the map that
+ * occupies such a register; `reg_check()` verifies that the slot table is
+ * sorted and covers all the fields. Registers are found in the table by binary
+ * search, so access time grows only logarithmically with the number of
+ * populated registers. When `slots` is `NULL`, or the device has no extension,
+ * the device is not sparse.
+ *
+ * Instead of writing the slot table by hand, it can be generated from the
+ * field map:
+ */
+
+/**
+ * @api
+ */
+
+/// @func Generate the slot table of a sparse device from its field map.
+int reg_slots(struct reg_dev *d, size_t *slots, size_t len);
+/// @param `d` Device data structure, with the field map and width filled in.
+/// @param `slots` Table to store the populated register numbers into.
+/// @param `len` Capacity of the table, in elements.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/**
+ * The device must have an extension. On success, `d->ext->slots` and
+ * `d->ext->slot_num` are set to describe the generated table. For virtual
+ * devices, where the field map changes at runtime, the slot table must cover
+ * the registers of all the maps.
+ */
+
 /**
  * @subsubsection Physical Read and Write
  *
@@ -277,6 +562,71 @@ int reg_bulk(struct reg_dev *d, const uint32_t *data);
  * should be returned on errors.
  */
 
+/**
+ * @subsubsection Memory-Mapped Registers
+ *
+ * On-chip peripherals and FPGA registers behind a memory bus need no transfer
+ * procedure: reading and writing a register is a single volatile load or store.
+ * For such devices, set `mmio` to the address of register 0 instead of
+ * providing `read_fn` and `write_fn`:
+ *
+ *     struct reg_dev dev = {
+ *        .reg_width   = 32,
+ *        .reg_num     = NUM_REGS,
+ *        .field_map   = dev_map,
+ *        .mmio        = (volatile uint32_t *)0x40013000U,
+ *        .mmio_stride = 1,
+ *        .data        = dev_data,
+ *     };
+ *
+ * Register `reg` is then accessed at `mmio[reg * mmio_stride]`. The stride is
+ * counted in 32-bit words, so that registers spaced 8 bytes apart have
+ * `mmio_stride = 2`; a stride of 0 is treated as 1. When `mmio` is set, the
+ * `read_fn` and `write_fn` callbacks are not used and may be `NULL`.
+ *
+ * By default, memory-mapped devices still keep a copy of the registers in the
+ * data buffer, just like any other device. Setting the `REG_DIRECT` device
+ * flag bypasses the buffer altogether: field reads load the register directly
+ * from `mmio`, and field writes do a read-modify-write of the register in
+ * place. The `data` pointer may then be `NULL`. Note however that
+ * `reg_check()` and `reg_bulk()` work on the data buffer only, so a (scratch)
+ * buffer must be provided for those.
+ *
+ * The register window need not be real hardware. For testing, `mmio` can point
+ * to a plain array in memory, or to a file mapped into memory.
+ */
+
+/**
+ * @subsubsection Paged Registers
+ *
+ * Many devices have more registers than fit in their address space, and make
+ * the rest accessible through a page-select register. Such devices set
+ * `page_len` in the device extension to the number of registers in a page and
+ * provide a function to select a page:
+ *
+ *     int page_fn(int arg, size_t page);
+ *
+ * Registers are still numbered sequentially across all pages, so that register
+ * `reg` lives on page `reg / page_len`, at address `reg % page_len` within the
+ * page. It is this in-page address that is passed to `read_fn` and `write_fn`
+ * (or used to index the `mmio` window). For example, with `page_len = 128`,
+ * register 300 is accessed as register 44 after selecting page 2.
+ *
+ * The currently selected page is cached in the `page` member of the extension,
+ * and `page_fn` is called only when a register on a different page is
+ * accessed. Thus, the cost of paging is paid once for a run of accesses to the
+ * same page, and it pays to order the field map by page when many fields are
+ * written in map order (as happens when a virtual device reloads a map). Like
+ * `write_fn`, `page_fn` shall return 0 on success and $-1$ on error.
+ *
+ * The cache starts out invalid (`page_ok` is false), so the first access will
+ * always select a page. If the device may have lost its page selection, for
+ * example after a hardware reset, set `page_ok` to false again to force the
+ * next access to re-select the page.
+ *
+ * Devices without paging leave `page_len` at 0, or have no extension.
+ */
+
 /**
  * @subsection Field Maps and Fields
  *
@@ -333,6 +683,12 @@ int reg_bulk(struct reg_dev *d, const uint32_t *data);
  * @item `REG_DESCEND` reverses the register order in the layout for
  * multi-register fields. (See detailed discussion below.)
  *
+ * @item `REG_DIRECT` makes a memory-mapped device bypass the data buffer. It
+ * has no effect on fields or on devices without `mmio`. When `REG_NOCOMM` is
+ * set at the same time, the data buffer is used after all. A field with
+ * `REG_NOCOMM` would have nowhere to keep its value on a device that bypasses
+ * the buffer, so `reg_check()` rejects such a field map.
+ *
  * @end itemize
  *
  * Other flags are currently not implemented.
@@ -434,6 +790,373 @@ uint8_t reg_fwidth(const struct reg_dev *d, const char *field);
 /// @return -1 if field not present in device, otherwise its width.
 /// @endfunc
 
+/**
+ * @subsubsection Packed Field Maps
+ *
+ * On a 64-bit host, each `struct reg_field` takes 24 bytes, most of which is
+ * the name pointer and the `size_t` register number. Large maps can instead be
+ * given in packed form, where each field takes 8 bytes, and the field names are
+ * stored separately, one after another, in a single string table:
+ *
+ *     const char dev_names[] = "EN\0MODE\0FTW";
+ *
+ *     const struct reg_packed dev_packed[] = {
+ *        // name reg offs width flags
+ *        {0,     0,  0,   1,    0},
+ *        {3,     0,  1,   7,    0},
+ *        {8,     1,  0,   24,   0},
+ *        {0,     0,  0,   0,    0}
+ *     };
+ *
+ * The `name` member is the offset of the null-terminated field name within the
+ * string table. Packed maps are terminated with a zero-width field. To use a
+ * packed map, set the `packed` and `names` members of `struct reg_dev`, and
+ * leave `field_map` at `NULL`; a device may use only one of the two forms.
+ * Besides saving memory, the packed form keeps the field geometry out of the
+ * way of the names, so that a scan over a large map touches fewer cache lines.
+ *
+ * All functions that take a physical device accept either form of the map,
+ * with the exception of the inline field access functions, which fall back to
+ * the out-of-line path for packed maps. Virtual devices require the unpacked
+ * form. Packed maps are limited to 65536 registers, and to a string table of
+ * 64 kB.
+ */
+
+/**
+ * @api
+ */
+
+/// @func Convert a field map into packed form.
+int reg_pack(const struct reg_field *map, struct reg_packed *packed,
+             size_t len, char *names, size_t names_len);
+/// @param `map` Field map to convert, terminated with `{NULL, 0, 0, 0, 0}`.
+/// @param `packed` Array to store the packed map, including the terminator.
+/// @param `len` Number of elements in `packed`.
+/// @param `names` Buffer to store the string table.
+/// @param `names_len` Size of `names` in bytes.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/**
+ * The `reg_pack()` function is mainly intended for host-side tools that
+ * generate packed maps to be compiled into the firmware. Fields that cannot be
+ * represented in the packed form, as well as buffers that are too small, cause
+ * the conversion to fail.
+ */
+
+/**
+ * @subsubsection Shared Map Index
+ *
+ * Field names are normally found by a linear search of the map. Where the
+ * lookup cost matters, the map can be indexed by name, so that the search
+ * takes a logarithmic number of comparisons. The index is not a property of
+ * the device, but of the map: any number of devices that use the same field
+ * map may share a single `struct reg_map`, while each device keeps its own
+ * data buffer and mutex. For example:
+ *
+ *     size_t dev_index[DEV_FIELDS];
+ *     struct reg_map map = {.field_map = dev_map};
+ *     reg_map_init(&map, dev_index, DEV_FIELDS);
+ *
+ *     for (int i = 0; i < NUM_CHANNELS; i++) {
+ *        ch[i].map = &map;
+ *        ...
+ *     }
+ *
+ * Before calling `reg_map_init()`, set either `field_map`, or `packed` and
+ * `names`, in the `struct reg_map`. A device that points to the map takes its
+ * fields from there, and must leave its own `field_map`, `packed`, and `names`
+ * empty; `reg_check()` rejects a device that gives both. The index is stored in
+ * caller-provided storage of one `size_t` per field, sorted by name in
+ * O(n log n) time, and must be rebuilt if the map changes. Virtual devices do
+ * not use the index.
+ */
+
+/**
+ * @api
+ */
+
+/// @func Build the name index of a field map.
+int reg_map_init(struct reg_map *m, size_t *index, size_t len);
+/// @param `m` Map structure with the field map set.
+/// @param `index` Array to store the index.
+/// @param `len` Number of elements in `index`.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/**
+ * @subsection Field Access by ID
+ *
+ * Looking up a field by name takes a string comparison for each field that
+ * precedes it in the map. In time-critical code, the lookup can be done once,
+ * ahead of time, to obtain the field ID:
+ *
+ *     const int mode = reg_id(&dev, "MODE");
+ *
+ * The ID is simply the index of the field in the field map. It remains valid
+ * for as long as the device uses the same map, and can then be used in place
+ * of the field name:
+ *
+ *     reg_set_id(&dev, mode, 0x03U);
+ *     uint64_t val = reg_get_id(&dev, mode);
+ *
+ * To check the ID against the size of the map, the fields are counted on the
+ * first access by ID, and the count kept in the `field_num` member of the
+ * device (devices with a shared map index use the count in the index). When
+ * replacing the field map of a device, set `field_num` back to 0; virtual
+ * devices do this themselves whenever they load a new map.
+ */
+
+/**
+ * @api
+ */
+
+/// @func Get the ID of a named field.
+int reg_id(const struct reg_dev *d, const char *field);
+/// @param `d` Device data structure.
+/// @param `field` Null-terminated field name.
+/// @return Field ID (0 or greater) on success, $-1$ on failure.
+/// @endfunc
+
+/// @func Get the value of a field given by its ID.
+uint64_t reg_get_id(struct reg_dev *d, int id);
+/// @param `d` Device data structure to read from.
+/// @param `id` Field ID, as returned by `reg_id()`.
+/// @return Register value. On failure, return 0.
+/// @endfunc
+
+/// @func Set the value of a field given by its ID.
+int reg_set_id(struct reg_dev *d, int id, uint64_t val);
+/// @param `d` Device data structure to modify.
+/// @param `id` Field ID, as returned by `reg_id()`.
+/// @param `val` Value to set in the field.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/// @func Get the name of a field given by its ID.
+const char *reg_field_name(const struct reg_dev *d, int id);
+/// @param `d` Device data structure.
+/// @param `id` Field ID, as returned by `reg_id()`.
+/// @return Null-terminated field name on success, `NULL` on failure.
+/// @endfunc
+
+/**
+ * @subsubsection Inline Access
+ *
+ * Most fields fit into a single register. For these, getting or setting the
+ * field takes just a load, mask, and shift, plus a call to `write_fn` for
+ * setting. The following functions are defined `static inline` in this header
+ * so that the compiler can fold this work directly into the caller:
+ */
+
+/**
+ * @api
+ */
+
+/// @func Get the value of a field, inline if possible.
+static inline uint64_t reg_get_fast(struct reg_dev *d, int id);
+/// @param `d` Device data structure to read from.
+/// @param `id` Field ID, as returned by `reg_id()`.
+/// @return Register value. On failure, return 0.
+/// @endfunc
+
+/// @func Set the value of a field, inline if possible.
+static inline int reg_set_fast(struct reg_dev *d, int id, uint64_t val);
+/// @param `d` Device data structure to modify.
+/// @param `id` Field ID, as returned by `reg_id()`.
+/// @param `val` Value to set in the field.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/**
+ * The inline path is taken for non-volatile fields contained in a single
+ * register of a plain device: one with an unpacked field map (its own or a
+ * shared one), a 32-bit `data` buffer, without locking or memory mapping, and
+ * without an extension (so no paging, sparse register
+ * space, statistics, trace, or histogram). All other fields and devices fall
+ * back to `reg_get_id()` and `reg_set_id()`, as do values that are too large
+ * for the field. The inline path stores the same values and makes the same
+ * `write_fn` calls as the out-of-line functions, but it skips their checks:
+ * it does not validate the device or call the error callback when `write_fn`
+ * fails, and it trusts that the `id` was obtained from `reg_id()` for the same
+ * field map, which must have passed `reg_check()`.
+ */
+
+/**
+ * \newpage
+ * The implementation of the inline functions follows:
+ */
+
+// field eligible for inline access, or NULL to take the out-of-line path
+static inline const struct reg_field *reg_fast_field(const struct reg_dev *d,
+                                                     const int id)
+{
+   const struct reg_field *fm = d ? (d->map ? d->map->field_map : d->field_map)
+                                  : NULL;
+   if (!fm || (id < 0) || !d->data || d->data16 || d->data8 || d->mmio ||
+       d->mutex || d->ext || (d->reg_width > 32))
+      return NULL;
+
+   const struct reg_field *f = &fm[id];
+   if ((f->width == 0) || ((size_t)f->offs + f->width > d->reg_width))
+      return NULL;
+
+   return f;
+}
+
+static inline uint64_t reg_get_fast(struct reg_dev *const d, const int id)
+{
+   const struct reg_field *f = reg_fast_field(d, id);
+   if (!f || ((d->flags | f->flags) & REG_VOLATILE))
+      return reg_get_id(d, id);
+
+   const uint32_t mask = UINT32_MAX >> (32U - f->width);
+   return (d->data[f->reg] >> f->offs) & mask;
+}
+
+static inline int reg_set_fast(struct reg_dev *const d, const int id,
+                               const uint64_t val)
+{
+   const struct reg_field *f = reg_fast_field(d, id);
+   if (!f || !d->write_fn || (val >> f->width))
+      return reg_set_id(d, id, val);
+
+   const uint32_t mask = (UINT32_MAX >> (32U - f->width)) << f->offs;
+   const uint32_t reg  = (d->data[f->reg] & ~mask) | ((uint32_t)val << f->offs);
+   d->data[f->reg]     = reg;
+
+   if ((d->flags | f->flags) & REG_NOCOMM)
+      return 0;
+
+   return d->write_fn(d->arg, f->reg, reg) ? -1 : 0;
+}
+
+/**
+ * @subsection Device Groups
+ *
+ * Setting a field on many identical devices (e.g., all channels of a
+ * multi-channel system) with `reg_set()` costs a field lookup, a lock, and a
+ * write per register for each device. Instead, the devices may be collected
+ * into an array and described by a `struct reg_group`:
+ *
+ *     struct reg_dev ch[NUM_CHANNELS] = {...};
+ *     uint32_t vals[NUM_CHANNELS];
+ *
+ *     struct reg_group grp = {
+ *        .devs     = ch,
+ *        .dev_num  = NUM_CHANNELS,
+ *        .arg      = 0,
+ *        .write_fn = broadcast_write,
+ *        .vals     = vals,
+ *     };
+ *
+ *     reg_group_set(&grp, "MODE", 0x03U);
+ *
+ * The field is looked up once, all devices are locked, and the data buffers
+ * of all devices are updated. If the group `write_fn` is `NULL`, each device
+ * then writes its registers with its own `write_fn` as usual. Otherwise, the
+ * group `write_fn` is called once per register, with `vals` holding the new
+ * register value for each device in the order of `devs`. This allows
+ * broadcast-capable buses, or several chip selects asserted at once, to update
+ * all devices in a single transaction. The `vals` member must then point to
+ * storage for `dev_num` words.
+ *
+ * All devices in a group must use the same field map, register width, and
+ * register count. When the group has a `write_fn`, each device must also have
+ * a data buffer that it does not bypass (so no memory-mapped `REG_DIRECT`
+ * devices), and the same flags, except that `REG_NOCOMM` may be set on either
+ * all devices (which skips the group write) or none. The group `write_fn`
+ * receives the register number as given in the field map, so it is
+ * responsible for any paging of the devices. Devices sharing a mutex cannot be
+ * grouped, since each device is locked in turn.
+ */
+
+/**
+ * @api
+ */
+
+/// @func Set a field to the same value in all devices of a group.
+int reg_group_set(struct reg_group *g, const char *field, uint64_t val);
+/// @param `g` Group of devices to modify.
+/// @param `field` Null-terminated field name.
+/// @param `val` Value to set in the field.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/// @func Set a field to a different value in each device of a group.
+int reg_group_set_each(struct reg_group *g, const char *field,
+                       const uint64_t *vals);
+/// @param `g` Group of devices to modify.
+/// @param `field` Null-terminated field name.
+/// @param `vals` Array of `dev_num` values, one per device.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/**
+ * All values are checked against the field width before any device is
+ * modified. If a write fails midway, the data buffers may already hold the new
+ * values.
+ */
+
+/**
+ * @subsection Daisy Chains
+ *
+ * Some devices are daisy-chained on a single bus, so that every frame shifted
+ * through the chain carries one register word for each device. A chain of
+ * identical devices is described by a `struct reg_chain`, which has the same
+ * members as a device group, plus a `nop` word to send to devices that do not
+ * need to be updated. Unlike for groups, the chain `write_fn` and `vals` are
+ * required:
+ *
+ *     struct reg_dev dac[NUM_DACS] = {...};
+ *     uint32_t vals[NUM_DACS];
+ *
+ *     struct reg_chain chain = {
+ *        .devs     = dac,
+ *        .dev_num  = NUM_DACS,
+ *        .write_fn = chain_write,
+ *        .vals     = vals,
+ *        .nop      = DAC_NOP,
+ *     };
+ *
+ *     reg_chain_set_one(&chain, 2, "CODE", 0x1234U);
+ *
+ * The chain `write_fn` is called once per register of the field, with `vals`
+ * holding one word per device, in the order of `devs`. If the register of a
+ * device is unchanged, the word is replaced with `nop`; if the register is
+ * unchanged in all devices, no frame is sent at all. Thus the data buffers
+ * must reflect the state of the devices for the chain to work correctly.
+ *
+ * The devices in a chain must satisfy the same requirements as the devices in
+ * a group with a `write_fn`. The `write_fn` of the individual devices is not
+ * used by the chain functions; it is still called when a single device is
+ * accessed with `reg_set()` and friends, so it should send a frame with the
+ * register word at the right position and `nop` everywhere else.
+ */
+
+/**
+ * @api
+ */
+
+/// @func Set a field to a different value in each device of a chain.
+int reg_chain_set(struct reg_chain *c, const char *field,
+                  const uint64_t *vals);
+/// @param `c` Chain of devices to modify.
+/// @param `field` Null-terminated field name.
+/// @param `vals` Array of `dev_num` values, one per device.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/// @func Set a field in one device of a chain.
+int reg_chain_set_one(struct reg_chain *c, size_t pos, const char *field,
+                      uint64_t val);
+/// @param `c` Chain of devices to modify.
+/// @param `pos` Index of the device in `devs`.
+/// @param `field` Null-terminated field name.
+/// @param `val` Value to set in the field.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
 /**
  * @subsection Virtual Devices
  *
@@ -632,6 +1355,196 @@ int reg_adjust(struct reg_virt *v, const char *field, uint64_t val);
 /// @return 0 on success, $-1$ on failure.
 /// @endfunc
 
+/**
+ * @subsection Access Statistics
+ *
+ * To find out how much bus traffic a piece of code generates, build with
+ * `REG_STATS` defined to 1 and point the `stats` member of the device
+ * extension to a `struct reg_stats`. The library then counts the following:
+ *
+ * @begin itemize
+ *
+ * @item `read_calls`, `write_calls`, and `page_calls`: calls to the device
+ * `read_fn`, `write_fn`, and `page_fn`, or memory-mapped loads and stores.
+ *
+ * @item `regs_read`, `regs_written`, `bits_read`, and `bits_written`:
+ * registers transferred to or from the device, and the corresponding number of
+ * bits. Unlike the call counters, these include the registers written by group
+ * and chain write functions, but not the `nop` words sent to a chain.
+ *
+ * @item `compares`: string comparisons made while looking up fields by name.
+ *
+ * @item `locks` and `lock_fails`: successful and failed attempts to lock the
+ * device.
+ *
+ * @item `loads`: calls to the `load_fn` of a virtual device, counted in its
+ * `base` device.
+ *
+ * @item `resets`: fields re-set after a virtual device loads a new map.
+ *
+ * @end itemize
+ *
+ * Counters wrap around on overflow. Devices may share a `struct reg_stats` to
+ * obtain totals. Without `REG_STATS`, the `stats` member is ignored and the
+ * counters stay at zero.
+ */
+
+/**
+ * @api
+ */
+
+/// @func Copy the statistics of a device.
+int reg_stats_get(const struct reg_dev *d, struct reg_stats *out);
+/// @param `d` Device with statistics attached.
+/// @param `out` Structure to store a copy of the counters in.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/// @func Clear the statistics of a device.
+int reg_stats_reset(struct reg_dev *d);
+/// @param `d` Device with statistics attached.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/**
+ * @subsection Access Trace
+ *
+ * To find out which registers were accessed, and in what order, build with
+ * `REG_TRACE` defined to 1 and point the `trace` member of the extension of one
+ * or more devices to a `struct reg_trace`. Each call to `read_fn`, `write_fn`,
+ * `page_fn`, or the virtual `load_fn` (and each memory-mapped access) then
+ * appends one record to the trace:
+ *
+ * @begin itemize
+ *
+ * @item `time` is the value returned by `clock_fn`, or 0 if `clock_fn` is
+ * `NULL`. The unit is up to the application, e.g., a free-running timer.
+ *
+ * @item `reg` is the sequential register number; for `REG_TRACE_PAGE`, the
+ * page number; and for `REG_TRACE_LOAD`, the map index passed to `load_fn`.
+ *
+ * @item `val` is the value read or written; 0 for the other operations.
+ *
+ * @item `dev` is the `arg` of the device, truncated to 16 bits.
+ *
+ * @item `op` is one of the `REG_TRACE_*` codes. Group and chain writes are
+ * recorded as `REG_TRACE_GROUP`, once for each device that receives a word.
+ *
+ * @item `err` is nonzero if the callback reported an error.
+ *
+ * @end itemize
+ *
+ * Besides the physical accesses, the calls `reg_set()`, `reg_get()`,
+ * `reg_adjust()`, and `reg_obtain()` are recorded as `REG_TRACE_SET`,
+ * `REG_TRACE_GET`, `REG_TRACE_ADJUST`, and `REG_TRACE_OBTAIN`, so that a
+ * session can be replayed later. These records are appended when the call
+ * returns, after the physical accesses it caused. Here `reg` is the field ID
+ * (the index into the field map, or into `fields` of a virtual device), or
+ * `UINT32_MAX` if the field was not found; `val` is the value set or returned;
+ * and `err` is nonzero if the call failed. Values wider than 32 bits are
+ * preceded by a `REG_TRACE_HIGH` record holding the upper 32 bits in `val`.
+ * Calls by field ID, and calls made internally by the library, are not
+ * recorded.
+ *
+ * Records are stored in a ring buffer of `len` records in caller-provided
+ * storage, where `len` must be a power of two; once full, the oldest records
+ * are overwritten. Appending a record takes a handful of stores and no
+ * formatting, so the trace can stay enabled in production code. The `head`
+ * member counts all records ever appended. Each record is stored before `head`
+ * is advanced, with a release fence in between where the compiler provides
+ * one, so a reader on another core sees only complete records. The trace has
+ * a single writer: if devices used from different threads or interrupts share
+ * a trace, they must share a mutex as well, or the records may be interleaved
+ * incorrectly.
+ */
+
+/**
+ * @api
+ */
+
+/// @func Initialize an access trace.
+int reg_trace_init(struct reg_trace *t, struct reg_trace_rec *buf,
+                   size_t len, uint32_t (*clock_fn)(void));
+/// @param `t` Trace to initialize.
+/// @param `buf` Storage for the records.
+/// @param `len` Number of records in `buf`, a power of two.
+/// @param `clock_fn` Timestamp source for the records, or `NULL` to record 0.
+/// @return 0 on success, $-1$ on failure.
+/// @endfunc
+
+/// @func Copy the most recent trace records.
+size_t reg_trace_dump(const struct reg_trace *t, struct reg_trace_rec *out,
+                      size_t len);
+/// @param `t` Trace to read from.
+/// @param `out` Array to store the records in, oldest first.
+/// @param `len` Maximum number of records to copy.
+/// @return Number of records copied.
+/// @endfunc
+
+/**
+ * The dump should be taken while no records are being appended, e.g., with
+ * the devices locked, or after tracing has been stopped by setting the `trace`
+ * pointers of the device extensions to `NULL`.
+ */
+
+/**
+ * @subsection Latency Histograms
+ *
+ * Mean access times hide the rare slow calls, such as a `reg_adjust()` that
+ * loads a new map, that matter for real-time code. To see the whole
+ * distribution, build with `REG_HIST` defined to 1 and point the `hist`
+ * member of the device extension (or that of the `base` of a virtual device)
+ * to a `struct reg_hist` with `clock_fn` set. The `clock_fn` returns a
+ * free-running count in any unit, such as a cycle counter, and may wrap
+ * around.
+ *
+ * The library then times each call to `reg_get()`, `reg_set()`, and
+ * `reg_adjust()`, and each call to the virtual `load_fn`, and counts the
+ * duration in the row of `count` for the operation. The longest duration seen
+ * is kept in `max`. Calls that fail before the device is locked are not timed.
+ * The durations of `reg_get()` and `reg_set()` are counted before the device
+ * mutex is released, so threads sharing a device through its mutex may share
+ * its histogram too.
+ *
+ * Buckets are log-linear: durations below `REG_HIST_SUB` have a bucket each,
+ * and each further power of two is split into `REG_HIST_SUB` equal buckets,
+ * so that the bucket width is at most a quarter of the duration. The
+ * histogram has a fixed size of about 2 kB and needs no allocation. Counts
+ * saturate rather than wrap around.
+ */
+
+/**
+ * @api
+ */
+
+/// @func Clear a latency histogram.
+void reg_hist_reset(struct reg_hist *h);
+/// @param `h` Histogram to clear; `clock_fn` is left as is.
+/// @endfunc
+
+/// @func Pass the nonempty buckets of a histogram row to a callback.
+int reg_hist_export(const struct reg_hist *h, size_t op,
+                    int (*fn)(void *ctx, uint32_t lo, uint32_t hi,
+                              uint32_t count),
+                    void *ctx);
+/// @param `h` Histogram to read.
+/// @param `op` Operation, one of the `REG_HIST_*` codes.
+/// @param `fn` Callback, given the lowest and highest duration of each
+/// bucket, and the number of calls in it. Returning nonzero stops the export.
+/// @param `ctx` Passed on to the callback.
+/// @return 0 on success, $-1$ on failure or if the callback returned nonzero.
+/// @endfunc
+
+/// @func Find a quantile of the durations of an operation.
+uint32_t reg_hist_quantile(const struct reg_hist *h, size_t op,
+                           uint32_t ppm);
+/// @param `h` Histogram to read.
+/// @param `op` Operation, one of the `REG_HIST_*` codes.
+/// @param `ppm` Quantile in parts per million, e.g., 990000 for p99.
+/// @return Upper bound of the bucket holding the quantile, at most `max`; 0 if
+/// the row is empty.
+/// @endfunc
+
 #endif // REG_H
 
 // end file reg.h
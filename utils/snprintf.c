@@ -129,6 +129,18 @@
  *      HAVE_VA_COPY
  *      HAVE___VA_COPY
  *
+ *    If HAVE_IEEE_DOUBLE is defined to 1 (which requires double to be an
+ *    IEEE 754 binary64 type and <stdint.h> to provide uint64_t), "%f"
+ *    conversions of double values below 2^64 and not below 2^-8 are done
+ *    exactly, with integer arithmetic only.  Other values fall back to the
+ *    LDOUBLE arithmetic.
+ *
+ *    If NO_FLOAT is defined to 1, the floating point conversions are left
+ *    out, so that no (software) floating point routines are linked in.  The
+ *    "a", "e", "f", and "g" conversions (and their upper case variants) then
+ *    skip their argument and print "?".  Scaled integers can be printed
+ *    with rpl_fmtfixed() instead.
+ *
  * 2) The calls to the functions which should be replaced must be redefined
  *    throughout the project files (by using Autoconf or other means):
  *
@@ -518,20 +530,27 @@ static void *mymemcpy(void *, void *, size_t);
 
 static void fmtstr(char *, size_t *, size_t, const char *, int, int, int);
 static void fmtint(char *, size_t *, size_t, INTMAX_T, int, int, int, int);
-static void fmtflt(char *, size_t *, size_t, LDOUBLE, int, int, int, int *);
 static void printsep(char *, size_t *, size_t);
 static int getnumsep(int);
-static int getexponent(LDOUBLE);
 static int convert(UINTMAX_T, char *, size_t, int, int);
+#if !NO_FLOAT
+static void fmtflt(char *, size_t *, size_t, LDOUBLE, int, int, int, int *);
+static int getexponent(LDOUBLE);
 static UINTMAX_T cast(LDOUBLE);
 static UINTMAX_T myround(LDOUBLE);
 static LDOUBLE mypow10(int);
+#if HAVE_IEEE_DOUBLE
+static int splitdouble(LDOUBLE, int, UINTMAX_T *, UINTMAX_T *);
+#endif /* HAVE_IEEE_DOUBLE */
+#endif /* !NO_FLOAT */
 
 extern int errno;
 
 int rpl_vsnprintf(char *str, size_t size, const char *format, va_list args)
 {
+#if !NO_FLOAT
    LDOUBLE fvalue;
+#endif /* !NO_FLOAT */
    INTMAX_T value;
    unsigned char cvalue;
    const char *strvalue;
@@ -779,6 +798,14 @@ int rpl_vsnprintf(char *str, size_t size, const char *format, va_list args)
                      flags |= PRINT_F_TYPE_G;
                   /* FALLTHROUGH */
                case 'f':
+#if NO_FLOAT
+                  /* Skip the argument, and print a placeholder. */
+                  if (cflags == PRINT_C_LDOUBLE)
+                     (void)va_arg(args, LDOUBLE);
+                  else
+                     (void)va_arg(args, double);
+                  fmtstr(str, &len, size, "?", width, -1, flags);
+#else
                   if (cflags == PRINT_C_LDOUBLE)
                      fvalue = va_arg(args, LDOUBLE);
                   else
@@ -787,6 +814,7 @@ int rpl_vsnprintf(char *str, size_t size, const char *format, va_list args)
                          &overflow);
                   if (overflow)
                      goto out;
+#endif /* NO_FLOAT */
                   break;
                case 'c':
                   cvalue = va_arg(args, int);
@@ -937,7 +965,8 @@ static void fmtint(char *str, size_t *len, size_t size, INTMAX_T value,
    if (flags & PRINT_F_UNSIGNED)
       uvalue = value;
    else {
-      uvalue = (value >= 0) ? value : -value;
+      /* Negate in unsigned arithmetic, -INTMAX_MIN overflows. */
+      uvalue = (value >= 0) ? (UINTMAX_T)value : 0 - (UINTMAX_T)value;
       if (value < 0)
          sign = '-';
       else if (flags & PRINT_F_PLUS) /* Do a sign. */
@@ -1018,6 +1047,7 @@ static void fmtint(char *str, size_t *len, size_t size, INTMAX_T value,
    }
 }
 
+#if !NO_FLOAT
 static void fmtflt(char *str, size_t *len, size_t size, LDOUBLE fvalue,
                    int width, int precision, int flags, int *overflow)
 {
@@ -1132,6 +1162,10 @@ again:
    }
 
    ufvalue = (fvalue >= 0.0) ? fvalue : -fvalue;
+#if HAVE_IEEE_DOUBLE
+   if (!estyle && splitdouble(ufvalue, precision, &intpart, &fracpart) == 0)
+      goto split;
+#endif /* HAVE_IEEE_DOUBLE */
    if (estyle) /* We want exactly one integer digit. */
       ufvalue /= mypow10(exponent);
 
@@ -1169,6 +1203,9 @@ again:
          exponent++;
       }
    }
+#if HAVE_IEEE_DOUBLE
+split:
+#endif /* HAVE_IEEE_DOUBLE */
 
    /*
     * Now that we know the real exponent, we can check whether or not to
@@ -1311,6 +1348,7 @@ again:
       padlen++;
    }
 }
+#endif /* !NO_FLOAT */
 
 static void printsep(char *str, size_t *len, size_t size)
 {
@@ -1343,6 +1381,7 @@ static int getnumsep(int digits)
    return separators;
 }
 
+#if !NO_FLOAT
 static int getexponent(LDOUBLE value)
 {
    LDOUBLE tmp  = (value >= 0.0) ? value : -value;
@@ -1362,21 +1401,82 @@ static int getexponent(LDOUBLE value)
 
    return exponent;
 }
+#endif /* !NO_FLOAT */
+
+/* The decimal digit pairs "00" to "99", for two digits per division. */
+static const char digitpairs[200] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
 
 static int convert(UINTMAX_T value, char *buf, size_t size, int base, int caps)
 {
    const char *digits = caps ? "0123456789ABCDEF" : "0123456789abcdef";
    size_t pos         = 0;
+   unsigned int small;
+   unsigned int rem;
 
    /* We return an unterminated buffer with the digits in reverse order. */
-   do {
-      buf[pos++] = digits[value % base];
-      value /= base;
-   } while (value != 0 && pos < size);
+   if (base == 16 || base == 8) {
+      /* Powers of two need no division at all. */
+      const int shift = (base == 16) ? 4 : 3;
+      do {
+         buf[pos++] = digits[value & (UINTMAX_T)(base - 1)];
+         value >>= shift;
+      } while (value != 0 && pos < size);
+      return (int)pos;
+   }
+
+   if (base != 10) {
+      do {
+         buf[pos++] = digits[value % base];
+         value /= base;
+      } while (value != 0 && pos < size);
+      return (int)pos;
+   }
+
+   /*
+    * Divide the wide type by 100 only until the rest fits into an unsigned
+    * int, and continue with the (often much cheaper) narrow division.
+    */
+   while (value > UINT_MAX && pos + 2 <= size) {
+      UINTMAX_T quot = value / 100;
+      rem            = (unsigned int)(value - quot * 100);
+      buf[pos++]     = digitpairs[2 * rem + 1];
+      buf[pos++]     = digitpairs[2 * rem];
+      value          = quot;
+   }
+
+   /*
+    * If the buffer is too small, keep the low-order digits, as the plain
+    * loops above do: there is room for at most one more digit.
+    */
+   if (value > UINT_MAX) {
+      if (pos < size)
+         buf[pos++] = digits[value % 10];
+      return (int)pos;
+   }
+
+   small = (unsigned int)value;
+   while (small >= 100 && pos + 2 <= size) {
+      rem        = small % 100;
+      small      = small / 100;
+      buf[pos++] = digitpairs[2 * rem + 1];
+      buf[pos++] = digitpairs[2 * rem];
+   }
+
+   if (small >= 10 && pos + 2 <= size) {
+      buf[pos++] = digitpairs[2 * small + 1];
+      buf[pos++] = digitpairs[2 * small];
+   } else if (pos < size)
+      buf[pos++] = digits[small % 10];
 
    return (int)pos;
 }
 
+#if !NO_FLOAT
 static UINTMAX_T cast(LDOUBLE value)
 {
    UINTMAX_T result;
@@ -1421,6 +1521,84 @@ static LDOUBLE mypow10(int exponent)
    }
    return result;
 }
+
+#if HAVE_IEEE_DOUBLE
+static int splitdouble(LDOUBLE value, int precision, UINTMAX_T *intpart,
+                       UINTMAX_T *fracpart)
+{
+   union {
+      double d;
+      uint64_t u;
+   } bits;
+   uint64_t mant;
+   uint64_t frac;
+   uint64_t half;
+   uint64_t ip;
+   uint64_t fp   = 0;
+   uint64_t mask = 1;
+   int shift;
+   int i;
+
+   bits.d = (double)value;
+   if (bits.d != value || sizeof(UINTMAX_T) < sizeof(uint64_t))
+      return -1; /* Not a double (e.g., "%Lf"), or no room for 64 bits. */
+
+   /* The value is mant * 2^-shift, exactly. */
+   mant  = bits.u & (((uint64_t)1 << 52) - 1);
+   shift = (int)((bits.u >> 52) & 0x7ff);
+   if (shift == 0x7ff)
+      return -1;
+   if (shift == 0) /* Zero or subnormal. */
+      shift = 1;
+   else
+      mant |= (uint64_t)1 << 52;
+   shift = 1075 - shift;
+
+   if (mant == 0) {
+      *intpart  = 0;
+      *fracpart = 0;
+      return 0;
+   }
+
+   if (shift <= 0) { /* No fractional part. */
+      if (shift < -11)
+         return -1; /* 2^64 or above. */
+      *intpart  = mant << -shift;
+      *fracpart = 0;
+      return 0;
+   }
+
+   /*
+    * Leave room for multiplying the fractional bits by ten.  This limits
+    * the fast path to values of at least 2^-8.
+    */
+   if (shift > 60)
+      return -1;
+
+   ip   = mant >> shift;
+   frac = mant & (((uint64_t)1 << shift) - 1);
+   for (i = 0; i < precision; i++) { /* One exact digit per step. */
+      frac *= 10;
+      fp   = fp * 10 + (frac >> shift);
+      frac &= ((uint64_t)1 << shift) - 1;
+      mask *= 10;
+   }
+
+   /* Round the rest to nearest, with ties to an even last digit. */
+   half = (uint64_t)1 << (shift - 1);
+   if (frac > half || (frac == half && ((precision > 0 ? fp : ip) & 1))) {
+      if (++fp >= mask) {
+         fp = 0;
+         ip++;
+      }
+   }
+
+   *intpart  = ip;
+   *fracpart = fp;
+   return 0;
+}
+#endif /* HAVE_IEEE_DOUBLE */
+#endif /* !NO_FLOAT */
 #endif /* !HAVE_VSNPRINTF */
 
 #if !HAVE_VASPRINTF
@@ -1477,6 +1655,29 @@ int rpl_snprintf(va_alist) va_dcl
 }
 #endif /* !HAVE_SNPRINTF */
 
+#if !HAVE_SNPRINTF
+int rpl_fmtfixed(char *str, size_t size, long long int value, int decimals)
+{
+   unsigned long long int uvalue;
+   unsigned long long int scale = 1;
+   const char *sign             = (value < 0) ? "-" : "";
+   int i;
+
+   if (decimals < 0 || decimals > 18)
+      return -1;
+
+   uvalue = (value < 0) ? 0 - (unsigned long long int)value
+                        : (unsigned long long int)value;
+   if (decimals == 0)
+      return rpl_snprintf(str, size, "%s%llu", sign, uvalue);
+
+   for (i = 0; i < decimals; i++)
+      scale *= 10;
+   return rpl_snprintf(str, size, "%s%llu.%0*llu", sign, uvalue / scale,
+                       decimals, uvalue % scale);
+}
+#endif /* !HAVE_SNPRINTF */
+
 #if !HAVE_ASPRINTF
 #if HAVE_STDARG_H
 int rpl_asprintf(char **ret, const char *format, ...)
@@ -18,10 +18,34 @@
 #define HAVE_UNSIGNED_LONG_LONG_INT 1
 #define HAVE_LONG_LONG_INT          1
 
+// define to 0 where double is not IEEE 754 binary64, for the LDOUBLE fallback
+#ifndef HAVE_IEEE_DOUBLE
+#define HAVE_IEEE_DOUBLE 1
+#endif
+
+// define to 1 to leave out the floating point conversions
+#ifndef NO_FLOAT
+#define NO_FLOAT 0
+#endif
+
 __attribute__((format(printf, 3, 4))) int rpl_snprintf(char *str, size_t size,
                                                        const char *format, ...);
 
 __attribute__((format(printf, 3, 0))) int
 rpl_vsnprintf(char *str, size_t size, const char *format, va_list args);
 
+/**
+ * @brief Print a scaled integer as a fixed-point decimal number.
+ *
+ * For example, value 12345 with 3 decimals prints "12.345", and value -5 with
+ * 2 decimals prints "-0.05". Needs no floating point support.
+ *
+ * @param str Output buffer.
+ * @param size Size of the output buffer.
+ * @param value Number to print, times 10^decimals.
+ * @param decimals Number of digits after the decimal point, from 0 to 18.
+ * @return Length of the output, as rpl_snprintf(), or -1 on error.
+ */
+int rpl_fmtfixed(char *str, size_t size, long long value, int decimals);
+
 // end file snprintf.h